@@ -0,0 +1,45 @@
+# Training run for profile-guided optimisation, invoked by the pgo-train target.
+# Runs perft on positions that exercise castling, en passant and promotions,
+# the engine's bench (the search) and the microbenchmarks (which cover
+# evaluation as well as the rules), then
+# (for Clang) merges the raw profiles into the chess.profdata file that
+# CHESS_PGO=USE reads.
+
+set(TRAINING_SCRIPT "${PGO_DIR}/training.uci")
+file(WRITE ${TRAINING_SCRIPT}
+"setoption name OwnBook value false
+position startpos
+go perft 5
+position fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1
+go perft 4
+position fen 8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1
+go perft 5
+position fen r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1
+go perft 4
+bench 7
+quit
+")
+
+execute_process(COMMAND ${ENGINE} INPUT_FILE ${TRAINING_SCRIPT} OUTPUT_QUIET RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Engine training run failed: ${result}")
+endif()
+execute_process(COMMAND ${MICROBENCH} --min-time 0.2 OUTPUT_QUIET RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Microbenchmark training run failed: ${result}")
+endif()
+
+if(COMPILER_ID MATCHES "Clang")
+    get_filename_component(compiler_dir ${COMPILER} DIRECTORY)
+    find_program(LLVM_PROFDATA NAMES llvm-profdata HINTS ${compiler_dir})
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata is needed to merge Clang profiles")
+    endif()
+    file(GLOB raw_profiles "${PGO_DIR}/*.profraw")
+    execute_process(COMMAND ${LLVM_PROFDATA} merge -output=${PGO_DIR}/chess.profdata ${raw_profiles}
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Merging profiles failed: ${result}")
+    endif()
+endif()
+message(STATUS "Profiles written to ${PGO_DIR}")
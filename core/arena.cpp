@@ -0,0 +1,48 @@
+#include "arena.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// ========== ALLOCATION COUNTERS ==========
+
+static atomic<uint64_t> totalAllocations{ 0 };
+static thread_local uint64_t threadAllocations = 0;
+
+uint64_t heapAllocations() {
+    return totalAllocations.load(memory_order_relaxed);
+}
+
+uint64_t threadHeapAllocations() {
+    return threadAllocations;
+}
+
+// The array and nothrow forms call this one, so it sees every plain allocation
+void* operator new(size_t size) {
+    threadAllocations++;
+    totalAllocations.fetch_add(1, memory_order_relaxed);
+    if (size == 0) size = 1;
+    for (;;) {
+        if (void* p = malloc(size)) return p;
+        new_handler handler = get_new_handler();
+        if (!handler) throw bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// ========== ARENA ==========
+
+void arenaInit(Arena& arena, size_t bytes) {
+    arena.memory.assign(bytes, 0);
+    arena.used = 0;
+}
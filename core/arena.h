@@ -0,0 +1,89 @@
+#pragma once
+// Allocation-free building blocks for hot paths: a bump arena for per-thread
+// scratch memory (search stack frames, move lists), a fixed-capacity object
+// pool with a free list (game records), and heap allocation counters.
+//
+// The counters come from replacing the global operator new in arena.cpp, so
+// every program linked with the core can check that code which should not
+// allocate really doesn't: read threadHeapAllocations() before and after.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ========== ALLOCATION COUNTERS ==========
+
+uint64_t heapAllocations();          // all threads since startup
+uint64_t threadHeapAllocations();    // the calling thread since it started
+
+// ========== ARENA ==========
+
+// One block allocated up front; allocations bump a pointer and are released
+// all at once by rewinding to an earlier mark
+struct Arena {
+    std::vector<unsigned char> memory;
+    size_t used = 0;
+};
+
+void arenaInit(Arena& arena, size_t bytes);
+
+// Returns nullptr when the arena is exhausted; callers size it for the worst case
+inline void* arenaAllocBytes(Arena& arena, size_t bytes, size_t alignment) {
+    size_t start = (arena.used + alignment - 1) & ~(alignment - 1);
+    if (start + bytes > arena.memory.size()) return nullptr;
+    arena.used = start + bytes;
+    return arena.memory.data() + start;
+}
+
+template <typename T>
+T* arenaAlloc(Arena& arena, size_t count) {
+    return static_cast<T*>(arenaAllocBytes(arena, count * sizeof(T), alignof(T)));
+}
+
+// Frees everything allocated from the arena during its lifetime
+struct ArenaScope {
+    Arena& arena;
+    size_t mark;
+    explicit ArenaScope(Arena& a) : arena(a), mark(a.used) {}
+    ~ArenaScope() { arena.used = mark; }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+// ========== POOL ==========
+
+// Fixed number of slots allocated up front and handed out by index, so a
+// slot's address never changes and acquiring one never allocates
+template <typename T>
+struct Pool {
+    std::vector<T> items;
+    std::vector<uint32_t> freeSlots;
+};
+
+template <typename T>
+void poolInit(Pool<T>& pool, size_t capacity) {
+    pool.items.assign(capacity, T{});
+    pool.freeSlots.clear();
+    pool.freeSlots.reserve(capacity);
+    // Hand out low indices first
+    for (size_t i = capacity; i > 0; i--) pool.freeSlots.push_back(uint32_t(i - 1));
+}
+
+// Returns the slot index, or -1 when the pool is full
+template <typename T>
+int64_t poolAcquire(Pool<T>& pool) {
+    if (pool.freeSlots.empty()) return -1;
+    uint32_t slot = pool.freeSlots.back();
+    pool.freeSlots.pop_back();
+    return slot;
+}
+
+template <typename T>
+void poolRelease(Pool<T>& pool, uint32_t slot) {
+    pool.freeSlots.push_back(slot);
+}
+
+template <typename T>
+size_t poolInUse(const Pool<T>& pool) {
+    return pool.items.size() - pool.freeSlots.size();
+}
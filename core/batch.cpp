@@ -0,0 +1,162 @@
+#include "batch.h"
+#include "eval.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Positions per parallelFor task
+const size_t BATCH_CHUNK = 1024;
+
+// ========== PACKED POSITIONS ==========
+
+PackedPosition packPosition(const Position& pos) {
+    PackedPosition packed = {};
+    for (int sq = 0; sq < 64; sq += 2) {
+        packed.squares[sq / 2] = uint8_t(pos.board[sq] | (pos.board[sq + 1] << 4));
+    }
+    packed.flags = uint8_t((pos.whiteToMove ? 1 : 0) | (pos.castling << 1));
+    packed.epSquare = int8_t(pos.epSquare);
+    packed.halfmoveClock = uint8_t(min(255, pos.halfmoveClock));
+    return packed;
+}
+
+// Finds the kings; false unless there is exactly one of each colour
+static bool findKings(Position& pos) {
+    int kings[2] = { 0, 0 };
+    for (int sq = 0; sq < 64; sq++) {
+        if (pos.board[sq] == W_KING) { pos.kingSquare[0] = sq; kings[0]++; }
+        else if (pos.board[sq] == B_KING) { pos.kingSquare[1] = sq; kings[1]++; }
+    }
+    return kings[0] == 1 && kings[1] == 1;
+}
+
+bool unpackPosition(const PackedPosition& packed, Position& pos) {
+    for (int sq = 0; sq < 64; sq += 2) {
+        pos.board[sq] = packed.squares[sq / 2] & 15;
+        pos.board[sq + 1] = packed.squares[sq / 2] >> 4;
+        if (pos.board[sq] > B_PAWN || pos.board[sq + 1] > B_PAWN) return false;
+    }
+    pos.whiteToMove = (packed.flags & 1) != 0;
+    pos.castling = (packed.flags >> 1) & 15;
+    pos.epSquare = packed.epSquare >= 0 && packed.epSquare < 64 ? packed.epSquare : -1;
+    pos.halfmoveClock = packed.halfmoveClock;
+    pos.fullmoveNumber = 1;
+    pos.key = 0;
+    return findKings(pos);
+}
+
+// ========== BATCH ==========
+
+void batchResize(PositionBatch& batch, size_t count) {
+    batch.count = count;
+    batch.boards.assign(count * 64, NONE);
+    batch.whiteToMove.assign(count, 1);
+    batch.castling.assign(count, 0);
+    batch.epSquare.assign(count, -1);
+    batch.halfmoveClock.assign(count, 0);
+    batch.valid.assign(count, 0);
+    batch.evaluations.assign(count, 0);
+    batch.legalMoves.assign(count, 0);
+    batch.inCheck.assign(count, 0);
+    batch.searchScores.assign(count, 0);
+}
+
+void batchSetPosition(PositionBatch& batch, size_t i, const Position& pos) {
+    for (int sq = 0; sq < 64; sq++) batch.boards[sq * batch.count + i] = uint8_t(pos.board[sq]);
+    batch.whiteToMove[i] = pos.whiteToMove ? 1 : 0;
+    batch.castling[i] = uint8_t(pos.castling);
+    batch.epSquare[i] = int8_t(pos.epSquare);
+    batch.halfmoveClock[i] = uint8_t(min(255, pos.halfmoveClock));
+    batch.valid[i] = 1;
+}
+
+bool batchSetPacked(PositionBatch& batch, size_t i, const PackedPosition& packed) {
+    Position pos;
+    if (!unpackPosition(packed, pos)) {
+        batch.valid[i] = 0;
+        return false;
+    }
+    batchSetPosition(batch, i, pos);
+    return true;
+}
+
+bool batchSetFen(PositionBatch& batch, size_t i, const string& fen) {
+    Position pos;
+    if (!setFromFen(pos, fen)) {
+        batch.valid[i] = 0;
+        return false;
+    }
+    batchSetPosition(batch, i, pos);
+    return true;
+}
+
+void batchGetPosition(const PositionBatch& batch, size_t i, Position& pos) {
+    for (int sq = 0; sq < 64; sq++) pos.board[sq] = batch.boards[sq * batch.count + i];
+    pos.whiteToMove = batch.whiteToMove[i] != 0;
+    pos.castling = batch.castling[i];
+    pos.epSquare = batch.epSquare[i];
+    pos.halfmoveClock = batch.halfmoveClock[i];
+    pos.fullmoveNumber = 1;
+    pos.key = 0;
+    findKings(pos);
+}
+
+// ========== EVALUATION ==========
+
+void startBatchEvaluator(BatchEvaluator& evaluator, int threads, const BatchOptions& options) {
+    evaluator.options = options;
+    startThreadPool(evaluator.pool, threads);
+    evaluator.searches.clear();
+    if (options.searchDepth <= 0) return;
+    for (int i = 0; i < poolWorkers(evaluator.pool); i++) {
+        evaluator.searches.emplace_back(new Search);
+        initSearch(*evaluator.searches.back(), options.searchHashMb);
+    }
+}
+
+void stopBatchEvaluator(BatchEvaluator& evaluator) {
+    stopThreadPool(evaluator.pool);
+    evaluator.searches.clear();
+}
+
+void evaluateBatch(BatchEvaluator& evaluator, PositionBatch& batch) {
+    const BatchOptions& options = evaluator.options;
+    static const vector<uint64_t> noHistory;
+    size_t chunks = (batch.count + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    parallelFor(evaluator.pool, chunks, [&](size_t chunk, int worker) {
+        size_t start = chunk * BATCH_CHUNK;
+        size_t end = min(batch.count, start + BATCH_CHUNK);
+        evaluateMany(batch.boards.data() + start, batch.count, batch.whiteToMove.data() + start,
+            end - start, batch.evaluations.data() + start);
+        if (!options.legalMoves && !options.checks && options.searchDepth <= 0) {
+            for (size_t i = start; i < end; i++) {
+                if (!batch.valid[i]) batch.evaluations[i] = 0;
+            }
+            return;
+        }
+
+        for (size_t i = start; i < end; i++) {
+            if (!batch.valid[i]) {
+                batch.evaluations[i] = 0;
+                batch.legalMoves[i] = 0;
+                batch.inCheck[i] = 0;
+                batch.searchScores[i] = 0;
+                continue;
+            }
+            Position pos;
+            batchGetPosition(batch, i, pos);
+            if (options.legalMoves) batch.legalMoves[i] = uint16_t(countLegalMoves(pos));
+            if (options.checks) batch.inCheck[i] = checkers(pos) != 0;
+            if (options.searchDepth > 0) {
+                Search& search = *evaluator.searches[worker];
+                pos.key = computeKey(pos);
+                newGame(search);
+                search.stop = false;
+                SearchLimits limits;
+                limits.depth = options.searchDepth;
+                batch.searchScores[i] = searchPosition(search, pos, limits, noHistory).score;
+            }
+        }
+    });
+}
@@ -0,0 +1,91 @@
+#pragma once
+// Batch evaluation for generating training data: static evaluations,
+// legal move counts, check status and optionally shallow search scores for
+// millions of positions. Positions are stored as structure of arrays, boards
+// square-major, so the static evaluation runs over whole blocks of positions
+// (evaluateMany in eval.h). Everything is allocated when the batch is sized
+// and the evaluator is started; evaluating allocates nothing per position.
+//
+// Positions come in as FEN, as Position or in the 36-byte packed form below,
+// which decodes without parsing or hashing. Hash keys are only computed when
+// a search needs them.
+
+#include "position.h"
+#include "search.h"
+#include "threadpool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A position in 36 bytes: two pieces per byte, then the state. The move
+// number is not kept.
+struct PackedPosition {
+    uint8_t squares[32];    // square 2k in the low nibble of byte k, 2k+1 in the high one
+    uint8_t flags;          // bit 0: white to move; bits 1-4: castling rights
+    int8_t epSquare;        // -1 if none
+    uint8_t halfmoveClock;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(PackedPosition) == 36, "packed positions must stay 36 bytes");
+
+PackedPosition packPosition(const Position& pos);
+// Fills in everything but the hash key, which computeKey adds if needed.
+// Returns false for a board without exactly one king of each colour.
+bool unpackPosition(const PackedPosition& packed, Position& pos);
+
+// ========== BATCH ==========
+
+struct PositionBatch {
+    size_t count = 0;
+    // Inputs, one entry per position; boards are square-major
+    std::vector<uint8_t> boards;        // boards[sq * count + i]
+    std::vector<uint8_t> whiteToMove;
+    std::vector<uint8_t> castling;
+    std::vector<int8_t> epSquare;
+    std::vector<uint8_t> halfmoveClock;
+    std::vector<uint8_t> valid;         // 0 for input that could not be read; its outputs are 0
+    // Outputs
+    std::vector<int32_t> evaluations;   // evaluate(), side to move's view
+    std::vector<uint16_t> legalMoves;
+    std::vector<uint8_t> inCheck;
+    std::vector<int32_t> searchScores;  // only filled by a search
+};
+
+// Sizes every array for count positions, all marked invalid until set
+void batchResize(PositionBatch& batch, size_t count);
+
+// Store position i. Different positions may be set from different threads.
+void batchSetPosition(PositionBatch& batch, size_t i, const Position& pos);
+bool batchSetPacked(PositionBatch& batch, size_t i, const PackedPosition& packed);
+bool batchSetFen(PositionBatch& batch, size_t i, const std::string& fen);
+
+// Rebuilds position i (without its hash key) from the arrays
+void batchGetPosition(const PositionBatch& batch, size_t i, Position& pos);
+
+// ========== EVALUATION ==========
+
+struct BatchOptions {
+    bool legalMoves = true;
+    bool checks = true;
+    int searchDepth = 0;        // 0 = no search, else the depth of a search per position
+    size_t searchHashMb = 1;    // transposition table of each worker's search
+};
+
+// Worker threads and one search per worker, made once and reused for every batch
+struct BatchEvaluator {
+    ThreadPool pool;
+    std::vector<std::unique_ptr<Search>> searches;
+    BatchOptions options;
+};
+
+// threads <= 0 uses every hardware thread
+void startBatchEvaluator(BatchEvaluator& evaluator, int threads, const BatchOptions& options);
+void stopBatchEvaluator(BatchEvaluator& evaluator);
+
+// Fills the outputs of every valid position. Searches start from an empty
+// table, so their scores do not depend on the order positions are searched in.
+void evaluateBatch(BatchEvaluator& evaluator, PositionBatch& batch);
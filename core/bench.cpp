@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "threadpool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Openings, middlegames with castling and en passant, tactics, promotions
+// and endgames. Changing the set changes every signature.
+static const char* benchFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "rnbqkb1r/pp1p1ppp/4pn2/2pP4/2P5/8/PP2PPPP/RNBQKBNR w KQkq c6 0 4",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 3 8",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PNBPN2/PB3PPP/R2Q1RK1 b - - 1 10",
+    "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq - 1 5",
+    "r1b1kb1r/pp3ppp/2n1pn2/q1pp4/3P1B2/2P1PN2/PP1N1PPP/R2QKB1R w KQkq - 2 7",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "2rq1rk1/pp1bppbp/3p1np1/4n3/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 5 12",
+    "r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2NP1N2/PPP2PPP/R1BQ1RK1 w - - 0 7",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+    "2r3k1/pp3ppp/2n1b3/3p4/3P4/2NB1N2/PP3PPP/2R3K1 w - - 0 20",
+    "6k1/5ppp/8/8/8/8/1q3PPP/3R2K1 b - - 0 30",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 b - - 0 50",
+    "8/5pk1/6p1/8/3K4/8/5PPP/8 w - - 0 40",
+    "8/8/8/4k3/8/8/3QK3/8 w - - 0 60",
+};
+
+struct BenchPosition {
+    uint64_t nodes = 0;
+    Move bestMove = NO_MOVE;
+    int score = 0;
+    double seconds = 0;
+};
+
+// FNV-1a over the bytes of value
+static uint64_t hashValue(uint64_t hash, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+BenchResult runBench(int depth, int threads, ostream* report) {
+    const size_t count = sizeof(benchFens) / sizeof(benchFens[0]);
+    vector<BenchPosition> results(count);
+    ThreadPool pool;
+    startThreadPool(pool, threads);
+    vector<unique_ptr<Search>> searches;
+    for (int i = 0; i < poolWorkers(pool); i++) {
+        searches.emplace_back(new Search);
+        initSearch(*searches.back(), 16);
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<uint64_t> noHistory;
+    parallelFor(pool, count, [&](size_t index, int worker) {
+        Search& search = *searches[worker];
+        newGame(search);
+        search.stop = false;
+        Position pos;
+        setFromFen(pos, benchFens[index]);
+        SearchLimits limits;
+        limits.depth = depth;
+        auto positionStart = chrono::steady_clock::now();
+        SearchResult result = searchPosition(search, pos, limits, noHistory);
+        BenchPosition& bench = results[index];
+        bench.seconds = chrono::duration<double>(chrono::steady_clock::now() - positionStart).count();
+        bench.nodes = result.nodes;
+        bench.bestMove = result.bestMove;
+        bench.score = result.score;
+    });
+    BenchResult total;
+    total.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stopThreadPool(pool);
+
+    total.positions = int(count);
+    total.signature = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < count; i++) {
+        const BenchPosition& bench = results[i];
+        total.nodes += bench.nodes;
+        total.signature = hashValue(total.signature, bench.nodes);
+        total.signature = hashValue(total.signature, bench.bestMove);
+        total.signature = hashValue(total.signature, uint64_t(int64_t(bench.score)));
+        if (!report) continue;
+        char line[160];
+        snprintf(line, sizeof(line), "Position %2zu/%zu  %-6s %+6d  %10llu nodes  %8.3f s  %s",
+            i + 1, count, moveToUci(bench.bestMove).c_str(), bench.score, (unsigned long long)bench.nodes,
+            bench.seconds, benchFens[i]);
+        *report << line << "\n";
+    }
+    return total;
+}
+
+void printBenchResult(ostream& out, const BenchResult& result) {
+    char line[160];
+    snprintf(line, sizeof(line), "Total time (ms) : %llu\nNodes searched  : %llu\nNodes/second    : %llu\nSignature       : %016llx\n",
+        (unsigned long long)(result.seconds * 1000), (unsigned long long)result.nodes,
+        (unsigned long long)(result.nodes / (result.seconds > 0 ? result.seconds : 1e-9)),
+        (unsigned long long)result.signature);
+    out << line;
+    out.flush();
+}
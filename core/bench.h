@@ -0,0 +1,28 @@
+#pragma once
+// Bench: a fixed-depth search of a built-in set of positions, for checking
+// builds and patches. The node count and the signature change with any
+// functional change to move generation, evaluation or search, and the nodes
+// per second with any change in speed. Every position is searched by its own
+// search from an empty table, so the positions can be spread over threads
+// and the counts and signature do not depend on the thread count.
+
+#include "search.h"
+
+#include <cstdint>
+#include <ostream>
+
+const int BENCH_DEPTH = 8;
+
+struct BenchResult {
+    int positions = 0;
+    uint64_t nodes = 0;
+    uint64_t signature = 0;     // hash of every position's nodes, best move and score
+    double seconds = 0;
+};
+
+// threads <= 0 uses every hardware thread. Each position's result goes to
+// report, if given, in order once all are done.
+BenchResult runBench(int depth, int threads, std::ostream* report);
+
+// The summary lines: total time, nodes, nodes per second and signature
+void printBenchResult(std::ostream& out, const BenchResult& result);
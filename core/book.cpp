@@ -0,0 +1,96 @@
+#include "book.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+static bool entryLess(const BookEntry& a, const BookEntry& b) {
+    if (a.key != b.key) return a.key < b.key;
+    return a.weight > b.weight;
+}
+
+static bool validateMapping(OpeningBook& book) {
+    if (book.file.size < sizeof(BookHeader)) return false;
+    const BookHeader* header = static_cast<const BookHeader*>(book.file.data);
+    if (memcmp(header->magic, "CHBK", 4) != 0 || header->version != BOOK_VERSION) return false;
+    // Compared by division, so a huge entryCount cannot wrap the product
+    size_t bytes = book.file.size - sizeof(BookHeader);
+    if (bytes % sizeof(BookEntry) != 0 || header->entryCount != bytes / sizeof(BookEntry)) return false;
+    book.entries = reinterpret_cast<const BookEntry*>(header + 1);
+    book.count = size_t(header->entryCount);
+    return true;
+}
+
+bool openBook(OpeningBook& book, const string& path) {
+    closeBook(book);
+    // Probes jump around the file, so read-ahead would only waste I/O
+    if (!mapFile(book.file, path, true)) return false;
+    if (!validateMapping(book)) {
+        closeBook(book);
+        return false;
+    }
+    return true;
+}
+
+void closeBook(OpeningBook& book) {
+    unmapFile(book.file);
+    book = OpeningBook();
+}
+
+int probeBook(const OpeningBook& book, uint64_t key, BookEntry* out, int maxEntries) {
+    if (!book.entries) return 0;
+    // Binary search for the first entry with this key
+    size_t lo = 0, hi = book.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (book.entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    int count = 0;
+    while (lo < book.count && book.entries[lo].key == key && count < maxEntries) {
+        out[count++] = book.entries[lo++];
+    }
+    return count;
+}
+
+Move pickBookMove(const OpeningBook& book, Position& pos, uint64_t random) {
+    BookEntry entries[32];
+    int count = probeBook(book, pos.key, entries, 32);
+
+    // Keep only moves that are legal here, in case of a key collision
+    Move legal[MOVE_LIST_SIZE];
+    int legalCount = generateLegalMoves(pos, legal);
+    uint64_t total = 0;
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (find(legal, legal + legalCount, Move(entries[i].move)) == legal + legalCount) continue;
+        if (entries[i].weight == 0) continue;
+        entries[kept++] = entries[i];
+        total += entries[i].weight;
+    }
+    if (total == 0) return NO_MOVE;
+
+    uint64_t pick = random % total;
+    for (int i = 0; i < kept; i++) {
+        if (pick < entries[i].weight) return entries[i].move;
+        pick -= entries[i].weight;
+    }
+    return entries[0].move;
+}
+
+bool writeBook(const string& path, vector<BookEntry>& entries) {
+    sort(entries.begin(), entries.end(), entryLess);
+    ofstream out(path, ios::binary);
+    if (!out) return false;
+    BookHeader header;
+    memcpy(header.magic, "CHBK", 4);
+    header.version = BOOK_VERSION;
+    header.entryCount = entries.size();
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!entries.empty()) {
+        out.write(reinterpret_cast<const char*>(entries.data()), streamsize(entries.size() * sizeof(BookEntry)));
+    }
+    return bool(out);
+}
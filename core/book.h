@@ -0,0 +1,51 @@
+#pragma once
+// Opening book: a sorted array of (hash key, move, weight) entries that is
+// memory-mapped and probed with binary search, so opening a book costs no
+// more than mapping the file and a probe touches only a few cache lines.
+//
+// File layout (little-endian): BookHeader followed by entryCount BookEntry
+// records sorted by key, and by descending weight within a key.
+
+#include "mapping.h"
+#include "position.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BookHeader {
+    char magic[4];          // "CHBK"
+    uint32_t version;
+    uint64_t entryCount;
+};
+
+struct BookEntry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t games;         // number of games the move was played in
+};
+
+static_assert(sizeof(BookHeader) == 16, "book header must stay 16 bytes");
+static_assert(sizeof(BookEntry) == 16, "book entries must stay 16 bytes");
+
+const uint32_t BOOK_VERSION = 1;
+
+struct OpeningBook {
+    const BookEntry* entries = nullptr;
+    size_t count = 0;
+    FileMapping file;
+};
+
+bool openBook(OpeningBook& book, const std::string& path);
+void closeBook(OpeningBook& book);
+
+// Copies up to maxEntries entries for key into out, highest weight first
+int probeBook(const OpeningBook& book, uint64_t key, BookEntry* out, int maxEntries);
+
+// Picks a legal book move for pos with probability proportional to its weight.
+// random can be any 64-bit random number. Returns NO_MOVE when out of book.
+Move pickBookMove(const OpeningBook& book, Position& pos, uint64_t random);
+
+// Sorts the entries and writes them as a book file
+bool writeBook(const std::string& path, std::vector<BookEntry>& entries);
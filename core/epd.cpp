@@ -0,0 +1,73 @@
+#include "epd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+static bool isNumber(const string& text) {
+    return !text.empty() && all_of(text.begin(), text.end(), [](char c) { return isdigit((unsigned char)c) != 0; });
+}
+
+bool readFenFields(istream& in, string& fen) {
+    string placement, side, castling, ep, halfmove, fullmove;
+    if (!(in >> placement >> side >> castling >> ep)) return false;
+    fen = placement + " " + side + " " + castling + " " + ep;
+    streampos operations = in.tellg();
+    if (in >> halfmove >> fullmove && isNumber(halfmove) && isNumber(fullmove)) {
+        fen += " " + halfmove + " " + fullmove;
+        return true;
+    }
+    in.clear();
+    in.seekg(operations);
+    fen += " 0 1";
+    return true;
+}
+
+string lineToFen(const string& line) {
+    istringstream fields(line);
+    string fen;
+    return readFenFields(fields, fen) ? fen : "";
+}
+
+bool readEpdFile(const string& path, vector<EpdPosition>& positions) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        EpdPosition position;
+        if (!readFenFields(fields, position.fen)) continue;
+        string operation;
+        while (getline(fields, operation, ';')) {
+            istringstream words(operation);
+            string opcode, word;
+            words >> opcode;
+            if (opcode == "bm" || opcode == "am") {
+                vector<string>& moves = opcode == "bm" ? position.bestMoves : position.avoidMoves;
+                while (words >> word) moves.push_back(word);
+            }
+            else if (opcode == "id") {
+                getline(words >> ws, word);
+                if (word.size() >= 2 && word.front() == '"') word = word.substr(1, word.size() - 2);
+                position.id = word;
+            }
+        }
+        if (!position.bestMoves.empty() || !position.avoidMoves.empty()) positions.push_back(position);
+    }
+    return true;
+}
+
+bool epdSolved(Position& pos, const EpdPosition& epd, Move played) {
+    if (played == NO_MOVE) return false;
+    for (const string& san : epd.avoidMoves) {
+        if (parseSanMove(pos, san) == played) return false;
+    }
+    if (epd.bestMoves.empty()) return true;
+    for (const string& san : epd.bestMoves) {
+        if (parseSanMove(pos, san) == played) return true;
+    }
+    return false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+// EPD test suites: positions given by the four FEN fields plus operations,
+// of which "bm" (best moves), "am" (moves to avoid) and "id" are read. A
+// position is solved by playing one of its best moves, if it has any, and
+// none of the moves it should avoid.
+
+#include "position.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+struct EpdPosition {
+    std::string fen;                    // completed by readFenFields
+    std::string id;
+    std::vector<std::string> bestMoves; // SAN
+    std::vector<std::string> avoidMoves;
+};
+
+// Reads the four FEN fields of a FEN or EPD line into fen, with the move
+// counters that follow them if both are numbers, otherwise completed with
+// "0 1". The stream is left at the EPD operations, if any. False if there
+// are fewer than four fields.
+bool readFenFields(std::istream& in, std::string& fen);
+
+// The FEN of a FEN or EPD line (see readFenFields), or "" if it has none
+std::string lineToFen(const std::string& line);
+
+// Reads the positions that have "bm" or "am" from lines like
+// <4 FEN fields> bm Qg6; id "WAC.001";
+bool readEpdFile(const std::string& path, std::vector<EpdPosition>& positions);
+
+bool epdSolved(Position& pos, const EpdPosition& epd, Move played);
@@ -0,0 +1,99 @@
+#include "eval.h"
+#include "evalparams.h"
+#include "instrument.h"
+
+#include <algorithm>
+
+using namespace std;
+
+const int pieceValue[7] = { 0, 0, QUEEN_VALUE, BISHOP_VALUE, KNIGHT_VALUE, ROOK_VALUE, PAWN_VALUE };
+
+static const int* const pieceTables[7] = {
+    nullptr, kingMiddlegameTable, queenTable, bishopTable, knightTable, rookTable, pawnTable
+};
+
+// Game phase weights: 24 with all minor and major pieces on the board
+static const int phaseWeight[7] = { 0, 0, 4, 1, 1, 2, 0 };
+
+int gamePhase(const Position& pos) {
+    int phase = 0;
+    for (int sq = 0; sq < 64; sq++) phase += phaseWeight[pieceKind(pos.board[sq])];
+    return phase > MAX_PHASE ? MAX_PHASE : phase;
+}
+
+int evaluate(const Position& pos) {
+    INSTRUMENT_COUNT(COUNTER_EVALUATIONS);
+    int middlegame = 0, endgame = 0, phase = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        int piece = pos.board[sq];
+        if (piece == NONE) continue;
+        int kind = pieceKind(piece);
+        bool white = isWhite(piece);
+        int tableSq = white ? sq : sq ^ 56;
+        int sign = white ? 1 : -1;
+
+        int mg = pieceValue[kind] + pieceTables[kind][tableSq];
+        int eg = kind == W_KING ? kingEndgameTable[tableSq] : mg;
+        middlegame += sign * mg;
+        endgame += sign * eg;
+        phase += phaseWeight[kind];
+    }
+    if (phase > MAX_PHASE) phase = MAX_PHASE;
+    int score = (middlegame * phase + endgame * (MAX_PHASE - phase)) / MAX_PHASE;
+    return pos.whiteToMove ? score : -score;
+}
+
+// ========== BATCH EVALUATION ==========
+
+// The terms of evaluate() per square and coloured piece, signed for White,
+// with NONE contributing nothing. Indexed [sq][piece] so one square's row is
+// all a block needs.
+struct SquareTerms {
+    int32_t middlegame[64][13];
+    int32_t endgame[64][13];
+    int32_t phase[13];
+};
+
+static SquareTerms buildSquareTerms() {
+    SquareTerms terms = {};
+    for (int piece = W_KING; piece <= B_PAWN; piece++) {
+        int kind = pieceKind(piece);
+        bool white = isWhite(piece);
+        int sign = white ? 1 : -1;
+        for (int sq = 0; sq < 64; sq++) {
+            int tableSq = white ? sq : sq ^ 56;
+            int mg = pieceValue[kind] + pieceTables[kind][tableSq];
+            int eg = kind == W_KING ? kingEndgameTable[tableSq] : mg;
+            terms.middlegame[sq][piece] = sign * mg;
+            terms.endgame[sq][piece] = sign * eg;
+        }
+        terms.phase[piece] = phaseWeight[kind];
+    }
+    return terms;
+}
+
+const size_t EVALUATION_BLOCK = 64;
+
+void evaluateMany(const uint8_t* boards, size_t stride, const uint8_t* whiteToMove, size_t count, int32_t* scores) {
+    static const SquareTerms terms = buildSquareTerms();
+    INSTRUMENT_ADD(COUNTER_EVALUATIONS, count);
+    for (size_t start = 0; start < count; start += EVALUATION_BLOCK) {
+        size_t n = min(EVALUATION_BLOCK, count - start);
+        int32_t middlegame[EVALUATION_BLOCK] = {}, endgame[EVALUATION_BLOCK] = {}, phase[EVALUATION_BLOCK] = {};
+        for (int sq = 0; sq < 64; sq++) {
+            const uint8_t* pieces = boards + sq * stride + start;
+            const int32_t* mg = terms.middlegame[sq];
+            const int32_t* eg = terms.endgame[sq];
+            for (size_t i = 0; i < n; i++) {
+                middlegame[i] += mg[pieces[i]];
+                endgame[i] += eg[pieces[i]];
+                phase[i] += terms.phase[pieces[i]];
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            int p = min(phase[i], int32_t(MAX_PHASE));
+            int score = (middlegame[i] * p + endgame[i] * (MAX_PHASE - p)) / MAX_PHASE;
+            scores[start + i] = whiteToMove[start + i] ? score : -score;
+        }
+    }
+}
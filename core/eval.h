@@ -0,0 +1,26 @@
+#pragma once
+// Static evaluation: material plus piece-square tables, tapered between
+// middlegame and endgame by the amount of material left on the board. The
+// values and tables are in evalparams.h, generated by tools/tuner.cpp.
+
+#include "position.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Material values indexed by colourless piece kind (W_KING..W_PAWN)
+extern const int pieceValue[7];
+
+// Game phase from 0 (kings and pawns only) to MAX_PHASE (every minor and
+// major piece still on the board), which weights the middlegame terms
+const int MAX_PHASE = 24;
+int gamePhase(const Position& pos);
+
+// Score in centipawns from the side to move's point of view
+int evaluate(const Position& pos);
+
+// evaluate() for count positions at once, stored as structure of arrays:
+// boards[sq * stride + i] is the piece on sq in position i. The positions are
+// scored in blocks, one square of the whole block at a time, which leaves the
+// inner loop free of branches for the compiler to vectorise.
+void evaluateMany(const uint8_t* boards, size_t stride, const uint8_t* whiteToMove, size_t count, int32_t* scores);
@@ -0,0 +1,424 @@
+#include "gameindex.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+using namespace std;
+
+// ========== POSTINGS ENCODING ==========
+
+static void putVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += char(value | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+// False if the varint runs past end or is longer than 64 bits allow
+static bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// ========== QUERIES ==========
+
+static bool validateIndex(GameIndex& index) {
+    size_t size = index.file.size;
+    if (size < sizeof(IndexHeader)) return false;
+    const uint8_t* base = static_cast<const uint8_t*>(index.file.data);
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(base);
+    if (memcmp(header->magic, "CHGI", 4) != 0 || header->version != GAME_INDEX_VERSION) return false;
+    // Section sizes are checked by division so that huge counts cannot wrap
+    if (header->postingsOffset < sizeof(IndexHeader) || header->postingsOffset > header->keysOffset ||
+        header->keysOffset % 8 != 0 || header->keysOffset > size ||
+        header->keyCount > (size - header->keysOffset) / sizeof(IndexKey) ||
+        header->keysOffset + header->keyCount * sizeof(IndexKey) != header->gamesOffset ||
+        header->gameCount > (size - header->gamesOffset) / sizeof(IndexedGame) ||
+        header->gamesOffset + header->gameCount * sizeof(IndexedGame) != header->namesOffset) {
+        return false;
+    }
+    index.header = header;
+    index.postings = base + header->postingsOffset;
+    index.postingsEnd = base + header->keysOffset;
+    index.keys = reinterpret_cast<const IndexKey*>(base + header->keysOffset);
+    index.games = reinterpret_cast<const IndexedGame*>(base + header->gamesOffset);
+    uint64_t postingsSize = header->keysOffset - header->postingsOffset;
+    for (uint64_t i = 0; i < header->keyCount; i++) {
+        if (index.keys[i].postings >= postingsSize) return false;
+    }
+
+    const char* name = reinterpret_cast<const char*>(base + header->namesOffset);
+    const char* end = reinterpret_cast<const char*>(base + size);
+    for (uint32_t i = 0; i < header->fileCount; i++) {
+        const char* nul = static_cast<const char*>(memchr(name, 0, size_t(end - name)));
+        if (!nul) return false;
+        index.files.push_back(string(name, nul));
+        name = nul + 1;
+    }
+    return true;
+}
+
+bool openGameIndex(GameIndex& index, const string& path) {
+    closeGameIndex(index);
+    if (!mapFile(index.file, path, true)) return false;
+    if (!validateIndex(index)) {
+        closeGameIndex(index);
+        return false;
+    }
+    return true;
+}
+
+void closeGameIndex(GameIndex& index) {
+    unmapFile(index.file);
+    index = GameIndex();
+}
+
+// The start of key's postings, or nullptr if no game reached it
+static const uint8_t* findPostings(const GameIndex& index, uint64_t key) {
+    if (!index.header) return nullptr;
+    const IndexKey* end = index.keys + index.header->keyCount;
+    const IndexKey* it = lower_bound(index.keys, end, key,
+        [](const IndexKey& entry, uint64_t k) { return entry.key < k; });
+    if (it == end || it->key != key) return nullptr;
+    return index.postings + it->postings;
+}
+
+// The next game id of a postings list, false at a damaged entry: one that
+// runs past the postings or names a game the index does not have
+static bool nextGame(const GameIndex& index, const uint8_t*& p, uint64_t& id) {
+    uint64_t gap;
+    if (!getVarint(p, index.postingsEnd, gap) || gap >= index.header->gameCount - id) return false;
+    id += gap;
+    return true;
+}
+
+uint64_t findGames(const GameIndex& index, uint64_t key, vector<uint32_t>& ids, size_t maxIds) {
+    ids.clear();
+    const uint8_t* p = findPostings(index, key);
+    uint64_t count;
+    if (!p || !getVarint(p, index.postingsEnd, count)) return 0;
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < count && ids.size() < maxIds; i++) {
+        if (!nextGame(index, p, id)) return ids.size();
+        ids.push_back(uint32_t(id));
+    }
+    return count;
+}
+
+uint64_t countResults(const GameIndex& index, uint64_t key, uint64_t results[4]) {
+    results[0] = results[1] = results[2] = results[3] = 0;
+    const uint8_t* p = findPostings(index, key);
+    uint64_t count;
+    if (!p || !getVarint(p, index.postingsEnd, count)) return 0;
+    uint64_t id = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (!nextGame(index, p, id)) return i;
+        results[index.games[id].result & 3]++;
+    }
+    return count;
+}
+
+bool loadIndexedGame(const GameIndex& index, const string& indexPath, uint32_t id, PgnGame& game) {
+    if (!index.header || id >= index.header->gameCount) return false;
+    const IndexedGame& indexed = index.games[id];
+    if (indexed.file >= index.files.size()) return false;
+    const string& path = index.files[indexed.file];
+    ifstream in(path, ios::binary);
+    size_t slash = indexPath.find_last_of("/\\");
+    bool relative = !path.empty() && path[0] != '/' && path[0] != '\\' && path.find(':') == string::npos;
+    if (!in && relative && slash != string::npos) in.open(indexPath.substr(0, slash + 1) + path, ios::binary);
+    if (!in) return false;
+    in.seekg(streamoff(indexed.offset));
+    return readPgnGame(in, game);
+}
+
+// ========== BUILDING ==========
+
+// One position of one game; sorted by key, then game
+struct KeyGame {
+    uint64_t key;
+    uint32_t game;
+};
+
+static bool keyGameLess(const KeyGame& a, const KeyGame& b) {
+    if (a.key != b.key) return a.key < b.key;
+    return a.game < b.game;
+}
+
+const size_t BATCH_GAMES = 4096;
+const size_t RUN_BLOCK = 1 << 16;   // pairs per read or write of a run file
+
+// The PGN files read in order, one batch of games at a time
+struct PgnSource {
+    const vector<string>* paths;
+    size_t next = 0;
+    ifstream in;
+    uint32_t file = 0;
+};
+
+static size_t readBatch(PgnSource& source, vector<PgnGame>& games, vector<IndexedGame>& indexed) {
+    size_t count = 0;
+    while (count < games.size()) {
+        if (!source.in.is_open()) {
+            if (source.next >= source.paths->size()) break;
+            source.file = uint32_t(source.next);
+            source.in.open((*source.paths)[source.next++], ios::binary);
+            continue;
+        }
+        streamoff offset = source.in.tellg();
+        if (offset < 0 || !readPgnGame(source.in, games[count])) {
+            source.in.close();
+            source.in.clear();
+            continue;
+        }
+        IndexedGame& game = indexed[count++];
+        game = IndexedGame();
+        game.offset = uint64_t(offset);
+        game.file = source.file;
+        game.result = uint8_t(games[count - 1].result);
+    }
+    return count;
+}
+
+// Sorts the workers' buffers in parallel and merges them into one run file
+static bool spillRun(vector<vector<KeyGame>>& buffers, ThreadPool& pool, const string& path) {
+    parallelFor(pool, buffers.size(), [&](size_t i, int) {
+        sort(buffers[i].begin(), buffers[i].end(), keyGameLess);
+    });
+    ofstream out(path, ios::binary);
+    vector<size_t> next(buffers.size(), 0);
+    vector<KeyGame> block;
+    block.reserve(RUN_BLOCK);
+    for (;;) {
+        int best = -1;
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (next[i] == buffers[i].size()) continue;
+            if (best < 0 || keyGameLess(buffers[i][next[i]], buffers[best][next[best]])) best = int(i);
+        }
+        if (best >= 0) block.push_back(buffers[best][next[best]++]);
+        if (block.size() == RUN_BLOCK || (best < 0 && !block.empty())) {
+            out.write(reinterpret_cast<const char*>(block.data()), streamsize(block.size() * sizeof(KeyGame)));
+            block.clear();
+        }
+        if (best < 0) break;
+    }
+    for (vector<KeyGame>& buffer : buffers) buffer.clear();
+    return bool(out);
+}
+
+struct RunReader {
+    ifstream in;
+    vector<KeyGame> block;
+    size_t next = 0;
+};
+
+static bool refill(RunReader& run) {
+    run.block.resize(RUN_BLOCK);
+    run.in.read(reinterpret_cast<char*>(run.block.data()), streamsize(RUN_BLOCK * sizeof(KeyGame)));
+    run.block.resize(size_t(run.in.gcount()) / sizeof(KeyGame));
+    run.next = 0;
+    return !run.block.empty();
+}
+
+struct RunHead {
+    KeyGame pair;
+    size_t run;
+};
+
+// Merges the runs into postings (written to out) and keys (written to keysOut)
+static void mergeRuns(const vector<string>& runPaths, ofstream& out, ofstream& keysOut, IndexBuildStats& stats) {
+    vector<RunReader> runs(runPaths.size());
+    vector<RunHead> heap;
+    // Smallest pair on top
+    auto later = [](const RunHead& a, const RunHead& b) { return keyGameLess(b.pair, a.pair); };
+    for (size_t i = 0; i < runs.size(); i++) {
+        runs[i].in.open(runPaths[i], ios::binary);
+        if (refill(runs[i])) heap.push_back({ runs[i].block[runs[i].next++], i });
+    }
+    make_heap(heap.begin(), heap.end(), later);
+
+    uint64_t postingsBytes = 0;
+    uint64_t key = 0;
+    vector<uint32_t> ids;
+    string encoded;
+    auto flushKey = [&]() {
+        if (ids.empty()) return;
+        IndexKey entry = { key, postingsBytes };
+        keysOut.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        encoded.clear();
+        putVarint(encoded, ids.size());
+        uint32_t previous = 0;
+        for (uint32_t id : ids) {
+            putVarint(encoded, id - previous);
+            previous = id;
+        }
+        out.write(encoded.data(), streamsize(encoded.size()));
+        postingsBytes += encoded.size();
+        stats.keys++;
+        stats.postings += ids.size();
+        ids.clear();
+    };
+
+    while (!heap.empty()) {
+        pop_heap(heap.begin(), heap.end(), later);
+        RunHead head = heap.back();
+        heap.pop_back();
+        RunReader& run = runs[head.run];
+        if (run.next < run.block.size() || refill(run)) {
+            heap.push_back({ run.block[run.next++], head.run });
+            push_heap(heap.begin(), heap.end(), later);
+        }
+
+        if (head.pair.key != key) {
+            flushKey();
+            key = head.pair.key;
+        }
+        // A position repeated within a game lists the game once
+        if (ids.empty() || ids.back() != head.pair.game) ids.push_back(head.pair.game);
+    }
+    flushKey();
+}
+
+static bool appendFile(ofstream& out, const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    if (in.peek() != EOF) out << in.rdbuf();
+    return bool(out);
+}
+
+static void padTo8(ofstream& out) {
+    static const char zeros[8] = {};
+    streamoff position = out.tellp();
+    if (position % 8) out.write(zeros, 8 - position % 8);
+}
+
+bool buildGameIndex(const vector<string>& pgnFiles, const string& output,
+    const IndexBuildOptions& options, IndexBuildStats& stats) {
+    auto start = chrono::steady_clock::now();
+    stats = IndexBuildStats();
+    for (const string& path : pgnFiles) {
+        if (!ifstream(path)) {
+            stats.error = "cannot open " + path;
+            return false;
+        }
+    }
+    string gamesPath = output + ".games.tmp", keysPath = output + ".keys.tmp";
+    ofstream gamesOut(gamesPath, ios::binary);
+    if (!gamesOut) {
+        stats.error = "cannot write next to " + output;
+        return false;
+    }
+
+    ThreadPool pool;
+    startThreadPool(pool, options.threads);
+    int workers = poolWorkers(pool);
+    vector<vector<KeyGame>> buffers(workers);
+    size_t maxBuffered = max<size_t>(1, options.memoryMb) * 1024 * 1024 / sizeof(KeyGame);
+    vector<string> runPaths;
+    atomic<uint64_t> truncated(0);
+
+    // The next batch is read while the current one is replayed on the pool
+    PgnSource source;
+    source.paths = &pgnFiles;
+    vector<PgnGame> games(BATCH_GAMES), nextGames(BATCH_GAMES);
+    vector<IndexedGame> indexed(BATCH_GAMES), nextIndexed(BATCH_GAMES);
+    size_t count = readBatch(source, games, indexed);
+    while (count > 0) {
+        size_t nextCount = 0;
+        thread reader([&]() { nextCount = readBatch(source, nextGames, nextIndexed); });
+
+        uint32_t firstId = uint32_t(stats.games);
+        parallelFor(pool, count, [&](size_t i, int worker) {
+            const PgnGame& game = games[i];
+            IndexedGame& entry = indexed[i];
+            Position pos;
+            if (!pgnStartPosition(game, pos)) {
+                entry.skipped = 1;
+                return;
+            }
+            uint32_t id = firstId + uint32_t(i);
+            vector<KeyGame>& buffer = buffers[size_t(worker)];
+            buffer.push_back({ pos.key, id });
+            size_t plies = game.moves.size();
+            if (options.maxPly > 0) plies = min(plies, size_t(options.maxPly));
+            size_t ply = 0;
+            for (; ply < plies; ply++) {
+                Move m = parseSanMove(pos, game.moves[ply]);
+                if (m == NO_MOVE) break;
+                UndoInfo undo;
+                makeMove(pos, m, undo);
+                buffer.push_back({ pos.key, id });
+            }
+            if (ply < plies) truncated.fetch_add(1, memory_order_relaxed);
+            entry.plies = uint16_t(min<size_t>(ply, UINT16_MAX));
+        });
+        for (size_t i = 0; i < count; i++) stats.skipped += indexed[i].skipped;
+        gamesOut.write(reinterpret_cast<const char*>(indexed.data()), streamsize(count * sizeof(IndexedGame)));
+        stats.games += count;
+
+        size_t buffered = 0;
+        for (const vector<KeyGame>& buffer : buffers) buffered += buffer.size();
+        if (buffered >= maxBuffered) {
+            runPaths.push_back(output + ".run" + to_string(runPaths.size()) + ".tmp");
+            spillRun(buffers, pool, runPaths.back());
+        }
+
+        reader.join();
+        games.swap(nextGames);
+        indexed.swap(nextIndexed);
+        count = nextCount;
+    }
+    runPaths.push_back(output + ".run" + to_string(runPaths.size()) + ".tmp");
+    bool ok = spillRun(buffers, pool, runPaths.back());
+    stopThreadPool(pool);
+    gamesOut.close();
+    stats.truncated = truncated;
+    stats.runs = runPaths.size();
+
+    IndexHeader header = {};
+    memcpy(header.magic, "CHGI", 4);
+    header.version = GAME_INDEX_VERSION;
+    header.gameCount = stats.games;
+    header.fileCount = uint32_t(pgnFiles.size());
+    header.maxPly = uint32_t(max(0, options.maxPly));
+    ofstream out(output, ios::binary);
+    ofstream keysOut(keysPath, ios::binary);
+    ok = ok && gamesOut && out && keysOut;
+    if (ok) {
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        header.postingsOffset = sizeof(header);
+        mergeRuns(runPaths, out, keysOut, stats);
+        keysOut.close();
+        header.keyCount = stats.keys;
+        padTo8(out);
+        header.keysOffset = uint64_t(out.tellp());
+        ok = appendFile(out, keysPath);
+        header.gamesOffset = uint64_t(out.tellp());
+        ok = ok && appendFile(out, gamesPath);
+        header.namesOffset = uint64_t(out.tellp());
+        for (const string& path : pgnFiles) out.write(path.c_str(), streamsize(path.size() + 1));
+        stats.bytes = uint64_t(out.tellp());
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ok = ok && bool(out);
+    }
+    if (!ok) stats.error = "cannot write " + output;
+
+    for (const string& path : runPaths) remove(path.c_str());
+    remove(keysPath.c_str());
+    remove(gamesPath.c_str());
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return ok;
+}
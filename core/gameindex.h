@@ -0,0 +1,101 @@
+#pragma once
+// Position index over PGN archives: for every position reached in any
+// indexed game, the ids of the games that reached it. The index is built
+// once with the games replayed on all cores, then memory-mapped, and a
+// lookup is a binary search over the sorted keys plus a short decode.
+//
+// File layout (little-endian): IndexHeader, the postings, the key table, the
+// game table and the names of the indexed PGN files, each NUL-terminated.
+// Each key's postings are its game count and then its ascending game ids as
+// gaps, all LEB128 varints; a list ends where the next key's begins.
+
+#include "mapping.h"
+#include "pgn.h"
+#include "position.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct IndexHeader {
+    char magic[4];          // "CHGI"
+    uint32_t version;
+    uint64_t gameCount;
+    uint64_t keyCount;
+    uint64_t postingsOffset;    // sections, from the start of the file
+    uint64_t keysOffset;
+    uint64_t gamesOffset;
+    uint64_t namesOffset;
+    uint32_t fileCount;
+    uint32_t maxPly;            // plies indexed per game, 0 = all
+};
+
+struct IndexKey {
+    uint64_t key;
+    uint64_t postings;      // from postingsOffset
+};
+
+struct IndexedGame {
+    uint64_t offset;        // of the game in its PGN file
+    uint32_t file;
+    uint16_t plies;         // moves replayed (up to an illegal move, if any)
+    uint8_t result;         // RESULT_*
+    uint8_t skipped;        // 1 if the game could not be replayed at all
+};
+
+static_assert(sizeof(IndexHeader) == 64, "index header must stay 64 bytes");
+static_assert(sizeof(IndexKey) == 16, "index keys must stay 16 bytes");
+static_assert(sizeof(IndexedGame) == 16, "indexed games must stay 16 bytes");
+
+const uint32_t GAME_INDEX_VERSION = 1;
+
+// ========== QUERIES ==========
+
+struct GameIndex {
+    const IndexHeader* header = nullptr;
+    const uint8_t* postings = nullptr;
+    const uint8_t* postingsEnd = nullptr;  // where the key table starts
+    const IndexKey* keys = nullptr;
+    const IndexedGame* games = nullptr;
+    std::vector<std::string> files;     // PGN paths as given when building
+    FileMapping file;
+};
+
+bool openGameIndex(GameIndex& index, const std::string& path);
+void closeGameIndex(GameIndex& index);
+
+// Copies the ids of the first maxIds games that reached key (in archive
+// order) into ids. Returns how many games reached it in all.
+uint64_t findGames(const GameIndex& index, uint64_t key, std::vector<uint32_t>& ids, size_t maxIds);
+
+// Adds up the results of every game that reached key, indexed by RESULT_*
+uint64_t countResults(const GameIndex& index, uint64_t key, uint64_t results[4]);
+
+// Reads a game back from its PGN file. Relative paths that do not resolve
+// from the working directory are tried next to the index file.
+bool loadIndexedGame(const GameIndex& index, const std::string& indexPath, uint32_t id, PgnGame& game);
+
+// ========== BUILDING ==========
+
+struct IndexBuildOptions {
+    int threads = 0;            // 0 = all cores
+    int maxPly = 0;             // 0 = whole games
+    size_t memoryMb = 512;      // for (key, game) pairs before they are sorted out to disk
+};
+
+struct IndexBuildStats {
+    uint64_t games = 0;
+    uint64_t skipped = 0;       // no usable start position
+    uint64_t truncated = 0;     // stopped at an illegal move
+    uint64_t postings = 0;      // (position, game) pairs after duplicates within a game
+    uint64_t keys = 0;
+    uint64_t bytes = 0;
+    size_t runs = 0;            // sorted runs spilled to disk
+    double seconds = 0;
+    std::string error;
+};
+
+// Replays every game of the PGN files in parallel and writes the index.
+// Sorted runs are spilled next to the output and merged at the end.
+bool buildGameIndex(const std::vector<std::string>& pgnFiles, const std::string& output,
+    const IndexBuildOptions& options, IndexBuildStats& stats);
@@ -0,0 +1,209 @@
+#pragma once
+// Static board geometry, generated by the compiler: step attacks, sliding
+// rays, between and line masks, distances and castling paths. Everything is
+// constexpr, so the tables live in read-only data and nothing is initialised
+// at startup.
+//
+// Squares use the numbering of position.h (row * 8 + col, row 0 = rank 8),
+// and a Bitboard has bit sq set for square sq.
+
+#include "position.h"
+
+#include <array>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+typedef uint64_t Bitboard;
+
+constexpr Bitboard squareBit(int sq) { return Bitboard(1) << sq; }
+
+// Index of the lowest set bit; b must not be zero
+inline int lsb(Bitboard b) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, b);
+    return int(index);
+#else
+    return __builtin_ctzll(b);
+#endif
+}
+
+// Removes the lowest set bit and returns its square
+inline int popLsb(Bitboard& b) {
+    int sq = lsb(b);
+    b &= b - 1;
+    return sq;
+}
+
+inline int popCount(Bitboard b) {
+#ifdef _MSC_VER
+    return int(__popcnt64(b));
+#else
+    return __builtin_popcountll(b);
+#endif
+}
+
+// Ray directions. The first four are the rook directions, the last four the
+// bishop directions, in the same order as the row/column step tables.
+enum Direction { DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT, DIR_UP_LEFT, DIR_UP_RIGHT, DIR_DOWN_LEFT, DIR_DOWN_RIGHT };
+
+constexpr int directionDr[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+constexpr int directionDc[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+
+// The squares along one direction from a square, nearest first
+struct Ray {
+    int8_t squares[7];
+    int8_t length;
+};
+
+typedef std::array<Bitboard, 64> SquareMasks;
+
+namespace geometry_detail {
+
+constexpr bool onBoard(int r, int c) { return r >= 0 && r < 8 && c >= 0 && c < 8; }
+
+constexpr SquareMasks stepAttacks(const int (&dr)[8], const int (&dc)[8]) {
+    SquareMasks masks{};
+    for (int sq = 0; sq < 64; sq++) {
+        for (int i = 0; i < 8; i++) {
+            int r = sq / 8 + dr[i], c = sq % 8 + dc[i];
+            if (onBoard(r, c)) masks[sq] |= squareBit(r * 8 + c);
+        }
+    }
+    return masks;
+}
+
+constexpr int knightDr[8] = { -2, -1, 1, 2, 2, 1, -1, -2 };
+constexpr int knightDc[8] = { 1, 2, 2, 1, -1, -2, -2, -1 };
+
+// [0] white pawns (moving towards row 0), [1] black pawns
+constexpr std::array<SquareMasks, 2> pawnAttackMasks() {
+    std::array<SquareMasks, 2> masks{};
+    for (int sq = 0; sq < 64; sq++) {
+        for (int side = 0; side < 2; side++) {
+            int r = sq / 8 + (side == 0 ? -1 : 1);
+            for (int dc = -1; dc <= 1; dc += 2) {
+                int c = sq % 8 + dc;
+                if (onBoard(r, c)) masks[side][sq] |= squareBit(r * 8 + c);
+            }
+        }
+    }
+    return masks;
+}
+
+constexpr std::array<std::array<Ray, 64>, 8> rayTable() {
+    std::array<std::array<Ray, 64>, 8> rays{};
+    for (int d = 0; d < 8; d++) {
+        for (int sq = 0; sq < 64; sq++) {
+            Ray& ray = rays[d][sq];
+            int r = sq / 8 + directionDr[d], c = sq % 8 + directionDc[d];
+            while (onBoard(r, c)) {
+                ray.squares[ray.length++] = int8_t(r * 8 + c);
+                r += directionDr[d];
+                c += directionDc[d];
+            }
+        }
+    }
+    return rays;
+}
+
+constexpr std::array<SquareMasks, 64> betweenMasks() {
+    std::array<SquareMasks, 64> masks{};
+    for (int from = 0; from < 64; from++) {
+        for (int d = 0; d < 8; d++) {
+            Bitboard passed = 0;
+            int r = from / 8 + directionDr[d], c = from % 8 + directionDc[d];
+            while (onBoard(r, c)) {
+                masks[from][r * 8 + c] = passed;
+                passed |= squareBit(r * 8 + c);
+                r += directionDr[d];
+                c += directionDc[d];
+            }
+        }
+    }
+    return masks;
+}
+
+// Which rank, file, diagonal or anti-diagonal a square is on (kind 0..3)
+constexpr int lineIndex(int sq, int kind) {
+    return kind == 0 ? sq / 8 : kind == 1 ? sq % 8 : kind == 2 ? sq / 8 - sq % 8 : sq / 8 + sq % 8;
+}
+
+constexpr std::array<SquareMasks, 64> lineMasks() {
+    std::array<SquareMasks, 64> masks{};
+    for (int from = 0; from < 64; from++) {
+        for (int kind = 0; kind < 4; kind++) {
+            Bitboard line = 0;
+            for (int sq = 0; sq < 64; sq++) {
+                if (lineIndex(sq, kind) == lineIndex(from, kind)) line |= squareBit(sq);
+            }
+            for (int to = 0; to < 64; to++) {
+                if (to != from && (line & squareBit(to))) masks[from][to] = line;
+            }
+        }
+    }
+    return masks;
+}
+
+constexpr std::array<std::array<uint8_t, 64>, 64> distanceTable() {
+    std::array<std::array<uint8_t, 64>, 64> distance{};
+    for (int a = 0; a < 64; a++) {
+        for (int b = 0; b < 64; b++) {
+            int dr = a / 8 - b / 8, dc = a % 8 - b % 8;
+            dr = dr < 0 ? -dr : dr;
+            dc = dc < 0 ? -dc : dc;
+            distance[a][b] = uint8_t(dr > dc ? dr : dc);
+        }
+    }
+    return distance;
+}
+
+} // namespace geometry_detail
+
+inline constexpr SquareMasks knightAttacks = geometry_detail::stepAttacks(geometry_detail::knightDr, geometry_detail::knightDc);
+inline constexpr SquareMasks kingAttacks = geometry_detail::stepAttacks(
+    { -1, -1, -1, 0, 0, 1, 1, 1 }, { -1, 0, 1, -1, 1, -1, 0, 1 });
+
+// Squares a pawn of the given side ([0] white, [1] black) on sq attacks.
+// Read the other way round, pawnAttacks[1][sq] are the squares from which a
+// white pawn attacks sq.
+inline constexpr std::array<SquareMasks, 2> pawnAttacks = geometry_detail::pawnAttackMasks();
+
+// rays[direction][sq]
+inline constexpr std::array<std::array<Ray, 64>, 8> rays = geometry_detail::rayTable();
+
+// Squares strictly between two squares on a common line, 0 if there is none
+inline constexpr std::array<SquareMasks, 64> betweenSquares = geometry_detail::betweenMasks();
+
+// The whole rank, file or diagonal through two squares, 0 if they are not aligned
+inline constexpr std::array<SquareMasks, 64> lineThrough = geometry_detail::lineMasks();
+
+// King-move (Chebyshev) distance
+inline constexpr std::array<std::array<uint8_t, 64>, 64> squareDistance = geometry_detail::distanceTable();
+
+// Castling, indexed like the rights bits: 0 white kingside, 1 white queenside,
+// 2 black kingside, 3 black queenside
+struct CastlingPath {
+    int right;          // CASTLE_* bit
+    int kingFrom, kingTo;
+    int rookFrom, rookTo;
+    Bitboard empty;     // squares that must be empty
+    // King start and the square it passes, which must not be attacked. The
+    // destination is left to the ordinary legality check.
+    Bitboard safe;
+};
+
+inline constexpr CastlingPath castlingPaths[4] = {
+    { CASTLE_WK, 60, 62, 63, 61, squareBit(61) | squareBit(62), squareBit(60) | squareBit(61) },
+    { CASTLE_WQ, 60, 58, 56, 59, squareBit(57) | squareBit(58) | squareBit(59), squareBit(60) | squareBit(59) },
+    { CASTLE_BK, 4, 6, 7, 5, squareBit(5) | squareBit(6), squareBit(4) | squareBit(5) },
+    { CASTLE_BQ, 4, 2, 0, 3, squareBit(1) | squareBit(2) | squareBit(3), squareBit(4) | squareBit(3) },
+};
+
+// The tables are evaluated by the compiler, so they can be checked by it too
+static_assert(betweenSquares[60][63] == (squareBit(61) | squareBit(62)), "between masks");
+static_assert(lineThrough[0][9] == lineThrough[63][54] && (lineThrough[0][9] & squareBit(36)), "line masks");
+static_assert(squareDistance[0][63] == 7 && rays[DIR_DOWN_RIGHT][0].length == 7, "rays and distances");
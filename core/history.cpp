@@ -0,0 +1,79 @@
+#include "history.h"
+
+using namespace std;
+
+void historyReset(GameHistory& history, const Position& start) {
+    history.start = start;
+    history.records.clear();
+    history.count = 0;
+}
+
+void historyPlay(GameHistory& history, Position& pos, Move m) {
+    MoveRecord record;
+    record.piece = uint8_t(pos.board[moveFrom(m)]);
+    record.move = m;
+    UndoInfo undo;
+    makeMove(pos, m, undo);
+    record.key = undo.key;
+    record.halfmoveClock = uint16_t(undo.halfmoveClock);
+    record.captured = uint8_t(undo.captured);
+    record.castling = uint8_t(undo.castling);
+    record.epSquare = int8_t(undo.epSquare);
+
+    // Playing a new move discards the moves that could have been redone
+    history.records.resize(history.count);
+    history.records.push_back(record);
+    history.count++;
+}
+
+bool historyUndo(GameHistory& history, Position& pos) {
+    if (!canUndo(history)) return false;
+    const MoveRecord& record = history.records[--history.count];
+    UndoInfo undo{ record.captured, record.castling, record.epSquare, record.halfmoveClock, record.key };
+    unmakeMove(pos, record.move, undo);
+    return true;
+}
+
+bool historyRedo(GameHistory& history, Position& pos) {
+    if (!canRedo(history)) return false;
+    UndoInfo undo;
+    makeMove(pos, history.records[history.count++].move, undo);
+    return true;
+}
+
+int repetitionCount(const GameHistory& history, const Position& pos) {
+    int count = 1;
+    // Only positions since the last capture or pawn move can repeat
+    size_t reach = min(history.count, size_t(pos.halfmoveClock));
+    for (size_t back = 2; back <= reach; back += 2) {
+        if (history.records[history.count - back].key == pos.key) count++;
+    }
+    return count;
+}
+
+void historyKeys(const GameHistory& history, vector<uint64_t>& keys) {
+    keys.clear();
+    for (size_t i = 0; i < history.count; i++) keys.push_back(history.records[i].key);
+}
+
+PgnGame historyToPgn(const GameHistory& history, int result) {
+    PgnGame game;
+    game.tags.push_back({ "Event", "Casual game" });
+    game.tags.push_back({ "White", "White" });
+    game.tags.push_back({ "Black", "Black" });
+    string fen = toFen(history.start);
+    if (fen != START_FEN) {
+        game.tags.push_back({ "SetUp", "1" });
+        game.tags.push_back({ "FEN", fen });
+    }
+    game.result = result;
+
+    Position pos = history.start;
+    for (size_t i = 0; i < history.count; i++) {
+        Move m = history.records[i].move;
+        game.moves.push_back(moveToSan(pos, m));
+        UndoInfo undo;
+        makeMove(pos, m, undo);
+    }
+    return game;
+}
@@ -0,0 +1,54 @@
+#pragma once
+// Game record: the moves played from a start position, stored as packed
+// 16-byte records in one growable array. Each record carries everything
+// unmakeMove needs, so undo and redo are O(1), and the hash key of the
+// position the move was played from, for repetition detection.
+
+#include "pgn.h"
+#include "position.h"
+
+#include <cstdint>
+#include <vector>
+
+struct MoveRecord {
+    uint64_t key;           // position before the move
+    Move move;
+    uint16_t halfmoveClock; // before the move
+    uint8_t piece;          // piece that moved
+    uint8_t captured;
+    uint8_t castling;       // before the move
+    int8_t epSquare;        // before the move
+};
+
+static_assert(sizeof(MoveRecord) == 16, "move records must stay 16 bytes");
+
+struct GameHistory {
+    Position start;
+    std::vector<MoveRecord> records;    // records[count..] can be redone
+    size_t count = 0;
+};
+
+void historyReset(GameHistory& history, const Position& start);
+
+// Plays m on pos (which must be the current position) and records it. Any
+// moves that could have been redone are dropped.
+void historyPlay(GameHistory& history, Position& pos, Move m);
+
+// Take back or replay one move on pos. Return false when there is none.
+bool historyUndo(GameHistory& history, Position& pos);
+bool historyRedo(GameHistory& history, Position& pos);
+
+inline bool canUndo(const GameHistory& history) { return history.count > 0; }
+inline bool canRedo(const GameHistory& history) { return history.count < history.records.size(); }
+inline const MoveRecord* lastRecord(const GameHistory& history) {
+    return history.count > 0 ? &history.records[history.count - 1] : nullptr;
+}
+
+// How many times pos (the current position) has occurred, counting itself
+int repetitionCount(const GameHistory& history, const Position& pos);
+
+// Keys of all positions before the current one, oldest first, as the search expects
+void historyKeys(const GameHistory& history, std::vector<uint64_t>& keys);
+
+// The moves played so far as a PGN game (a FEN tag is added for non-standard starts)
+PgnGame historyToPgn(const GameHistory& history, int result);
@@ -0,0 +1,159 @@
+#include "instrument.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+const char* counterNames[COUNTER_COUNT] = {
+    "moves_generated", "legality_checks", "attack_checks", "evaluations"
+};
+
+const char* phaseNames[PHASE_COUNT] = {
+    "move_generation", "game_end_scan", "search_iteration", "render_frame"
+};
+
+// Only the owning thread writes its block, so updates are plain loads and
+// stores; the atomics just make reading from other threads well defined.
+struct ThreadStats {
+    atomic<uint64_t> counters[COUNTER_COUNT];
+    atomic<uint64_t> buckets[PHASE_COUNT][HISTOGRAM_BUCKETS];
+    atomic<uint64_t> totalNs[PHASE_COUNT];
+    atomic<uint64_t> maxNs[PHASE_COUNT];
+
+    ThreadStats();
+    ~ThreadStats();
+};
+
+struct Registry {
+    mutex lock;
+    vector<ThreadStats*> live;
+    // Totals of threads that have exited
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint64_t buckets[PHASE_COUNT][HISTOGRAM_BUCKETS] = {};
+    uint64_t totalNs[PHASE_COUNT] = {};
+    uint64_t maxNs[PHASE_COUNT] = {};
+};
+
+static Registry& registry() {
+    static Registry* instance = [] {
+        Registry* r = new Registry;
+        r->live.reserve(256);
+        return r;
+    }();
+    return *instance;
+}
+
+static void clearStats(ThreadStats& stats) {
+    for (auto& c : stats.counters) c.store(0, memory_order_relaxed);
+    for (auto& phase : stats.buckets) for (auto& b : phase) b.store(0, memory_order_relaxed);
+    for (auto& t : stats.totalNs) t.store(0, memory_order_relaxed);
+    for (auto& m : stats.maxNs) m.store(0, memory_order_relaxed);
+}
+
+ThreadStats::ThreadStats() {
+    clearStats(*this);
+    Registry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    r.live.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+    Registry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    for (int i = 0; i < COUNTER_COUNT; i++) r.counters[i] += counters[i].load(memory_order_relaxed);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) r.buckets[p][b] += buckets[p][b].load(memory_order_relaxed);
+        r.totalNs[p] += totalNs[p].load(memory_order_relaxed);
+        r.maxNs[p] = max(r.maxNs[p], maxNs[p].load(memory_order_relaxed));
+    }
+    r.live.erase(find(r.live.begin(), r.live.end(), this));
+}
+
+static thread_local ThreadStats localStats;
+
+static void bump(atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void countEvent(Counter counter, uint64_t amount) {
+    bump(localStats.counters[counter], amount);
+}
+
+void recordPhase(Phase phase, uint64_t nanoseconds) {
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && (nanoseconds >> (bucket + 1)) != 0) bucket++;
+    bump(localStats.buckets[phase][bucket], 1);
+    bump(localStats.totalNs[phase], nanoseconds);
+    if (nanoseconds > localStats.maxNs[phase].load(memory_order_relaxed)) {
+        localStats.maxNs[phase].store(nanoseconds, memory_order_relaxed);
+    }
+}
+
+uint64_t counterTotal(Counter counter) {
+    Registry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    uint64_t total = r.counters[counter];
+    for (ThreadStats* stats : r.live) total += stats->counters[counter].load(memory_order_relaxed);
+    return total;
+}
+
+PhaseSummary phaseSummary(Phase phase) {
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+    PhaseSummary summary{};
+    {
+        Registry& r = registry();
+        lock_guard<mutex> guard(r.lock);
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++) buckets[b] = r.buckets[phase][b];
+        summary.totalNs = r.totalNs[phase];
+        summary.maxNs = r.maxNs[phase];
+        for (ThreadStats* stats : r.live) {
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++) buckets[b] += stats->buckets[phase][b].load(memory_order_relaxed);
+            summary.totalNs += stats->totalNs[phase].load(memory_order_relaxed);
+            summary.maxNs = max(summary.maxNs, stats->maxNs[phase].load(memory_order_relaxed));
+        }
+    }
+    for (uint64_t n : buckets) summary.count += n;
+
+    uint64_t seen = 0;
+    bool haveP50 = false;
+    for (int b = 0; b < HISTOGRAM_BUCKETS && summary.count > 0; b++) {
+        seen += buckets[b];
+        if (!haveP50 && seen * 2 >= summary.count) {
+            summary.p50Ns = uint64_t(1) << (b + 1);
+            haveP50 = true;
+        }
+        if (seen * 100 >= summary.count * 99) {
+            summary.p99Ns = uint64_t(1) << (b + 1);
+            break;
+        }
+    }
+    return summary;
+}
+
+void resetInstrumentation() {
+    Registry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    for (ThreadStats* stats : r.live) clearStats(*stats);
+    for (auto& c : r.counters) c = 0;
+    for (auto& phase : r.buckets) for (auto& b : phase) b = 0;
+    for (auto& t : r.totalNs) t = 0;
+    for (auto& m : r.maxNs) m = 0;
+}
+
+void writeInstrumentationJson(ostream& out) {
+    out << "{\n  \"enabled\": " << (CHESS_INSTRUMENT ? "true" : "false") << ",\n  \"counters\": {";
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << (i ? ", " : "") << "\"" << counterNames[i] << "\": " << counterTotal(Counter(i));
+    }
+    out << "},\n  \"phases\": {";
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        PhaseSummary s = phaseSummary(Phase(p));
+        out << (p ? "," : "") << "\n    \"" << phaseNames[p] << "\": {\"count\": " << s.count
+            << ", \"total_ns\": " << s.totalNs << ", \"max_ns\": " << s.maxNs
+            << ", \"p50_ns\": " << s.p50Ns << ", \"p99_ns\": " << s.p99Ns << "}";
+    }
+    out << "\n  }\n}\n";
+}
@@ -0,0 +1,82 @@
+#pragma once
+// Instrumentation for the rules and search hot paths: event counters and
+// per-phase timing histograms. Everything is compiled out unless
+// CHESS_INSTRUMENT is non-zero, which is the default for builds without
+// NDEBUG; pass -DCHESS_INSTRUMENT=1 to keep it in an optimised build.
+//
+// Counters and histograms are kept per thread (no shared cache lines on the
+// hot path) and summed when read.
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#ifndef CHESS_INSTRUMENT
+#ifdef NDEBUG
+#define CHESS_INSTRUMENT 0
+#else
+#define CHESS_INSTRUMENT 1
+#endif
+#endif
+
+enum Counter {
+    COUNTER_MOVES_GENERATED,    // pseudo-legal moves produced by move generators
+    COUNTER_LEGALITY_CHECKS,    // moves tested for leaving the king in check
+    COUNTER_ATTACK_CHECKS,      // square attack queries
+    COUNTER_EVALUATIONS,
+    COUNTER_COUNT
+};
+
+enum Phase {
+    PHASE_MOVE_GENERATION,      // one generateMoves / GUI piece move generation call
+    PHASE_GAME_END_SCAN,        // GUI position cache: legal moves, checks, checkmate and stalemate
+    PHASE_SEARCH_ITERATION,     // one iterative deepening iteration
+    PHASE_RENDER_FRAME,
+    PHASE_COUNT
+};
+
+// Durations go into power-of-two nanosecond buckets: bucket i holds [2^i, 2^(i+1)) ns
+const int HISTOGRAM_BUCKETS = 40;
+
+extern const char* counterNames[COUNTER_COUNT];
+extern const char* phaseNames[PHASE_COUNT];
+
+void countEvent(Counter counter, uint64_t amount);
+void recordPhase(Phase phase, uint64_t nanoseconds);
+
+uint64_t counterTotal(Counter counter);
+
+struct PhaseSummary {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t p50Ns;             // upper edge of the bucket holding the percentile
+    uint64_t p99Ns;
+};
+PhaseSummary phaseSummary(Phase phase);
+
+void resetInstrumentation();
+void writeInstrumentationJson(std::ostream& out);
+
+// Times the enclosing scope
+struct PhaseTimer {
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+    explicit PhaseTimer(Phase p) : phase(p), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        recordPhase(phase, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+};
+
+#if CHESS_INSTRUMENT
+#define INSTRUMENT_COUNT(counter) countEvent(counter, 1)
+#define INSTRUMENT_ADD(counter, amount) countEvent(counter, uint64_t(amount))
+#define INSTRUMENT_PHASE_CONCAT2(a, b) a##b
+#define INSTRUMENT_PHASE_CONCAT(a, b) INSTRUMENT_PHASE_CONCAT2(a, b)
+#define INSTRUMENT_PHASE(phase) PhaseTimer INSTRUMENT_PHASE_CONCAT(phaseTimer, __LINE__)(phase)
+#else
+#define INSTRUMENT_COUNT(counter) ((void)0)
+#define INSTRUMENT_ADD(counter, amount) ((void)0)
+#define INSTRUMENT_PHASE(phase) ((void)0)
+#endif
@@ -0,0 +1,29 @@
+#include "log.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+int logLevel = LOG_INFO;
+
+static const char* levelNames[] = { "error", "warn", "info", "debug", "trace" };
+
+bool setLogLevel(const char* name) {
+    for (int i = LOG_ERROR; i <= LOG_TRACE; i++) {
+        if (strcmp(name, levelNames[i]) == 0) {
+            logLevel = i;
+            return true;
+        }
+    }
+    char* end;
+    long level = strtol(name, &end, 10);
+    if (*name == '\0' || *end != '\0' || level < LOG_ERROR || level > LOG_TRACE) return false;
+    logLevel = int(level);
+    return true;
+}
+
+// Errors and warnings go to stderr, everything else to stdout as before
+ostream& logStream(int level) {
+    return level <= LOG_WARN ? cerr : cout;
+}
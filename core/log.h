@@ -0,0 +1,21 @@
+#pragma once
+// Levelled logging. A message below the current level costs one integer
+// comparison, and its stream expression is never evaluated:
+//
+//     LOG(LOG_DEBUG, "Checkmate check: inCheck=" << inCheck);
+
+#include <iostream>
+
+const int LOG_ERROR = 0, LOG_WARN = 1, LOG_INFO = 2, LOG_DEBUG = 3, LOG_TRACE = 4;
+
+extern int logLevel;    // messages up to this level are written; LOG_INFO by default
+
+// Parses "error", "warn", "info", "debug", "trace" or a number. Returns false if unknown.
+bool setLogLevel(const char* name);
+
+std::ostream& logStream(int level);
+
+#define LOG(level, message) \
+    do { \
+        if ((level) <= logLevel) logStream(level) << message << std::endl; \
+    } while (0)
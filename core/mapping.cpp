@@ -0,0 +1,71 @@
+#include "mapping.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+bool mapFile(FileMapping& mapping, const string& path, bool randomAccess) {
+    unmapFile(mapping);
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | (randomAccess ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN), nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    mapping.fileHandle = file;
+    mapping.mapHandle = map;
+    mapping.data = view;
+    mapping.size = size_t(size.QuadPart);
+    if (!view) {
+        unmapFile(mapping);
+        return false;
+    }
+    return true;
+}
+
+void unmapFile(FileMapping& mapping) {
+    if (mapping.data) UnmapViewOfFile(mapping.data);
+    if (mapping.mapHandle) CloseHandle(mapping.mapHandle);
+    if (mapping.fileHandle) CloseHandle(mapping.fileHandle);
+    mapping = FileMapping();
+}
+
+#else
+
+bool mapFile(FileMapping& mapping, const string& path, bool randomAccess) {
+    unmapFile(mapping);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    if (randomAccess) madvise(view, size_t(st.st_size), MADV_RANDOM);
+    mapping.data = view;
+    mapping.size = size_t(st.st_size);
+    return true;
+}
+
+void unmapFile(FileMapping& mapping) {
+    if (mapping.data) munmap(const_cast<void*>(mapping.data), mapping.size);
+    mapping = FileMapping();
+}
+
+#endif
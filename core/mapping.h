@@ -0,0 +1,18 @@
+#pragma once
+// Read-only memory-mapped files, shared by the opening book and the game
+// index so both open in constant time whatever their size.
+
+#include <cstddef>
+#include <string>
+
+struct FileMapping {
+    const void* data = nullptr;
+    size_t size = 0;
+    void* fileHandle = nullptr;     // Windows only
+    void* mapHandle = nullptr;      // Windows only
+};
+
+// Maps the whole file. randomAccess tells the OS that reads jump around the
+// file, so read-ahead would only waste I/O. Fails on missing or empty files.
+bool mapFile(FileMapping& mapping, const std::string& path, bool randomAccess);
+void unmapFile(FileMapping& mapping);
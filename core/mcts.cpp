@@ -0,0 +1,340 @@
+#include "mcts.h"
+#include "eval.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+// Unvisited children start from the parent's value less this (first play urgency)
+const double FIRST_PLAY_REDUCTION = 0.1;
+
+const int64_t DRAW_VALUE = MCTS_VALUE_SCALE / 2;
+
+// The clock is read every TIME_CHECK_PLAYOUTS playouts of a thread
+const uint64_t TIME_CHECK_PLAYOUTS = 64;
+
+// ========== NODE POOL ==========
+
+void initMcts(Mcts& m, size_t megabytes) {
+    size_t count = max<size_t>(1024, megabytes * 1024 * 1024 / sizeof(MctsNode));
+    // Leave room above the capacity for allocations that overshoot it
+    count = min<size_t>(count, 0xF0000000u);
+    m.nodes.reset(new MctsNode[count]);
+    m.capacity = uint32_t(count);
+    m.used = 0;
+}
+
+static void resetNode(MctsNode& node, Move move, uint16_t prior) {
+    node.value.store(0, memory_order_relaxed);
+    node.visits.store(0, memory_order_relaxed);
+    node.children.store(0, memory_order_relaxed);
+    node.move = move;
+    node.prior = prior;
+    node.childCount = 0;
+    node.state.store(MCTS_OPEN, memory_order_relaxed);
+}
+
+// Returns the first of count fresh nodes, or 0 when the pool is exhausted
+static uint32_t allocateNodes(Mcts& m, uint32_t count) {
+    if (m.used.load(memory_order_relaxed) + count > m.capacity) return 0;
+    uint32_t first = m.used.fetch_add(count, memory_order_relaxed);
+    return first + count <= m.capacity ? first : 0;
+}
+
+// ========== PLAYOUTS ==========
+
+// Per-thread state
+struct MctsWorker {
+    uint64_t random = 0;
+    uint64_t playouts = 0;
+    bool poolFull = false;
+    vector<uint64_t> keys;      // game history followed by the current path
+};
+
+// xorshift64*
+static uint64_t nextRandom(uint64_t& state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+// keys holds the positions before pos; only those since the last irreversible move can repeat it
+static bool isRepetition(const vector<uint64_t>& keys, const Position& pos) {
+    int count = int(keys.size());
+    int stopAt = max(0, count - pos.halfmoveClock);
+    for (int i = count - 2; i >= stopAt; i -= 2) {
+        if (keys[i] == pos.key) return true;
+    }
+    return false;
+}
+
+static int captureScore(const Position& pos, Move m) {
+    int flag = moveFlag(m);
+    int victim = flag == MOVE_EN_PASSANT ? W_PAWN : pieceKind(pos.board[moveTo(m)]);
+    int promotion = flag == MOVE_PROMOTION ? pieceValue[movePromotion(m)] : 0;
+    return pieceValue[victim] * 10 - pieceValue[pieceKind(pos.board[moveFrom(m)])] / 10 + promotion;
+}
+
+// A random legal move, or NO_MOVE if there is none. Heuristic playouts play
+// the legal capture of the most valuable victim half of the time.
+static Move playoutMove(Position& pos, uint64_t& random, bool heuristic) {
+    Move moves[MOVE_LIST_SIZE];
+    if (heuristic && (nextRandom(random) & 1)) {
+        int count = generateCaptures(pos, moves);
+        Move best = NO_MOVE;
+        int bestScore = INT32_MIN;
+        for (int i = 0; i < count; i++) {
+            int score = captureScore(pos, moves[i]);
+            if (score > bestScore && isLegalMove(pos, moves[i])) {
+                best = moves[i];
+                bestScore = score;
+            }
+        }
+        if (best != NO_MOVE) return best;
+    }
+    // Draw until a legal one comes up, dropping the illegal ones
+    int count = generateMoves(pos, moves);
+    while (count > 0) {
+        int i = int(nextRandom(random) % uint64_t(count));
+        if (isLegalMove(pos, moves[i])) return moves[i];
+        moves[i] = moves[--count];
+    }
+    return NO_MOVE;
+}
+
+// Win probability of a centipawn score
+static int64_t scoreToValue(int score) {
+    return int64_t(MCTS_VALUE_SCALE / (1.0 + pow(10.0, -score / 400.0)));
+}
+
+static int valueToScore(double value) {
+    value = min(0.999, max(0.001, value));
+    return int(lround(400.0 * log10(value / (1.0 - value))));
+}
+
+// Plays on from pos and returns the result for its side to move
+static int64_t playout(const MctsSettings& settings, Position& pos, MctsWorker& w) {
+    size_t base = w.keys.size();
+    bool flipped = false;       // has the side to move changed since the start?
+    int64_t result;
+    for (int ply = 0;; ply++) {
+        if (pos.halfmoveClock >= 100 || isRepetition(w.keys, pos)) {
+            result = DRAW_VALUE;
+            break;
+        }
+        if (ply >= settings.playoutPlies) {
+            result = settings.heuristicPlayouts ? scoreToValue(evaluate(pos)) : DRAW_VALUE;
+            break;
+        }
+        Move m = playoutMove(pos, w.random, settings.heuristicPlayouts);
+        if (m == NO_MOVE) {
+            result = inCheck(pos) ? 0 : DRAW_VALUE;
+            break;
+        }
+        w.keys.push_back(pos.key);
+        UndoInfo undo;
+        makeMove(pos, m, undo);
+        flipped = !flipped;
+    }
+    w.keys.resize(base);
+    return flipped ? MCTS_VALUE_SCALE - result : result;
+}
+
+// ========== TREE ==========
+
+// Captures, by victim, and queen promotions get most of the prior
+static double priorLogit(const Position& pos, Move m) {
+    int flag = moveFlag(m);
+    int victim = flag == MOVE_EN_PASSANT ? W_PAWN : pieceKind(pos.board[moveTo(m)]);
+    double logit = 0;
+    if (victim != NONE) logit += 1.0 + (pieceValue[victim] - pieceValue[pieceKind(pos.board[moveFrom(m)])] / 10) / 300.0;
+    if (flag == MOVE_PROMOTION) logit += movePromotion(m) == W_QUEEN ? 2.0 : -1.0;
+    return logit;
+}
+
+// Claims the node and gives it its children, or marks how the game ended in
+// it. Returns without doing anything if another thread got there first; if
+// the pool is exhausted the node stays claimed, so nobody tries again.
+static void expandNode(Mcts& m, MctsNode& node, Position& pos, MctsWorker& w) {
+    uint32_t expected = 0;
+    if (!node.children.compare_exchange_strong(expected, MCTS_EXPANDING, memory_order_acq_rel)) return;
+    Move moves[MOVE_LIST_SIZE];
+    int count = generateLegalMoves(pos, moves);
+    if (count == 0) {
+        node.state.store(inCheck(pos) ? MCTS_CHECKMATE : MCTS_STALEMATE, memory_order_release);
+        return;
+    }
+    uint32_t first = allocateNodes(m, uint32_t(count));
+    if (first == 0) {
+        w.poolFull = true;
+        return;
+    }
+    double weights[MOVE_LIST_SIZE];
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        weights[i] = exp(priorLogit(pos, moves[i]));
+        total += weights[i];
+    }
+    for (int i = 0; i < count; i++) {
+        double prior = weights[i] / total * 65535.0 + 0.5;
+        resetNode(m.nodes[first + i], moves[i], uint16_t(min(65535.0, max(1.0, prior))));
+    }
+    node.childCount = uint8_t(count);
+    node.children.store(first, memory_order_release);
+}
+
+// PUCT: value for the side to move plus an exploration bonus that is large
+// for moves with a high prior and few visits
+static uint32_t selectChild(const Mcts& m, const MctsNode& node, uint32_t children) {
+    const MctsSettings& settings = m.settings;
+    uint32_t visits = node.visits.load(memory_order_relaxed);
+    int64_t value = node.value.load(memory_order_relaxed);
+    // The node's value is for the side that moved into it, the opponent of the side choosing
+    double parentValue = visits > 0 ? 1.0 - double(value) / (double(MCTS_VALUE_SCALE) * visits) : 0.5;
+    double firstPlay = parentValue - FIRST_PLAY_REDUCTION;
+    double bonus = settings.exploration * sqrt(double(max(1u, visits)));
+    double uniform = 1.0 / node.childCount;
+
+    uint32_t best = children;
+    double bestScore = -1e300;
+    for (uint32_t i = children; i < children + node.childCount; i++) {
+        const MctsNode& child = m.nodes[i];
+        uint32_t childVisits = child.visits.load(memory_order_relaxed);
+        double q = childVisits > 0 ?
+            double(child.value.load(memory_order_relaxed)) / (double(MCTS_VALUE_SCALE) * childVisits) : firstPlay;
+        double prior = settings.priors ? child.prior / 65535.0 : uniform;
+        double score = q + bonus * prior / (1 + childVisits);
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// One descent from the root to a leaf, a playout there, and the result
+// backed up the path, replacing the virtual losses added on the way down
+static void runPlayout(Mcts& m, const Position& root, MctsWorker& w) {
+    const MctsSettings& settings = m.settings;
+    uint32_t virtualLoss = uint32_t(max(0, settings.virtualLoss));
+    Position pos = root;
+    uint32_t path[MAX_PLY];
+    int length = 0;
+    size_t base = w.keys.size();
+    uint32_t index = 0;
+    int64_t result;             // for the side to move at the leaf
+    for (;;) {
+        MctsNode& node = m.nodes[index];
+        uint32_t visits = node.visits.fetch_add(virtualLoss, memory_order_relaxed);
+        path[length++] = index;
+        if (index != 0 && (pos.halfmoveClock >= 100 || isRepetition(w.keys, pos))) {
+            result = DRAW_VALUE;
+            break;
+        }
+        uint32_t children = node.children.load(memory_order_acquire);
+        if (children == 0 && visits >= uint32_t(settings.expandVisits)) {
+            expandNode(m, node, pos, w);
+            children = node.children.load(memory_order_acquire);
+        }
+        uint8_t state = node.state.load(memory_order_acquire);
+        if (state != MCTS_OPEN) {
+            result = state == MCTS_CHECKMATE ? 0 : DRAW_VALUE;
+            break;
+        }
+        if (children == 0 || children == MCTS_EXPANDING || length == MAX_PLY) {
+            result = playout(settings, pos, w);
+            break;
+        }
+        index = selectChild(m, node, children);
+        w.keys.push_back(pos.key);
+        UndoInfo undo;
+        makeMove(pos, m.nodes[index].move, undo);
+    }
+    w.keys.resize(base);
+
+    int64_t value = MCTS_VALUE_SCALE - result;
+    for (int i = length - 1; i >= 0; i--) {
+        MctsNode& node = m.nodes[path[i]];
+        node.value.fetch_add(value, memory_order_relaxed);
+        node.visits.fetch_add(1 - virtualLoss, memory_order_relaxed);
+        value = MCTS_VALUE_SCALE - value;
+    }
+}
+
+// ========== SEARCH ==========
+
+static uint32_t mostVisitedChild(const Mcts& m, const MctsNode& node) {
+    uint32_t children = node.children.load(memory_order_acquire);
+    if (children == 0 || children == MCTS_EXPANDING) return 0;
+    uint32_t best = 0, bestVisits = 0;
+    for (uint32_t i = children; i < children + node.childCount; i++) {
+        uint32_t visits = m.nodes[i].visits.load(memory_order_relaxed);
+        if (best == 0 || visits > bestVisits) {
+            best = i;
+            bestVisits = visits;
+        }
+    }
+    return best;
+}
+
+MctsResult mctsSearch(Mcts& m, const Position& pos, const MctsLimits& limits,
+    const vector<uint64_t>& gameKeys) {
+    auto start = chrono::steady_clock::now();
+    MctsResult result;
+    result.threads = max(1, limits.threads);
+
+    // The root is expanded up front, so every thread has a tree to descend
+    m.used = 1;
+    resetNode(m.nodes[0], NO_MOVE, 0);
+    Position root = pos;
+    MctsWorker setup;
+    setup.keys = gameKeys;
+    expandNode(m, m.nodes[0], root, setup);
+    if (m.nodes[0].childCount == 0) {
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    auto deadline = start + chrono::milliseconds(limits.timeMs);
+    atomic<uint64_t> started{ 0 }, finished{ 0 };
+    atomic<bool> poolFull{ false };
+    auto work = [&](int index) {
+        MctsWorker w;
+        w.random = (m.settings.seed + uint64_t(index)) * 0x9E3779B97F4A7C15ULL | 1;
+        w.keys.reserve(gameKeys.size() + MAX_PLY + max(0, m.settings.playoutPlies) + 2);
+        w.keys = gameKeys;
+        while (!m.stop.load(memory_order_relaxed)) {
+            if (limits.playouts > 0 && started.fetch_add(1, memory_order_relaxed) >= limits.playouts) break;
+            runPlayout(m, root, w);
+            w.playouts++;
+            if (limits.timeMs > 0 && w.playouts % TIME_CHECK_PLAYOUTS == 0 && chrono::steady_clock::now() >= deadline) {
+                m.stop = true;
+            }
+        }
+        finished += w.playouts;
+        if (w.poolFull) poolFull = true;
+    };
+    vector<thread> helpers;
+    for (int i = 1; i < result.threads; i++) helpers.emplace_back(work, i);
+    work(0);
+    for (thread& helper : helpers) helper.join();
+
+    result.playouts = finished;
+    result.nodes = min(m.used.load(), m.capacity);
+    result.poolFull = poolFull;
+    for (uint32_t node = mostVisitedChild(m, m.nodes[0]); node != 0 && result.pv.length < MAX_PLY;
+        node = mostVisitedChild(m, m.nodes[node])) {
+        if (m.nodes[node].visits.load() == 0) break;
+        result.pv.moves[result.pv.length++] = m.nodes[node].move;
+    }
+    result.bestMove = result.pv.length > 0 ? result.pv[0] : m.nodes[mostVisitedChild(m, m.nodes[0])].move;
+    const MctsNode& best = m.nodes[mostVisitedChild(m, m.nodes[0])];
+    uint32_t visits = best.visits.load();
+    if (visits > 0) result.score = valueToScore(double(best.value.load()) / (double(MCTS_VALUE_SCALE) * visits));
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,85 @@
+#pragma once
+// Monte Carlo tree search, the alternative to the alpha-beta search: PUCT
+// selection over priors from a cheap move heuristic, short playouts scored by
+// the static evaluation (or uniformly random playouts to the end of the
+// game), and tree parallelism with virtual loss, all threads sharing one tree.
+//
+// The tree lives in a node pool allocated once by initMcts. A node's children
+// are one contiguous block taken from the pool with an atomic bump, so
+// expanding a node never locks and never calls the allocator; the pool is
+// rewound at the start of every search. A thread that descends through a node
+// adds a virtual loss to it, which makes the node look worse to the other
+// threads until the playout's result replaces the loss.
+
+#include "position.h"
+#include "search.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Playout results are fixed point, MCTS_VALUE_SCALE being a win
+const int64_t MCTS_VALUE_SCALE = 1 << 16;
+
+// children of a node whose expansion another thread has claimed
+const uint32_t MCTS_EXPANDING = 0xFFFFFFFF;
+
+const uint8_t MCTS_OPEN = 0, MCTS_CHECKMATE = 1, MCTS_STALEMATE = 2;
+
+struct MctsNode {
+    std::atomic<int64_t> value;       // results for the side that moved into the node
+    std::atomic<uint32_t> visits;     // playouts through the node, virtual losses included
+    std::atomic<uint32_t> children;   // first child in the pool, 0 = not expanded
+    Move move;                        // move into the node
+    uint16_t prior;                   // in 1/65535
+    uint8_t childCount;
+    std::atomic<uint8_t> state;       // MCTS_OPEN or how the game ended in the node
+};
+
+static_assert(sizeof(MctsNode) == 24, "MCTS nodes must stay 24 bytes");
+
+struct MctsSettings {
+    double exploration = 1.5;      // PUCT constant
+    int virtualLoss = 3;           // losses a thread adds to every node on its path
+    int expandVisits = 2;          // playouts through a leaf before it is expanded
+    bool priors = true;            // false = uniform priors (plain UCT-like selection)
+    bool heuristicPlayouts = true; // captures preferred and the end scored by evaluate();
+                                   // false = uniformly random moves to the end of the game
+    int playoutPlies = 8;          // heuristic playout length, or the random playout cap
+    uint64_t seed = 1;
+};
+
+struct MctsLimits {
+    int64_t timeMs = 0;            // 0 = no time limit
+    uint64_t playouts = 0;         // 0 = no playout limit
+    int threads = 1;
+};
+
+struct MctsResult {
+    Move bestMove = NO_MOVE;       // the most visited root move
+    int score = 0;                 // its win rate as centipawns for the side to move
+    uint64_t playouts = 0;
+    uint64_t nodes = 0;            // tree nodes used
+    bool poolFull = false;         // the pool ran out and leaves stopped expanding
+    double seconds = 0;
+    int threads = 1;
+    PvLine pv;                     // most visited path
+};
+
+struct Mcts {
+    std::unique_ptr<MctsNode[]> nodes;
+    uint32_t capacity = 0;
+    std::atomic<uint32_t> used{ 0 };
+    std::atomic<bool> stop{ false };
+    MctsSettings settings;
+};
+
+// Allocates a pool of the given size; the tree of one search must fit in it
+void initMcts(Mcts& m, size_t megabytes);
+
+// Searches pos within the limits. gameKeys holds the hash keys of the
+// positions played before pos, for repetition detection. The caller clears
+// m.stop before starting; setting it from another thread ends the search.
+MctsResult mctsSearch(Mcts& m, const Position& pos, const MctsLimits& limits,
+    const std::vector<uint64_t>& gameKeys);
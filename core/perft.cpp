@@ -0,0 +1,187 @@
+#include "perft.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+using namespace std;
+
+// ========== HASH TABLE ==========
+
+void perftTableResize(PerftTable& table, size_t megabytes) {
+    size_t count = megabytes ? 1 : 0;
+    while (count && count * 2 * sizeof(PerftEntry) <= megabytes * 1024 * 1024) count *= 2;
+    vector<PerftEntry> entries(count);
+    table.entries.swap(entries);
+    table.mask = count ? count - 1 : 0;
+    table.hits = 0;
+}
+
+void perftTableClear(PerftTable& table) {
+    for (PerftEntry& entry : table.entries) {
+        entry.check.store(0, memory_order_relaxed);
+        entry.data.store(0, memory_order_relaxed);
+    }
+    table.hits = 0;
+}
+
+static bool perftProbe(PerftTable& table, uint64_t key, int depth, uint64_t& nodes) {
+    PerftEntry& entry = table.entries[key & table.mask];
+    uint64_t data = entry.data.load(memory_order_relaxed);
+    uint64_t check = entry.check.load(memory_order_relaxed);
+    if ((check ^ data) != key || int(data & 0xFF) != depth) return false;
+    nodes = data >> 8;
+    table.hits.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+static void perftStore(PerftTable& table, uint64_t key, int depth, uint64_t nodes) {
+    PerftEntry& entry = table.entries[key & table.mask];
+    uint64_t data = nodes << 8 | uint64_t(depth);
+    entry.check.store(key ^ data, memory_order_relaxed);
+    entry.data.store(data, memory_order_relaxed);
+}
+
+uint64_t perftHashed(Position& pos, int depth, PerftTable& table) {
+    // Subtrees of one ply are counted from the move list, which is cheaper than a probe
+    if (depth <= 1 || table.entries.empty()) return perft(pos, depth);
+
+    uint64_t nodes;
+    if (perftProbe(table, pos.key, depth, nodes)) return nodes;
+
+    Move moves[MOVE_LIST_SIZE];
+    int n = generateLegalMoves(pos, moves);
+    nodes = 0;
+    for (int i = 0; i < n; i++) {
+        UndoInfo undo;
+        makeMove(pos, moves[i], undo);
+        nodes += perftHashed(pos, depth - 1, table);
+        unmakeMove(pos, moves[i], undo);
+    }
+    perftStore(table, pos.key, depth, nodes);
+    return nodes;
+}
+
+// ========== PARALLEL PERFT ==========
+
+// A subtree below one root move of one job
+struct PerftTask {
+    Position pos;
+    int depth;
+    uint32_t counter;       // index into the per-root-move counters
+};
+
+// Replaces every task more than two plies above the leaves by its children
+static bool splitTasks(vector<PerftTask>& tasks) {
+    vector<PerftTask> next;
+    next.reserve(tasks.size() * 32);
+    bool split = false;
+    for (PerftTask& task : tasks) {
+        if (task.depth <= 2) {
+            next.push_back(task);
+            continue;
+        }
+        Move moves[MOVE_LIST_SIZE];
+        int n = generateLegalMoves(task.pos, moves);
+        for (int i = 0; i < n; i++) {
+            PerftTask child = task;
+            UndoInfo undo;
+            makeMove(child.pos, moves[i], undo);
+            child.depth = task.depth - 1;
+            next.push_back(child);
+        }
+        split = true;
+    }
+    tasks.swap(next);
+    return split;
+}
+
+PerftStats runPerftJobs(vector<PerftJob>& jobs, ThreadPool& pool, PerftTable& table, int minTasksPerWorker) {
+    auto start = chrono::steady_clock::now();
+    uint64_t hitsBefore = table.hits.load();
+    uint64_t stealsBefore = pool.steals;
+
+    // One task per root move to start with; counters are laid out job by job
+    vector<PerftTask> tasks;
+    vector<size_t> firstCounter(jobs.size());
+    size_t counterCount = 0;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        PerftJob& job = jobs[j];
+        Position root;
+        job.valid = setFromFen(root, job.fen);
+        job.rootMoves.clear();
+        job.rootNodes.clear();
+        job.nodes = 0;
+        firstCounter[j] = counterCount;
+        if (!job.valid) continue;
+        if (job.depth <= 0) {
+            job.nodes = 1;
+            continue;
+        }
+        Move moves[MOVE_LIST_SIZE];
+        int n = generateLegalMoves(root, moves);
+        for (int i = 0; i < n; i++) {
+            PerftTask task = { root, job.depth - 1, uint32_t(counterCount++) };
+            UndoInfo undo;
+            makeMove(task.pos, moves[i], undo);
+            tasks.push_back(task);
+            job.rootMoves.push_back(moves[i]);
+        }
+    }
+    size_t wanted = size_t(max(1, minTasksPerWorker)) * size_t(poolWorkers(pool));
+    while (tasks.size() < wanted && splitTasks(tasks)) {}
+
+    unique_ptr<atomic<uint64_t>[]> counters(new atomic<uint64_t>[counterCount]());
+    parallelFor(pool, tasks.size(), [&](size_t index, int) {
+        PerftTask& task = tasks[index];
+        Position pos = task.pos;
+        counters[task.counter].fetch_add(perftHashed(pos, task.depth, table), memory_order_relaxed);
+    });
+
+    PerftStats stats;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        PerftJob& job = jobs[j];
+        for (size_t i = 0; i < job.rootMoves.size(); i++) {
+            job.rootNodes.push_back(counters[firstCounter[j] + i].load());
+            job.nodes += job.rootNodes.back();
+        }
+        stats.nodes += job.nodes;
+    }
+    stats.tasks = tasks.size();
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    stats.hashHits = table.hits.load() - hitsBefore;
+    stats.steals = pool.steals - stealsBefore;
+    return stats;
+}
+
+bool readPerftSuite(const string& path, int defaultDepth, int maxDepth, vector<PerftJob>& jobs) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        PerftJob job;
+        size_t semicolon = line.find(';');
+        job.fen = line.substr(0, semicolon);
+        while (!job.fen.empty() && job.fen.back() == ' ') job.fen.pop_back();
+        job.depth = 0;
+        while (semicolon != string::npos) {
+            size_t next = line.find(';', semicolon + 1);
+            istringstream field(line.substr(semicolon + 1, next == string::npos ? string::npos : next - semicolon - 1));
+            char d;
+            int depth;
+            uint64_t nodes;
+            if (field >> d >> depth >> nodes && (d == 'D' || d == 'd') &&
+                (maxDepth <= 0 || depth <= maxDepth) && depth > job.depth) {
+                job.depth = depth;
+                job.expected = nodes;
+            }
+            semicolon = next;
+        }
+        if (job.depth == 0) job.depth = defaultDepth;
+        jobs.push_back(job);
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+// Parallel perft: counts the leaves of the legal move tree with the tree
+// split at a frontier a few plies below the root, and the subtrees shared
+// out over a work-stealing thread pool. An optional hash table, shared by
+// all threads, stores subtree counts so transposed subtrees are only counted
+// once. Batches of positions are split into one task list so small and large
+// trees load-balance together.
+
+#include "position.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ========== HASH TABLE ==========
+
+// Lockless entries: check holds key ^ data, so an entry torn by two threads
+// writing at once fails the check instead of returning a wrong count
+struct PerftEntry {
+    std::atomic<uint64_t> check{ 0 };
+    std::atomic<uint64_t> data{ 0 };    // nodes << 8 | depth
+};
+
+struct PerftTable {
+    std::vector<PerftEntry> entries;
+    uint64_t mask = 0;
+    std::atomic<uint64_t> hits{ 0 };
+};
+
+// 0 megabytes disables the table
+void perftTableResize(PerftTable& table, size_t megabytes);
+void perftTableClear(PerftTable& table);
+
+// Single-threaded perft using (and filling) the table when it has entries
+uint64_t perftHashed(Position& pos, int depth, PerftTable& table);
+
+// ========== PARALLEL PERFT ==========
+
+struct PerftJob {
+    std::string fen;
+    int depth = 1;
+    uint64_t expected = 0;               // 0 = unknown
+    // Results
+    uint64_t nodes = 0;
+    std::vector<Move> rootMoves;         // legal root moves and the nodes below each
+    std::vector<uint64_t> rootNodes;
+    bool valid = true;                   // false if the FEN did not parse
+};
+
+struct PerftStats {
+    uint64_t nodes = 0;
+    size_t tasks = 0;
+    double seconds = 0;
+    uint64_t hashHits = 0;
+    uint64_t steals = 0;
+};
+
+// Counts every job. Subtrees are split until there are at least
+// minTasksPerWorker tasks per worker or the frontier is two plies from the
+// leaves. The table may be empty.
+PerftStats runPerftJobs(std::vector<PerftJob>& jobs, ThreadPool& pool, PerftTable& table, int minTasksPerWorker = 16);
+
+// Reads "FEN ;D1 20 ;D2 400 ..." lines (the common perft suite format) into
+// one job per FEN at the deepest depth listed, capped at maxDepth if it is > 0.
+// Lines without depth fields get defaultDepth. Returns false if the file can't be read.
+bool readPerftSuite(const std::string& path, int defaultDepth, int maxDepth, std::vector<PerftJob>& jobs);
@@ -0,0 +1,137 @@
+#include "pgn.h"
+
+#include <cctype>
+#include <cstring>
+
+using namespace std;
+
+static int parseResult(const string& token) {
+    if (token == "1-0") return RESULT_WHITE_WINS;
+    if (token == "0-1") return RESULT_BLACK_WINS;
+    if (token == "1/2-1/2") return RESULT_DRAW;
+    return RESULT_UNKNOWN;
+}
+
+static void skipUntil(istream& in, char end) {
+    int ch;
+    while ((ch = in.get()) != EOF && ch != end) {}
+}
+
+static void readTag(istream& in, PgnGame& game) {
+    string line;
+    getline(in, line, ']');
+    size_t nameEnd = line.find_first_of(" \t");
+    if (nameEnd == string::npos) return;
+    string name = line.substr(0, nameEnd);
+    size_t open = line.find('"'), close = line.rfind('"');
+    string value = (open != string::npos && close > open) ? line.substr(open + 1, close - open - 1) : "";
+    game.tags.push_back({ name, value });
+    if (name == "Result") game.result = parseResult(value);
+}
+
+bool readPgnGame(istream& in, PgnGame& game) {
+    game.tags.clear();
+    game.moves.clear();
+    game.result = RESULT_UNKNOWN;
+    bool inMoves = false;
+    bool any = false;
+
+    int ch;
+    while ((ch = in.peek()) != EOF) {
+        if (isspace(ch)) { in.get(); continue; }
+        if (ch == '[') {
+            // A tag after movetext without a result token starts the next game
+            if (inMoves) return true;
+            in.get();
+            readTag(in, game);
+            any = true;
+            continue;
+        }
+        in.get();
+        if (ch == '{') { skipUntil(in, '}'); continue; }
+        if (ch == ';' || ch == '%') { skipUntil(in, '\n'); continue; }
+        if (ch == '(') {
+            // Variations may nest
+            int depth = 1;
+            while (depth > 0 && (ch = in.get()) != EOF) {
+                if (ch == '(') depth++;
+                else if (ch == ')') depth--;
+                else if (ch == '{') skipUntil(in, '}');
+            }
+            continue;
+        }
+        if (ch == ')') continue;
+
+        string token(1, char(ch));
+        while ((ch = in.peek()) != EOF && !isspace(ch) && !strchr("{}()[];", ch)) token += char(in.get());
+        inMoves = any = true;
+
+        if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+            if (game.result == RESULT_UNKNOWN) game.result = parseResult(token);
+            return true;
+        }
+        if (token[0] == '$') continue;   // numeric annotation glyph
+
+        // Strip move numbers such as "12." or "12...", which may be glued to the move
+        size_t start = 0;
+        while (start < token.size() && isdigit((unsigned char)token[start])) start++;
+        if (start < token.size() && token[start] == '.') {
+            while (start < token.size() && token[start] == '.') start++;
+            token.erase(0, start);
+        }
+        if (!token.empty() && !isdigit((unsigned char)token[0])) game.moves.push_back(token);
+    }
+    return any;
+}
+
+static const char* resultToken(int result) {
+    if (result == RESULT_WHITE_WINS) return "1-0";
+    if (result == RESULT_BLACK_WINS) return "0-1";
+    if (result == RESULT_DRAW) return "1/2-1/2";
+    return "*";
+}
+
+void writePgnGame(ostream& out, const PgnGame& game) {
+    for (const auto& tag : game.tags) {
+        if (tag.first != "Result") out << "[" << tag.first << " \"" << tag.second << "\"]\n";
+    }
+    out << "[Result \"" << resultToken(game.result) << "\"]\n\n";
+
+    Position pos;
+    if (!pgnStartPosition(game, pos)) setStartPosition(pos);
+    bool white = pos.whiteToMove;
+    int number = pos.fullmoveNumber;
+    string line;
+    auto emit = [&](const string& token) {
+        if (!line.empty() && line.size() + 1 + token.size() > 80) {
+            out << line << "\n";
+            line.clear();
+        }
+        line += (line.empty() ? "" : " ") + token;
+    };
+    for (size_t i = 0; i < game.moves.size(); i++) {
+        if (white) emit(to_string(number) + ". " + game.moves[i]);
+        else if (i == 0) emit(to_string(number) + "... " + game.moves[i]);
+        else emit(game.moves[i]);
+        if (!white) number++;
+        white = !white;
+    }
+    emit(resultToken(game.result));
+    out << line << "\n\n";
+}
+
+string pgnTag(const PgnGame& game, const string& name) {
+    for (const auto& tag : game.tags) {
+        if (tag.first == name) return tag.second;
+    }
+    return "";
+}
+
+bool pgnStartPosition(const PgnGame& game, Position& pos) {
+    string fen = pgnTag(game, "FEN");
+    if (fen.empty()) {
+        setStartPosition(pos);
+        return true;
+    }
+    return setFromFen(pos, fen);
+}
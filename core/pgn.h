@@ -0,0 +1,30 @@
+#pragma once
+// Streaming PGN reader. Games are read one at a time so archives of any
+// size can be processed without loading them into memory.
+
+#include "position.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+const int RESULT_UNKNOWN = 0, RESULT_WHITE_WINS = 1, RESULT_BLACK_WINS = 2, RESULT_DRAW = 3;
+
+struct PgnGame {
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::vector<std::string> moves;    // SAN tokens of the main line
+    int result = RESULT_UNKNOWN;
+};
+
+// Reads the next game from the stream. Returns false at end of input.
+bool readPgnGame(std::istream& in, PgnGame& game);
+
+std::string pgnTag(const PgnGame& game, const std::string& name);
+
+// Writes the game as PGN: tags, then the movetext wrapped at 80 columns
+void writePgnGame(std::ostream& out, const PgnGame& game);
+
+// Sets pos to the game's starting position (honouring a FEN tag)
+bool pgnStartPosition(const PgnGame& game, Position& pos);
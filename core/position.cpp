@@ -0,0 +1,889 @@
+#include "position.h"
+#include "geometry.h"
+#include "instrument.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+const char* START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// ========== ZOBRIST KEYS ==========
+
+// The keys are part of the opening book file format, so they are generated
+// from a fixed seed at compile time and never change between builds.
+struct ZobristKeys {
+    uint64_t piece[13][64];
+    uint64_t castling[16];
+    uint64_t epFile[8];
+    uint64_t side;
+};
+
+static constexpr uint64_t splitMix(uint64_t& state) {
+    state += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys keys{};
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (int p = W_KING; p <= B_PAWN; p++)
+        for (int sq = 0; sq < 64; sq++)
+            keys.piece[p][sq] = splitMix(state);
+    for (int c = 1; c < 16; c++) keys.castling[c] = splitMix(state);
+    for (int f = 0; f < 8; f++) keys.epFile[f] = splitMix(state);
+    keys.side = splitMix(state);
+    return keys;
+}
+
+static constexpr ZobristKeys zobrist = makeZobristKeys();
+
+// Castling rights that survive a move touching each square
+static constexpr int castleMask[64] = {
+    ~CASTLE_BQ & 15, 15, 15, 15, ~(CASTLE_BK | CASTLE_BQ) & 15, 15, 15, ~CASTLE_BK & 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    ~CASTLE_WQ & 15, 15, 15, 15, ~(CASTLE_WK | CASTLE_WQ) & 15, 15, 15, ~CASTLE_WK & 15
+};
+
+// ========== SETUP ==========
+
+// An en passant square only counts (for hashing and repetition) when a pawn can actually capture
+static bool epCapturePossible(const Position& pos, int epSquare) {
+    int myPawn = pos.whiteToMove ? W_PAWN : B_PAWN;
+    // Our pawns that could capture stand where an enemy pawn on the target square would attack
+    for (Bitboard from = pawnAttacks[pos.whiteToMove ? 1 : 0][epSquare]; from; ) {
+        if (pos.board[popLsb(from)] == myPawn) return true;
+    }
+    return false;
+}
+
+uint64_t computeKey(const Position& pos) {
+    uint64_t key = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (pos.board[sq] != NONE) key ^= zobrist.piece[pos.board[sq]][sq];
+    }
+    key ^= zobrist.castling[pos.castling];
+    if (pos.epSquare != -1) key ^= zobrist.epFile[colOf(pos.epSquare)];
+    if (!pos.whiteToMove) key ^= zobrist.side;
+    return key;
+}
+
+static int pieceFromChar(char ch) {
+    switch (ch) {
+    case 'K': return W_KING; case 'Q': return W_QUEEN; case 'B': return W_BISHOP;
+    case 'N': return W_KNIGHT; case 'R': return W_ROOK; case 'P': return W_PAWN;
+    case 'k': return B_KING; case 'q': return B_QUEEN; case 'b': return B_BISHOP;
+    case 'n': return B_KNIGHT; case 'r': return B_ROOK; case 'p': return B_PAWN;
+    default: return NONE;
+    }
+}
+
+static const char pieceChars[] = " KQBNRPkqbnrp";
+
+bool setFromFen(Position& pos, const string& fen) {
+    istringstream in(fen);
+    string placement, side, castling = "-", ep = "-";
+    int halfmove = 0, fullmove = 1;
+    if (!(in >> placement >> side)) return false;
+    in >> castling >> ep >> halfmove >> fullmove;
+
+    Position p = {};
+    p.kingSquare[0] = p.kingSquare[1] = -1;
+    int row = 0, col = 0;
+    for (char ch : placement) {
+        if (ch == '/') {
+            if (col != 8) return false;
+            row++; col = 0;
+        }
+        else if (ch >= '1' && ch <= '8') {
+            col += ch - '0';
+        }
+        else {
+            int piece = pieceFromChar(ch);
+            if (piece == NONE || !insideBoard(row, col)) return false;
+            p.board[squareOf(row, col)] = piece;
+            if (piece == W_KING) p.kingSquare[0] = squareOf(row, col);
+            if (piece == B_KING) p.kingSquare[1] = squareOf(row, col);
+            col++;
+        }
+        if (col > 8) return false;
+    }
+    if (row != 7 || col != 8 || p.kingSquare[0] == -1 || p.kingSquare[1] == -1) return false;
+
+    if (side != "w" && side != "b") return false;
+    p.whiteToMove = side == "w";
+
+    p.castling = 0;
+    for (char ch : castling) {
+        if (ch == 'K' && p.board[60] == W_KING && p.board[63] == W_ROOK) p.castling |= CASTLE_WK;
+        if (ch == 'Q' && p.board[60] == W_KING && p.board[56] == W_ROOK) p.castling |= CASTLE_WQ;
+        if (ch == 'k' && p.board[4] == B_KING && p.board[7] == B_ROOK) p.castling |= CASTLE_BK;
+        if (ch == 'q' && p.board[4] == B_KING && p.board[0] == B_ROOK) p.castling |= CASTLE_BQ;
+    }
+
+    p.epSquare = -1;
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && (ep[1] == '3' || ep[1] == '6')) {
+        int epSq = squareOf(8 - (ep[1] - '0'), ep[0] - 'a');
+        if (epCapturePossible(p, epSq)) p.epSquare = epSq;
+    }
+
+    p.halfmoveClock = halfmove;
+    p.fullmoveNumber = fullmove > 0 ? fullmove : 1;
+    p.key = computeKey(p);
+    pos = p;
+    return true;
+}
+
+bool writeFen(const Position& pos, char* out, size_t size) {
+    if (size == 0) return false;
+    // Longest case: 64 board characters, 7 slashes and the other fields
+    char fen[128];
+    size_t n = 0;
+    for (int row = 0; row < 8; row++) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            int piece = pos.board[squareOf(row, col)];
+            if (piece == NONE) { empty++; continue; }
+            if (empty) { fen[n++] = char('0' + empty); empty = 0; }
+            fen[n++] = pieceChars[piece];
+        }
+        if (empty) fen[n++] = char('0' + empty);
+        if (row < 7) fen[n++] = '/';
+    }
+    fen[n++] = ' ';
+    fen[n++] = pos.whiteToMove ? 'w' : 'b';
+    fen[n++] = ' ';
+    if (pos.castling == 0) fen[n++] = '-';
+    if (pos.castling & CASTLE_WK) fen[n++] = 'K';
+    if (pos.castling & CASTLE_WQ) fen[n++] = 'Q';
+    if (pos.castling & CASTLE_BK) fen[n++] = 'k';
+    if (pos.castling & CASTLE_BQ) fen[n++] = 'q';
+    fen[n++] = ' ';
+    if (pos.epSquare == -1) fen[n++] = '-';
+    else {
+        fen[n++] = char('a' + colOf(pos.epSquare));
+        fen[n++] = char('8' - rowOf(pos.epSquare));
+    }
+    snprintf(fen + n, sizeof(fen) - n, " %d %d", pos.halfmoveClock, pos.fullmoveNumber);
+    size_t length = strlen(fen);
+    size_t copied = min(length, size - 1);
+    memcpy(out, fen, copied);
+    out[copied] = '\0';
+    return copied == length;
+}
+
+string toFen(const Position& pos) {
+    char fen[128];
+    writeFen(pos, fen, sizeof(fen));
+    return fen;
+}
+
+void setStartPosition(Position& pos) {
+    setFromFen(pos, START_FEN);
+}
+
+// ========== ATTACK DETECTION ==========
+
+bool isAttacked(const Position& pos, int sq, bool byWhite) {
+    INSTRUMENT_COUNT(COUNTER_ATTACK_CHECKS);
+    const int* board = pos.board;
+
+    // A pawn attacks sq from the squares an opposite-coloured pawn on sq would attack
+    int pawn = byWhite ? W_PAWN : B_PAWN;
+    for (Bitboard from = pawnAttacks[byWhite ? 1 : 0][sq]; from; ) {
+        if (board[popLsb(from)] == pawn) return true;
+    }
+
+    int knight = byWhite ? W_KNIGHT : B_KNIGHT;
+    for (Bitboard from = knightAttacks[sq]; from; ) {
+        if (board[popLsb(from)] == knight) return true;
+    }
+
+    if (squareDistance[sq][pos.kingSquare[byWhite ? 0 : 1]] == 1) return true;
+
+    int rook = byWhite ? W_ROOK : B_ROOK;
+    int bishop = byWhite ? W_BISHOP : B_BISHOP;
+    int queen = byWhite ? W_QUEEN : B_QUEEN;
+    for (int d = 0; d < 8; d++) {
+        int straight = d < 4 ? rook : bishop;
+        const Ray& ray = rays[d][sq];
+        for (int i = 0; i < ray.length; i++) {
+            int piece = board[ray.squares[i]];
+            if (piece != NONE) {
+                if (piece == straight || piece == queen) return true;
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+bool inCheck(const Position& pos) {
+    return isAttacked(pos, pos.kingSquare[pos.whiteToMove ? 0 : 1], !pos.whiteToMove);
+}
+
+// ========== MOVE GENERATION ==========
+
+// The generators are templates on the side to move and the kind of moves
+// wanted, so every colour test and every "is this move wanted" test below is
+// a compile-time constant and each of the eight combinations is compiled
+// into straight-line code of its own.
+//
+//   GEN_ALL       every pseudo-legal move
+//   GEN_CAPTURES  captures, en passant and queen promotions (for quiescence)
+//   GEN_QUIETS    everything GEN_CAPTURES leaves out, underpromotions included
+//   GEN_EVASIONS  when in check: king moves, and with a single checker the
+//                 captures of it and interpositions
+
+template <bool White> static inline bool isOwn(int piece) {
+    return White ? (piece >= W_KING && piece <= W_PAWN) : piece >= B_KING;
+}
+template <bool White> static inline bool isEnemy(int piece) {
+    return White ? piece >= B_KING : (piece >= W_KING && piece <= W_PAWN);
+}
+
+// Whether a move onto target is wanted (evasion masks are applied by the caller)
+template <bool White, GenType Type> static inline bool wanted(int target) {
+    if (Type == GEN_CAPTURES) return isEnemy<White>(target);
+    if (Type == GEN_QUIETS) return target == NONE;
+    return target == NONE || isEnemy<White>(target);
+}
+
+template <GenType Type> static inline void addPromotions(Move* list, int& count, int from, int to) {
+    if (Type != GEN_QUIETS) list[count++] = createMove(from, to, MOVE_PROMOTION, W_QUEEN);
+    if (Type == GEN_CAPTURES) return;
+    list[count++] = createMove(from, to, MOVE_PROMOTION, W_ROOK);
+    list[count++] = createMove(from, to, MOVE_PROMOTION, W_BISHOP);
+    list[count++] = createMove(from, to, MOVE_PROMOTION, W_KNIGHT);
+}
+
+template <bool White, GenType Type>
+static void genPawn(const Position& pos, int from, Bitboard allowed, Move* list, int& count) {
+    const int* board = pos.board;
+    constexpr int dir = White ? -8 : 8;
+    constexpr int startRow = White ? 6 : 1;
+    constexpr int lastRow = White ? 0 : 7;
+    int to = from + dir;
+    bool promotion = rowOf(to) == lastRow;
+
+    // Pushes: quiet moves, except that promotions are generated with the captures
+    if (board[to] == NONE) {
+        if (promotion) {
+            if (allowed & squareBit(to)) addPromotions<Type>(list, count, from, to);
+        }
+        else if (Type != GEN_CAPTURES) {
+            if (allowed & squareBit(to)) list[count++] = createMove(from, to);
+            if (rowOf(from) == startRow && board[to + dir] == NONE && (allowed & squareBit(to + dir))) {
+                list[count++] = createMove(from, to + dir);
+            }
+        }
+    }
+
+    // Captures and en passant
+    for (Bitboard targets = pawnAttacks[White ? 0 : 1][from]; targets; ) {
+        to = popLsb(targets);
+        if (isEnemy<White>(board[to])) {
+            if (!(allowed & squareBit(to))) continue;
+            if (promotion) addPromotions<Type>(list, count, from, to);
+            else if (Type != GEN_QUIETS) list[count++] = createMove(from, to);
+        }
+        else if (Type != GEN_QUIETS && to == pos.epSquare) {
+            // Evasions: the captured pawn may be the checker, or the target square may block
+            if (allowed & (squareBit(to) | squareBit(to - dir))) list[count++] = createMove(from, to, MOVE_EN_PASSANT);
+        }
+    }
+}
+
+template <bool White, GenType Type>
+static void genStepper(const Position& pos, int from, Bitboard targets, Move* list, int& count) {
+    while (targets) {
+        int to = popLsb(targets);
+        if (wanted<White, Type>(pos.board[to])) list[count++] = createMove(from, to);
+    }
+}
+
+// Directions firstDirection .. lastDirection - 1 of the ray table
+template <bool White, GenType Type>
+static void genSlider(const Position& pos, int from, int firstDirection, int lastDirection,
+    Bitboard allowed, Move* list, int& count) {
+    for (int d = firstDirection; d < lastDirection; d++) {
+        const Ray& ray = rays[d][from];
+        for (int i = 0; i < ray.length; i++) {
+            int to = ray.squares[i];
+            int target = pos.board[to];
+            if (wanted<White, Type>(target) && (allowed & squareBit(to))) list[count++] = createMove(from, to);
+            if (target != NONE) break;
+        }
+    }
+}
+
+static bool allEmpty(const Position& pos, Bitboard squares) {
+    while (squares) {
+        if (pos.board[popLsb(squares)] != NONE) return false;
+    }
+    return true;
+}
+
+static bool anyAttacked(const Position& pos, Bitboard squares, bool byWhite) {
+    while (squares) {
+        if (isAttacked(pos, popLsb(squares), byWhite)) return true;
+    }
+    return false;
+}
+
+template <bool White>
+static void genCastling(const Position& pos, Move* list, int& count) {
+    constexpr int first = White ? 0 : 2;
+    for (int i = first; i < first + 2; i++) {
+        const CastlingPath& path = castlingPaths[i];
+        if ((pos.castling & path.right) && allEmpty(pos, path.empty) && !anyAttacked(pos, path.safe, !White)) {
+            list[count++] = createMove(path.kingFrom, path.kingTo, MOVE_CASTLING);
+        }
+    }
+}
+
+template <bool White, GenType Type>
+static void genPiece(const Position& pos, int sq, Bitboard allowed, Move* list, int& count) {
+    switch (pieceKind(pos.board[sq])) {
+    case W_PAWN: genPawn<White, Type>(pos, sq, allowed, list, count); break;
+    case W_KNIGHT: genStepper<White, Type>(pos, sq, knightAttacks[sq] & allowed, list, count); break;
+    case W_KING: genStepper<White, Type>(pos, sq, kingAttacks[sq], list, count); break;
+    case W_BISHOP: genSlider<White, Type>(pos, sq, DIR_UP_LEFT, 8, allowed, list, count); break;
+    case W_ROOK: genSlider<White, Type>(pos, sq, DIR_UP, DIR_UP_LEFT, allowed, list, count); break;
+    case W_QUEEN: genSlider<White, Type>(pos, sq, DIR_UP, 8, allowed, list, count); break;
+    default: break;
+    }
+}
+
+// Pieces of the given side attacking sq
+static Bitboard attackersOf(const Position& pos, int sq, bool byWhite) {
+    const int* board = pos.board;
+    Bitboard attackers = 0;
+    int pawn = byWhite ? W_PAWN : B_PAWN, knight = byWhite ? W_KNIGHT : B_KNIGHT;
+    for (Bitboard from = pawnAttacks[byWhite ? 1 : 0][sq]; from; ) {
+        int s = popLsb(from);
+        if (board[s] == pawn) attackers |= squareBit(s);
+    }
+    for (Bitboard from = knightAttacks[sq]; from; ) {
+        int s = popLsb(from);
+        if (board[s] == knight) attackers |= squareBit(s);
+    }
+    int queen = byWhite ? W_QUEEN : B_QUEEN;
+    for (int d = 0; d < 8; d++) {
+        int straight = d < 4 ? (byWhite ? W_ROOK : B_ROOK) : (byWhite ? W_BISHOP : B_BISHOP);
+        const Ray& ray = rays[d][sq];
+        for (int i = 0; i < ray.length; i++) {
+            int piece = board[ray.squares[i]];
+            if (piece == NONE) continue;
+            if (piece == straight || piece == queen) attackers |= squareBit(ray.squares[i]);
+            break;
+        }
+    }
+    return attackers;
+}
+
+template <bool White, GenType Type>
+static int generateFor(const Position& pos, Move* list) {
+    int count = 0;
+    Bitboard allowed = ~Bitboard(0);
+    if (Type == GEN_EVASIONS) {
+        int king = pos.kingSquare[White ? 0 : 1];
+        Bitboard checkers = attackersOf(pos, king, !White);
+        genStepper<White, GEN_ALL>(pos, king, kingAttacks[king], list, count);
+        // In double check only the king can move
+        if (checkers & (checkers - 1)) return count;
+        allowed = checkers | betweenSquares[king][lsb(checkers)];
+    }
+    for (int sq = 0; sq < 64; sq++) {
+        int piece = pos.board[sq];
+        if (!isOwn<White>(piece)) continue;
+        if (Type == GEN_EVASIONS && piece == (White ? W_KING : B_KING)) continue;
+        genPiece<White, Type>(pos, sq, allowed, list, count);
+    }
+    if (Type == GEN_ALL || Type == GEN_QUIETS) genCastling<White>(pos, list, count);
+    return count;
+}
+
+template <GenType Type>
+static int generate(const Position& pos, Move* list) {
+    INSTRUMENT_PHASE(PHASE_MOVE_GENERATION);
+    int count = pos.whiteToMove ? generateFor<true, Type>(pos, list) : generateFor<false, Type>(pos, list);
+    INSTRUMENT_ADD(COUNTER_MOVES_GENERATED, count);
+    return count;
+}
+
+int generateMoves(const Position& pos, Move* list) {
+    return generate<GEN_ALL>(pos, list);
+}
+
+int generateCaptures(const Position& pos, Move* list) {
+    return generate<GEN_CAPTURES>(pos, list);
+}
+
+int generateQuiets(const Position& pos, Move* list) {
+    return generate<GEN_QUIETS>(pos, list);
+}
+
+int generateEvasions(const Position& pos, Move* list) {
+    return generate<GEN_EVASIONS>(pos, list);
+}
+
+int generatePieceMoves(const Position& pos, int from, Move* list) {
+    int piece = pos.board[from];
+    if (piece == NONE || isWhite(piece) != pos.whiteToMove) return 0;
+    int count = 0;
+    if (pos.whiteToMove) {
+        genPiece<true, GEN_ALL>(pos, from, ~Bitboard(0), list, count);
+        if (piece == W_KING) genCastling<true>(pos, list, count);
+    }
+    else {
+        genPiece<false, GEN_ALL>(pos, from, ~Bitboard(0), list, count);
+        if (piece == B_KING) genCastling<false>(pos, list, count);
+    }
+    return count;
+}
+
+bool isLegalMove(Position& pos, Move m) {
+    INSTRUMENT_COUNT(COUNTER_LEGALITY_CHECKS);
+    UndoInfo undo;
+    makeMove(pos, m, undo);
+    // The side that just moved must not have left its king attacked
+    bool legal = !isAttacked(pos, pos.kingSquare[pos.whiteToMove ? 1 : 0], pos.whiteToMove);
+    unmakeMove(pos, m, undo);
+    return legal;
+}
+
+int generateLegalMoves(Position& pos, Move* list) {
+    Move pseudo[MOVE_LIST_SIZE];
+    int n = inCheck(pos) ? generateEvasions(pos, pseudo) : generateMoves(pos, pseudo);
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (isLegalMove(pos, pseudo[i])) list[count++] = pseudo[i];
+    }
+    return count;
+}
+
+// ========== LEGAL MOVE QUERIES ==========
+
+uint64_t checkers(const Position& pos) {
+    return attackersOf(pos, pos.kingSquare[pos.whiteToMove ? 0 : 1], !pos.whiteToMove);
+}
+
+// Pieces of the given side that alone shield its king from an enemy slider
+static Bitboard pinnedPieces(const Position& pos, int king, bool white) {
+    Bitboard pinned = 0;
+    for (int d = 0; d < 8; d++) {
+        int slider = d < 4 ? W_ROOK : W_BISHOP;
+        const Ray& ray = rays[d][king];
+        int shield = -1;
+        for (int i = 0; i < ray.length; i++) {
+            int piece = pos.board[ray.squares[i]];
+            if (piece == NONE) continue;
+            if (shield < 0 && isWhite(piece) == white) {
+                shield = ray.squares[i];
+                continue;
+            }
+            if (shield >= 0 && isWhite(piece) != white && (pieceKind(piece) == slider || pieceKind(piece) == W_QUEEN)) {
+                pinned |= squareBit(shield);
+            }
+            break;
+        }
+    }
+    return pinned;
+}
+
+// Squares a knight, bishop, rook or queen attacks, up to and including the first piece on each ray
+static Bitboard pieceTargets(const Position& pos, int sq, int kind) {
+    if (kind == W_KNIGHT) return knightAttacks[sq];
+    int first = kind == W_BISHOP ? DIR_UP_LEFT : DIR_UP;
+    int last = kind == W_ROOK ? DIR_UP_LEFT : 8;
+    Bitboard targets = 0;
+    for (int d = first; d < last; d++) {
+        const Ray& ray = rays[d][sq];
+        for (int i = 0; i < ray.length; i++) {
+            targets |= squareBit(ray.squares[i]);
+            if (pos.board[ray.squares[i]] != NONE) break;
+        }
+    }
+    return targets;
+}
+
+// Counts legal moves, or stops at the first one if firstOnly
+template <bool White>
+static int countLegal(Position& pos, bool firstOnly) {
+    int king = pos.kingSquare[White ? 0 : 1];
+    Bitboard own = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (isOwn<White>(pos.board[sq])) own |= squareBit(sq);
+    }
+    Bitboard checking = attackersOf(pos, king, !White);
+    Move list[MOVE_LIST_SIZE];
+    int count = 0, n = 0;
+
+    // Other pieces first, as they are cheaper to count. In double check only the king can move.
+    Bitboard allowed = checking ? checking | betweenSquares[king][lsb(checking)] : ~Bitboard(0);
+    Bitboard pinned = pinnedPieces(pos, king, White);
+    Bitboard pieces = (checking & (checking - 1)) ? 0 : own & ~squareBit(king);
+    while (pieces) {
+        int sq = popLsb(pieces);
+        int kind = pieceKind(pos.board[sq]);
+        if (kind == W_PAWN) {
+            // Pawn moves come in several kinds (pushes, promotions, en passant), so list them
+            n = 0;
+            genPawn<White, GEN_ALL>(pos, sq, allowed, list, n);
+            bool isPinned = (pinned & squareBit(sq)) != 0;
+            for (int i = 0; i < n; i++) {
+                if ((isPinned || moveFlag(list[i]) == MOVE_EN_PASSANT) && !isLegalMove(pos, list[i])) continue;
+                if (++count && firstOnly) return count;
+            }
+            continue;
+        }
+        Bitboard targets = pieceTargets(pos, sq, kind) & ~own & allowed;
+        if (pinned & squareBit(sq)) targets &= lineThrough[king][sq];
+        count += popCount(targets);
+        if (count && firstOnly) return count;
+    }
+
+    // The king may not step along a checking ray, so its moves are tried on the board
+    n = 0;
+    genStepper<White, GEN_ALL>(pos, king, kingAttacks[king], list, n);
+    for (int i = 0; i < n; i++) {
+        if (isLegalMove(pos, list[i]) && ++count && firstOnly) return count;
+    }
+
+    // Castling checks the squares the king passes, but not the one it lands on
+    if (!checking) {
+        n = 0;
+        genCastling<White>(pos, list, n);
+        for (int i = 0; i < n; i++) {
+            if (isLegalMove(pos, list[i])) count++;
+        }
+    }
+    return count;
+}
+
+int countLegalMoves(Position& pos) {
+    return pos.whiteToMove ? countLegal<true>(pos, false) : countLegal<false>(pos, false);
+}
+
+bool hasAnyLegalMove(Position& pos) {
+    return (pos.whiteToMove ? countLegal<true>(pos, true) : countLegal<false>(pos, true)) > 0;
+}
+
+GameEnd gameEnd(Position& pos) {
+    if (hasAnyLegalMove(pos)) return GAME_END_NONE;
+    return checkers(pos) ? GAME_END_CHECKMATE : GAME_END_STALEMATE;
+}
+
+// ========== MAKE / UNMAKE ==========
+
+void makeMove(Position& pos, Move m, UndoInfo& undo) {
+    int from = moveFrom(m), to = moveTo(m), flag = moveFlag(m);
+    int piece = pos.board[from];
+    bool white = pos.whiteToMove;
+    uint64_t key = pos.key;
+
+    undo.castling = pos.castling;
+    undo.epSquare = pos.epSquare;
+    undo.halfmoveClock = pos.halfmoveClock;
+    undo.key = pos.key;
+    undo.captured = pos.board[to];
+
+    if (pos.epSquare != -1) key ^= zobrist.epFile[colOf(pos.epSquare)];
+    pos.epSquare = -1;
+
+    if (flag == MOVE_EN_PASSANT) {
+        int capSq = white ? to + 8 : to - 8;
+        undo.captured = pos.board[capSq];
+        pos.board[capSq] = NONE;
+        key ^= zobrist.piece[undo.captured][capSq];
+    }
+    else if (undo.captured != NONE) {
+        key ^= zobrist.piece[undo.captured][to];
+    }
+
+    pos.board[from] = NONE;
+    pos.board[to] = piece;
+    key ^= zobrist.piece[piece][from] ^ zobrist.piece[piece][to];
+
+    if (flag == MOVE_PROMOTION) {
+        int promoted = colouredPiece(movePromotion(m), white);
+        pos.board[to] = promoted;
+        key ^= zobrist.piece[piece][to] ^ zobrist.piece[promoted][to];
+    }
+    else if (flag == MOVE_CASTLING) {
+        int rookFrom = to > from ? to + 1 : to - 2;
+        int rookTo = to > from ? to - 1 : to + 1;
+        int rook = pos.board[rookFrom];
+        pos.board[rookFrom] = NONE;
+        pos.board[rookTo] = rook;
+        key ^= zobrist.piece[rook][rookFrom] ^ zobrist.piece[rook][rookTo];
+    }
+
+    if (piece == W_KING) pos.kingSquare[0] = to;
+    else if (piece == B_KING) pos.kingSquare[1] = to;
+
+    int newCastling = pos.castling & castleMask[from] & castleMask[to];
+    key ^= zobrist.castling[pos.castling] ^ zobrist.castling[newCastling];
+    pos.castling = newCastling;
+
+    if (pieceKind(piece) == W_PAWN || undo.captured != NONE) pos.halfmoveClock = 0;
+    else pos.halfmoveClock++;
+    if (!white) pos.fullmoveNumber++;
+
+    pos.whiteToMove = !white;
+    key ^= zobrist.side;
+
+    if (pieceKind(piece) == W_PAWN && (from - to == 16 || to - from == 16)) {
+        int epSq = (from + to) / 2;
+        if (epCapturePossible(pos, epSq)) {
+            pos.epSquare = epSq;
+            key ^= zobrist.epFile[colOf(epSq)];
+        }
+    }
+    pos.key = key;
+}
+
+void unmakeMove(Position& pos, Move m, const UndoInfo& undo) {
+    int from = moveFrom(m), to = moveTo(m), flag = moveFlag(m);
+    pos.whiteToMove = !pos.whiteToMove;
+    bool white = pos.whiteToMove;
+    int piece = pos.board[to];
+
+    if (flag == MOVE_PROMOTION) piece = white ? W_PAWN : B_PAWN;
+    pos.board[from] = piece;
+
+    if (flag == MOVE_EN_PASSANT) {
+        pos.board[to] = NONE;
+        pos.board[white ? to + 8 : to - 8] = undo.captured;
+    }
+    else {
+        pos.board[to] = undo.captured;
+    }
+
+    if (flag == MOVE_CASTLING) {
+        int rookFrom = to > from ? to + 1 : to - 2;
+        int rookTo = to > from ? to - 1 : to + 1;
+        pos.board[rookFrom] = pos.board[rookTo];
+        pos.board[rookTo] = NONE;
+    }
+
+    if (piece == W_KING) pos.kingSquare[0] = from;
+    else if (piece == B_KING) pos.kingSquare[1] = from;
+
+    if (!white) pos.fullmoveNumber--;
+    pos.castling = undo.castling;
+    pos.epSquare = undo.epSquare;
+    pos.halfmoveClock = undo.halfmoveClock;
+    pos.key = undo.key;
+}
+
+void makeNullMove(Position& pos, UndoInfo& undo) {
+    undo.captured = NONE;
+    undo.castling = pos.castling;
+    undo.epSquare = pos.epSquare;
+    undo.halfmoveClock = pos.halfmoveClock;
+    undo.key = pos.key;
+
+    if (pos.epSquare != -1) pos.key ^= zobrist.epFile[colOf(pos.epSquare)];
+    pos.epSquare = -1;
+    pos.halfmoveClock = 0;
+    pos.whiteToMove = !pos.whiteToMove;
+    pos.key ^= zobrist.side;
+}
+
+void unmakeNullMove(Position& pos, const UndoInfo& undo) {
+    pos.whiteToMove = !pos.whiteToMove;
+    pos.epSquare = undo.epSquare;
+    pos.halfmoveClock = undo.halfmoveClock;
+    pos.key = undo.key;
+}
+
+// Counts leaves at depth 1 with countLegalMoves, without visiting them
+uint64_t perft(Position& pos, int depth) {
+    if (depth <= 1) return depth == 1 ? uint64_t(countLegalMoves(pos)) : 1;
+    Move moves[MOVE_LIST_SIZE];
+    int n = generateLegalMoves(pos, moves);
+    uint64_t nodes = 0;
+    for (int i = 0; i < n; i++) {
+        UndoInfo undo;
+        makeMove(pos, moves[i], undo);
+        nodes += perft(pos, depth - 1);
+        unmakeMove(pos, moves[i], undo);
+    }
+    return nodes;
+}
+
+// ========== NOTATION ==========
+
+string squareName(int sq) {
+    string name;
+    name += char('a' + colOf(sq));
+    name += char('8' - rowOf(sq));
+    return name;
+}
+
+string moveToUci(Move m) {
+    if (m == NO_MOVE) return "0000";
+    string text = squareName(moveFrom(m)) + squareName(moveTo(m));
+    if (moveFlag(m) == MOVE_PROMOTION) text += pieceChars[movePromotion(m) + W_PAWN];
+    return text;
+}
+
+// Compares squares and promotion piece directly, so validating a move does
+// not build a string for every legal move
+Move parseUciMove(Position& pos, const string& text) {
+    if (text.size() != 4 && text.size() != 5) return NO_MOVE;
+    if (text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8' ||
+        text[2] < 'a' || text[2] > 'h' || text[3] < '1' || text[3] > '8') return NO_MOVE;
+    int from = squareOf('8' - text[1], text[0] - 'a');
+    int to = squareOf('8' - text[3], text[2] - 'a');
+    int promotion = NONE;
+    if (text.size() == 5) {
+        const char* p = strchr(pieceChars + B_KING, tolower(text[4]));
+        if (!p || *p == '\0') return NO_MOVE;
+        promotion = int(p - pieceChars) - W_PAWN;
+    }
+
+    Move moves[MOVE_LIST_SIZE];
+    int n = generateLegalMoves(pos, moves);
+    for (int i = 0; i < n; i++) {
+        if (moveFrom(moves[i]) != from || moveTo(moves[i]) != to) continue;
+        bool isPromotion = moveFlag(moves[i]) == MOVE_PROMOTION;
+        if (isPromotion ? movePromotion(moves[i]) == promotion : promotion == NONE) return moves[i];
+    }
+    return NO_MOVE;
+}
+
+static const char sanLetters[] = " KQBNR";
+
+string moveToSan(Position& pos, Move m) {
+    int from = moveFrom(m), to = moveTo(m), flag = moveFlag(m);
+    int kind = pieceKind(pos.board[from]);
+    string san;
+
+    if (flag == MOVE_CASTLING) {
+        san = to > from ? "O-O" : "O-O-O";
+    }
+    else {
+        bool capture = pos.board[to] != NONE || flag == MOVE_EN_PASSANT;
+        if (kind == W_PAWN) {
+            if (capture) san += char('a' + colOf(from));
+        }
+        else {
+            san += sanLetters[kind];
+            // Disambiguate against other pieces of the same kind reaching the same square
+            Move moves[MOVE_LIST_SIZE];
+            int n = generateLegalMoves(pos, moves);
+            bool ambiguous = false, sameFile = false, sameRow = false;
+            for (int i = 0; i < n; i++) {
+                int other = moveFrom(moves[i]);
+                if (other == from || moveTo(moves[i]) != to || pos.board[other] != pos.board[from]) continue;
+                ambiguous = true;
+                if (colOf(other) == colOf(from)) sameFile = true;
+                if (rowOf(other) == rowOf(from)) sameRow = true;
+            }
+            if (ambiguous) {
+                if (!sameFile) san += char('a' + colOf(from));
+                else if (!sameRow) san += char('8' - rowOf(from));
+                else san += squareName(from);
+            }
+        }
+        if (capture) san += 'x';
+        san += squareName(to);
+        if (flag == MOVE_PROMOTION) {
+            san += '=';
+            san += sanLetters[movePromotion(m)];
+        }
+    }
+
+    UndoInfo undo;
+    makeMove(pos, m, undo);
+    if (inCheck(pos)) san += hasAnyLegalMove(pos) ? '+' : '#';
+    unmakeMove(pos, m, undo);
+    return san;
+}
+
+Move parseSanMove(Position& pos, const string& text) {
+    string san = text;
+    while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?')) {
+        san.pop_back();
+    }
+    if (san.empty()) return NO_MOVE;
+
+    // Pseudo-legal moves; legality is only checked for the moves that match,
+    // which makes replaying game archives several times faster
+    Move moves[MOVE_LIST_SIZE];
+    int n = inCheck(pos) ? generateEvasions(pos, moves) : generateMoves(pos, moves);
+
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        bool kingside = san.size() == 3;
+        for (int i = 0; i < n; i++) {
+            if (moveFlag(moves[i]) == MOVE_CASTLING && (moveTo(moves[i]) > moveFrom(moves[i])) == kingside) {
+                return isLegalMove(pos, moves[i]) ? moves[i] : NO_MOVE;
+            }
+        }
+        return NO_MOVE;
+    }
+
+    // Promotion suffix: "e8=Q" or "e8Q"
+    int promotion = NONE;
+    size_t eq = san.find('=');
+    if (eq != string::npos) {
+        if (eq + 1 >= san.size()) return NO_MOVE;
+        promotion = pieceKind(pieceFromChar(char(toupper(san[eq + 1]))));
+        san.erase(eq);
+    }
+    else if (san.size() > 2 && strchr("QRBN", san.back()) && isdigit((unsigned char)san[san.size() - 2])) {
+        promotion = pieceKind(pieceFromChar(san.back()));
+        san.pop_back();
+    }
+
+    int kind = W_PAWN;
+    size_t start = 0;
+    if (strchr("KQRBN", san[0])) {
+        kind = pieceKind(pieceFromChar(san[0]));
+        start = 1;
+    }
+    if (san.size() < start + 2) return NO_MOVE;
+    char fileCh = san[san.size() - 2], rankCh = san[san.size() - 1];
+    if (fileCh < 'a' || fileCh > 'h' || rankCh < '1' || rankCh > '8') return NO_MOVE;
+    int to = squareOf('8' - rankCh, fileCh - 'a');
+
+    int fromCol = -1, fromRow = -1;
+    for (size_t i = start; i + 2 < san.size(); i++) {
+        char ch = san[i];
+        if (ch >= 'a' && ch <= 'h') fromCol = ch - 'a';
+        else if (ch >= '1' && ch <= '8') fromRow = '8' - ch;
+        else if (ch != 'x' && ch != '-' && ch != ':') return NO_MOVE;
+    }
+
+    Move found = NO_MOVE;
+    for (int i = 0; i < n; i++) {
+        Move m = moves[i];
+        int from = moveFrom(m);
+        if (moveTo(m) != to || pieceKind(pos.board[from]) != kind || moveFlag(m) == MOVE_CASTLING) continue;
+        if (fromCol != -1 && colOf(from) != fromCol) continue;
+        if (fromRow != -1 && rowOf(from) != fromRow) continue;
+        if (moveFlag(m) == MOVE_PROMOTION) {
+            if (movePromotion(m) != (promotion == NONE ? W_QUEEN : promotion)) continue;
+        }
+        else if (promotion != NONE) continue;
+        if (!isLegalMove(pos, m)) continue;
+        if (found != NO_MOVE) return NO_MOVE;  // ambiguous
+        found = m;
+    }
+    return found;
+}
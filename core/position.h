@@ -0,0 +1,127 @@
+#pragma once
+// Headless chess rules core: board representation, FEN, hashing,
+// move generation and make/unmake. Used by the engine and the CLI tools,
+// and by the GUI whenever it needs a self-contained copy of the game state.
+
+#include <cstdint>
+#include <string>
+
+// Integer constants for Piece Types (shared with the GUI board)
+const int NONE = 0, W_KING = 1, W_QUEEN = 2, W_BISHOP = 3, W_KNIGHT = 4, W_ROOK = 5;
+const int W_PAWN = 6, B_KING = 7, B_QUEEN = 8, B_BISHOP = 9, B_KNIGHT = 10, B_ROOK = 11, B_PAWN = 12;
+
+// Movement helpers
+inline bool insideBoard(int r, int c) { return r >= 0 && r < 8 && c >= 0 && c < 8; }
+inline bool isWhite(int p) { return p >= W_KING && p <= W_PAWN; }
+inline bool isBlack(int p) { return p >= B_KING && p <= B_PAWN; }
+inline bool isEnemyPiece(int target, int me) {
+    return (isWhite(me) && isBlack(target)) || (isBlack(me) && isWhite(target));
+}
+
+// Colourless piece kind (W_KING..W_PAWN) and the reverse mapping
+inline int pieceKind(int p) { return p > W_PAWN ? p - W_PAWN : p; }
+inline int colouredPiece(int kind, bool white) { return white ? kind : kind + W_PAWN; }
+
+// Squares are numbered row * 8 + col with row 0 being rank 8,
+// the same orientation as board[row][col] in the GUI.
+inline int squareOf(int row, int col) { return row * 8 + col; }
+inline int rowOf(int sq) { return sq >> 3; }
+inline int colOf(int sq) { return sq & 7; }
+
+// Castling rights bits
+const int CASTLE_WK = 1, CASTLE_WQ = 2, CASTLE_BK = 4, CASTLE_BQ = 8;
+
+// Moves are packed into 16 bits: from (6) | to (6) | promotion (2) | flag (2)
+typedef uint16_t Move;
+const Move NO_MOVE = 0;
+const int MOVE_NORMAL = 0, MOVE_PROMOTION = 1, MOVE_EN_PASSANT = 2, MOVE_CASTLING = 3;
+
+inline Move createMove(int from, int to, int flag = MOVE_NORMAL, int promotionKind = W_QUEEN) {
+    return Move(from | (to << 6) | ((promotionKind - W_QUEEN) << 12) | (flag << 14));
+}
+inline int moveFrom(Move m) { return m & 63; }
+inline int moveTo(Move m) { return (m >> 6) & 63; }
+inline int moveFlag(Move m) { return m >> 14; }
+inline int movePromotion(Move m) { return ((m >> 12) & 3) + W_QUEEN; }
+
+// Upper bound on the number of moves in any position
+const int MOVE_LIST_SIZE = 256;
+
+struct Position {
+    int board[64];
+    bool whiteToMove;
+    int castling;          // CASTLE_* bits
+    int epSquare;          // en passant target square, -1 if no capture is possible
+    int halfmoveClock;
+    int fullmoveNumber;
+    int kingSquare[2];     // [0] white king, [1] black king
+    uint64_t key;          // Zobrist hash
+};
+
+// Everything makeMove destroys and unmakeMove needs back
+struct UndoInfo {
+    int captured;
+    int castling;
+    int epSquare;
+    int halfmoveClock;
+    uint64_t key;
+};
+
+extern const char* START_FEN;
+
+// FEN and setup
+bool setFromFen(Position& pos, const std::string& fen);
+std::string toFen(const Position& pos);
+// The same into a caller's buffer, without allocating; false if it had to be cut short
+bool writeFen(const Position& pos, char* out, size_t size);
+void setStartPosition(Position& pos);
+uint64_t computeKey(const Position& pos);
+
+// Attack detection
+bool isAttacked(const Position& pos, int sq, bool byWhite);
+bool inCheck(const Position& pos);
+
+// Move generation. generateMoves produces pseudo-legal moves; generateCaptures
+// only captures and queen promotions (for quiescence search) and
+// generateQuiets the rest, so the two together are generateMoves.
+// generateEvasions is for positions in check: king moves plus captures of
+// and interpositions against a single checker.
+enum GenType { GEN_ALL, GEN_CAPTURES, GEN_QUIETS, GEN_EVASIONS };
+int generateMoves(const Position& pos, Move* list);
+int generateCaptures(const Position& pos, Move* list);
+int generateQuiets(const Position& pos, Move* list);
+int generateEvasions(const Position& pos, Move* list);
+// Pseudo-legal moves of the side to move's piece on one square (castling included for the king)
+int generatePieceMoves(const Position& pos, int from, Move* list);
+int generateLegalMoves(Position& pos, Move* list);
+bool isLegalMove(Position& pos, Move m);
+
+// Legal move queries that build no move list. Pieces that are neither pinned
+// nor the king are counted by popcount of their target squares; only king,
+// pinned pawn and en passant moves are tried on the board. hasAnyLegalMove
+// stops at the first legal move it finds.
+uint64_t checkers(const Position& pos);       // bitboard of the pieces giving check
+int countLegalMoves(Position& pos);
+bool hasAnyLegalMove(Position& pos);
+
+// Checkmate and stalemate from one pass: checkers once, then hasAnyLegalMove
+enum GameEnd { GAME_END_NONE, GAME_END_CHECKMATE, GAME_END_STALEMATE };
+GameEnd gameEnd(Position& pos);
+
+// Make/unmake
+void makeMove(Position& pos, Move m, UndoInfo& undo);
+void unmakeMove(Position& pos, Move m, const UndoInfo& undo);
+// Passes the turn (for null-move pruning). The halfmove clock restarts, so
+// repetition checks never look back past a null move.
+void makeNullMove(Position& pos, UndoInfo& undo);
+void unmakeNullMove(Position& pos, const UndoInfo& undo);
+
+// Number of leaf nodes of the legal move tree to the given depth
+uint64_t perft(Position& pos, int depth);
+
+// Notation
+std::string squareName(int sq);
+std::string moveToUci(Move m);
+Move parseUciMove(Position& pos, const std::string& text);
+std::string moveToSan(Position& pos, Move m);
+Move parseSanMove(Position& pos, const std::string& text);
@@ -0,0 +1,147 @@
+#pragma once
+// Bounded lock-free queue for connecting pipeline stages: any number of
+// producers and consumers, a fixed ring of cells allocated up front, and no
+// locks, so a stage never waits on another stage's critical section. Each
+// cell carries a sequence number that tells producers and consumers whose
+// turn it is (D. Vyukov's bounded MPMC queue).
+//
+// The try functions never block; stages wait with queueBackoff when the
+// queue is full or empty. A producer closes the queue when it is done and
+// consumers stop once it is closed and drained.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+template <typename T>
+struct BoundedQueue {
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    // Producers and consumers each get their own cache line
+    alignas(64) std::atomic<size_t> tail{ 0 };     // next cell to fill
+    alignas(64) std::atomic<size_t> head{ 0 };     // next cell to empty
+    alignas(64) std::atomic<bool> closed{ false };
+};
+
+// Capacity is rounded up to a power of two. Not thread-safe; call before use.
+template <typename T>
+void queueInit(BoundedQueue<T>& q, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+    q.cells.reset(new typename BoundedQueue<T>::Cell[size]);
+    for (size_t i = 0; i < size; i++) q.cells[i].sequence.store(i, std::memory_order_relaxed);
+    q.mask = size - 1;
+    q.tail.store(0, std::memory_order_relaxed);
+    q.head.store(0, std::memory_order_relaxed);
+    q.closed.store(false, std::memory_order_relaxed);
+}
+
+// Moves value into the queue. Returns false (leaving value alone) if it is full.
+template <typename T>
+bool queueTryPush(BoundedQueue<T>& q, T& value) {
+    size_t pos = q.tail.load(std::memory_order_relaxed);
+    for (;;) {
+        auto& cell = q.cells[pos & q.mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+        if (diff == 0) {
+            if (q.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.value = std::move(value);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            pos = q.tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Moves the oldest value out of the queue. Returns false if it is empty.
+template <typename T>
+bool queueTryPop(BoundedQueue<T>& q, T& value) {
+    size_t pos = q.head.load(std::memory_order_relaxed);
+    for (;;) {
+        auto& cell = q.cells[pos & q.mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = intptr_t(sequence) - intptr_t(pos + 1);
+        if (diff == 0) {
+            if (q.head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                value = std::move(cell.value);
+                cell.sequence.store(pos + q.mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            pos = q.head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+void queueClose(BoundedQueue<T>& q) {
+    q.closed.store(true, std::memory_order_release);
+}
+
+// Spins briefly, then yields, then sleeps, so a waiting stage costs little
+// when the wait is long and reacts quickly when it is short
+inline void queueBackoff(int& attempt) {
+    if (attempt < 16) {
+        attempt++;
+    }
+    else if (attempt < 64) {
+        attempt++;
+        std::this_thread::yield();
+    }
+    else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+// Pops a value, waiting while the queue is empty but open. Returns false
+// once the queue is closed and drained. waited accumulates the time spent waiting.
+template <typename T>
+bool queuePop(BoundedQueue<T>& q, T& value, std::chrono::nanoseconds& waited) {
+    if (queueTryPop(q, value)) return true;
+    auto start = std::chrono::steady_clock::now();
+    int attempt = 0;
+    bool popped = false;
+    for (;;) {
+        if (queueTryPop(q, value)) {
+            popped = true;
+            break;
+        }
+        // Anything pushed before the close is visible after it
+        if (q.closed.load(std::memory_order_acquire)) {
+            popped = queueTryPop(q, value);
+            break;
+        }
+        queueBackoff(attempt);
+    }
+    waited += std::chrono::steady_clock::now() - start;
+    return popped;
+}
+
+// Pushes a value, waiting while the queue is full. waited accumulates the time spent waiting.
+template <typename T>
+void queuePush(BoundedQueue<T>& q, T& value, std::chrono::nanoseconds& waited) {
+    if (queueTryPush(q, value)) return;
+    auto start = std::chrono::steady_clock::now();
+    int attempt = 0;
+    while (!queueTryPush(q, value)) queueBackoff(attempt);
+    waited += std::chrono::steady_clock::now() - start;
+}
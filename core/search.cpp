@@ -0,0 +1,468 @@
+#include "search.h"
+#include "eval.h"
+#include "instrument.h"
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+using namespace std;
+
+// ========== TRANSPOSITION TABLE ==========
+
+void ttResize(TranspositionTable& tt, size_t megabytes) {
+    size_t count = 1;
+    while (count * 2 * sizeof(TTEntry) <= megabytes * 1024 * 1024) count *= 2;
+    tt.entries.assign(count, TTEntry{});
+    tt.mask = count - 1;
+}
+
+void ttClear(TranspositionTable& tt) {
+    fill(tt.entries.begin(), tt.entries.end(), TTEntry{});
+}
+
+const TTEntry* ttProbe(const TranspositionTable& tt, uint64_t key) {
+    const TTEntry& entry = tt.entries[key & tt.mask];
+    return entry.key == key ? &entry : nullptr;
+}
+
+void ttStore(TranspositionTable& tt, uint64_t key, Move move, int score, int depth, int bound) {
+    TTEntry& entry = tt.entries[key & tt.mask];
+    // Keep the old move when re-storing the same position without one
+    if (move == NO_MOVE && entry.key == key) move = entry.move;
+    entry.key = key;
+    entry.move = move;
+    entry.score = int16_t(score);
+    entry.depth = int8_t(depth);
+    entry.bound = uint8_t(bound);
+}
+
+// Mate scores are stored relative to the node, not the root
+static int scoreToTT(int score, int ply) {
+    if (score >= MATE_SCORE - MAX_PLY) return score + ply;
+    if (score <= -MATE_SCORE + MAX_PLY) return score - ply;
+    return score;
+}
+
+static int scoreFromTT(int score, int ply) {
+    if (score >= MATE_SCORE - MAX_PLY) return score - ply;
+    if (score <= -MATE_SCORE + MAX_PLY) return score + ply;
+    return score;
+}
+
+// ========== SEARCH HELPERS ==========
+
+// Move ordering scores; quiet moves below the killers are ordered by history
+const int HASH_MOVE_SCORE = 1000000;
+const int CAPTURE_SCORE = 100000;
+const int KILLER_SCORES[2] = { 90000, 80000 };
+
+// Selectivity parameters (depths in plies, margins in centipawns)
+const int NULL_MOVE_MIN_DEPTH = 3;
+const int NULL_MOVE_VERIFY_DEPTH = 10;     // null-move cutoffs from here up are verified
+const int RAZOR_MARGIN[3] = { 0, 300, 550 };
+const int FUTILITY_MARGIN[4] = { 0, 150, 300, 500 };
+const int LMR_MIN_DEPTH = 3;
+const int LMR_FULL_MOVES = 3;              // legal moves searched at full depth first
+const int LMR_GOOD_HISTORY = 2000;         // quiets with this much history are reduced one ply less
+
+// Late move reductions by [depth][move number], filled in by initSearch
+static int lmrReductions[64][64];
+
+void initSearch(Search& s, size_t hashMegabytes) {
+    for (int depth = 1; depth < 64; depth++) {
+        for (int move = 1; move < 64; move++) {
+            lmrReductions[depth][move] = int(0.5 + log(double(depth)) * log(double(move)) / 2.5);
+        }
+    }
+    ttResize(s.tt, hashMegabytes);
+    arenaInit(s.stack, MAX_PLY * SEARCH_FRAME_BYTES);
+    newGame(s);
+}
+
+void newGame(Search& s) {
+    ttClear(s.tt);
+    memset(s.killers, 0, sizeof(s.killers));
+    memset(s.history, 0, sizeof(s.history));
+}
+
+int64_t elapsedMs(const Search& s) {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - s.startTime).count();
+}
+
+// Called at every node; only reads the clock every TIME_CHECK_NODES nodes
+static bool timeUp(Search& s) {
+    if (s.stop.load(memory_order_relaxed)) return true;
+    if ((s.nodes & (TIME_CHECK_NODES - 1)) != 0 || s.pondering.load(memory_order_relaxed)) return false;
+    if ((s.limits.hardMs > 0 && chrono::steady_clock::now() >= s.hardDeadline) ||
+        (s.limits.nodes > 0 && s.nodes >= s.limits.nodes)) {
+        s.stop = true;
+    }
+    return s.stop.load(memory_order_relaxed);
+}
+
+static bool isRepetition(const Search& s, const Position& pos) {
+    int last = int(s.keys.size()) - 1;
+    int stopAt = max(0, last - pos.halfmoveClock);
+    for (int i = last - 2; i >= stopAt; i -= 2) {
+        if (s.keys[i] == pos.key) return true;
+    }
+    return false;
+}
+
+static int scoreMove(const Search& s, const Position& pos, Move m, Move hashMove, int ply) {
+    if (m == hashMove) return HASH_MOVE_SCORE;
+    int flag = moveFlag(m);
+    int victim = flag == MOVE_EN_PASSANT ? W_PAWN : pieceKind(pos.board[moveTo(m)]);
+    if (victim != NONE || flag == MOVE_PROMOTION) {
+        int attacker = pieceKind(pos.board[moveFrom(m)]);
+        int promotion = flag == MOVE_PROMOTION ? pieceValue[movePromotion(m)] : 0;
+        return CAPTURE_SCORE + pieceValue[victim] * 10 - pieceValue[attacker] / 10 + promotion;
+    }
+    if (m == s.killers[ply][0]) return KILLER_SCORES[0];
+    if (m == s.killers[ply][1]) return KILLER_SCORES[1];
+    return s.history[pos.board[moveFrom(m)]][moveTo(m)];
+}
+
+// Moves the best remaining move to index i (selection sort step)
+static void pickMove(Move* moves, int* scores, int count, int i) {
+    int best = i;
+    for (int j = i + 1; j < count; j++) {
+        if (scores[j] > scores[best]) best = j;
+    }
+    swap(moves[i], moves[best]);
+    swap(scores[i], scores[best]);
+}
+
+// Hash moves may come from a key collision, so check them against the move list
+static bool isGeneratedLegal(Position& pos, Move m) {
+    Move moves[MOVE_LIST_SIZE];
+    int count = generateLegalMoves(pos, moves);
+    for (int i = 0; i < count; i++) {
+        if (moves[i] == m) return true;
+    }
+    return false;
+}
+
+static bool leftKingInCheck(const Position& pos) {
+    INSTRUMENT_COUNT(COUNTER_LEGALITY_CHECKS);
+    return isAttacked(pos, pos.kingSquare[pos.whiteToMove ? 1 : 0], pos.whiteToMove);
+}
+
+static bool isExcludedRootMove(const Search& s, Move m) {
+    for (int i = 0; i < s.excludedCount; i++) {
+        if (s.excludedRootMoves[i] == m) return true;
+    }
+    return false;
+}
+
+// Null moves are unsafe with only king and pawns, where zugzwang is common
+static bool hasPieces(const Position& pos) {
+    for (int sq = 0; sq < 64; sq++) {
+        int piece = pos.board[sq];
+        if (piece != NONE && isWhite(piece) == pos.whiteToMove && pieceKind(piece) != W_PAWN && pieceKind(piece) != W_KING) return true;
+    }
+    return false;
+}
+
+// ========== ALPHA-BETA ==========
+
+static int quiescence(Search& s, Position& pos, int alpha, int beta, int ply) {
+    s.nodes++;
+    if (timeUp(s)) return 0;
+
+    int standPat = evaluate(pos);
+    if (ply >= MAX_PLY - 1) return standPat;
+    if (standPat >= beta) return standPat;
+    if (standPat > alpha) alpha = standPat;
+
+    ArenaScope frame(s.stack);
+    Move* moves = arenaAlloc<Move>(s.stack, MOVE_LIST_SIZE);
+    int* scores = arenaAlloc<int>(s.stack, MOVE_LIST_SIZE);
+    int count = generateCaptures(pos, moves);
+    for (int i = 0; i < count; i++) scores[i] = scoreMove(s, pos, moves[i], NO_MOVE, ply);
+
+    for (int i = 0; i < count; i++) {
+        pickMove(moves, scores, count, i);
+        UndoInfo undo;
+        makeMove(pos, moves[i], undo);
+        if (leftKingInCheck(pos)) {
+            unmakeMove(pos, moves[i], undo);
+            continue;
+        }
+        int score = -quiescence(s, pos, -beta, -alpha, ply + 1);
+        unmakeMove(pos, moves[i], undo);
+        if (s.stop) return 0;
+
+        if (score >= beta) return score;
+        if (score > alpha) alpha = score;
+    }
+    return alpha;
+}
+
+static int alphaBeta(Search& s, Position& pos, int depth, int alpha, int beta, int ply, bool allowNull) {
+    s.pvLength[ply] = ply;
+    if (ply > 0 && (pos.halfmoveClock >= 100 || isRepetition(s, pos))) return 0;
+
+    // Check extension; it also keeps positions in check out of quiescence
+    bool checked = inCheck(pos);
+    if (checked && s.features.checkExtensions) depth++;
+    if (depth <= 0) return quiescence(s, pos, alpha, beta, ply);
+
+    s.nodes++;
+    if (timeUp(s)) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(pos);
+
+    Move hashMove = NO_MOVE;
+    const TTEntry* entry = ttProbe(s.tt, pos.key);
+    if (entry) {
+        hashMove = entry->move;
+        if (ply > 0 && entry->depth >= depth) {
+            int score = scoreFromTT(entry->score, ply);
+            if (entry->bound == BOUND_EXACT ||
+                (entry->bound == BOUND_LOWER && score >= beta) ||
+                (entry->bound == BOUND_UPPER && score <= alpha)) return score;
+        }
+    }
+
+    // Pruning is only tried in null-window nodes, away from the principal variation
+    bool pvNode = beta - alpha > 1;
+    bool prunable = !pvNode && !checked && !isMateScore(alpha) && !isMateScore(beta);
+    int staticEval = prunable ? evaluate(pos) : 0;
+
+    if (prunable && s.features.futility) {
+        // Razoring: far below alpha, only a capture could help, so ask quiescence
+        if (depth <= 2 && staticEval + RAZOR_MARGIN[depth] <= alpha) {
+            int score = quiescence(s, pos, alpha, alpha + 1, ply);
+            if (s.stop) return 0;
+            if (score <= alpha) return score;
+        }
+        // Reverse futility: far enough above beta that a quiet reply is assumed to keep it there
+        if (depth <= 3 && staticEval - FUTILITY_MARGIN[depth] >= beta) return staticEval;
+    }
+
+    // Null move: if passing still fails high, a real move would too
+    if (prunable && s.features.nullMove && allowNull && depth >= NULL_MOVE_MIN_DEPTH &&
+        staticEval >= beta && hasPieces(pos)) {
+        int reduction = 3 + depth / 6;
+        UndoInfo undo;
+        makeNullMove(pos, undo);
+        s.keys.push_back(pos.key);
+        int score = -alphaBeta(s, pos, depth - 1 - reduction, -beta, -beta + 1, ply + 1, false);
+        s.keys.pop_back();
+        unmakeNullMove(pos, undo);
+        if (s.stop) return 0;
+        if (score >= beta) {
+            if (isMateScore(score)) score = beta;
+            // Deep cutoffs are verified by a reduced search without null moves, against zugzwang
+            if (depth < NULL_MOVE_VERIFY_DEPTH) return score;
+            int verified = alphaBeta(s, pos, depth - 1 - reduction, beta - 1, beta, ply, false);
+            if (s.stop) return 0;
+            if (verified >= beta) return score;
+        }
+    }
+
+    ArenaScope frame(s.stack);
+    Move* moves = arenaAlloc<Move>(s.stack, MOVE_LIST_SIZE);
+    int* scores = arenaAlloc<int>(s.stack, MOVE_LIST_SIZE);
+    int count = checked ? generateEvasions(pos, moves) : generateMoves(pos, moves);
+    for (int i = 0; i < count; i++) scores[i] = scoreMove(s, pos, moves[i], hashMove, ply);
+
+    // Futility pruning: quiet moves can't lift a hopeless static score up to alpha
+    bool futile = prunable && s.features.futility && depth <= 3 && staticEval + FUTILITY_MARGIN[depth] <= alpha;
+
+    int originalAlpha = alpha;
+    int bestScore = -INFINITE_SCORE;
+    Move bestMove = NO_MOVE;
+    int legalMoves = 0;
+
+    for (int i = 0; i < count; i++) {
+        pickMove(moves, scores, count, i);
+        Move m = moves[i];
+        if (ply == 0 && isExcludedRootMove(s, m)) continue;
+        bool quiet = pos.board[moveTo(m)] == NONE && moveFlag(m) != MOVE_EN_PASSANT && moveFlag(m) != MOVE_PROMOTION;
+        int movedPiece = pos.board[moveFrom(m)];
+
+        UndoInfo undo;
+        makeMove(pos, m, undo);
+        if (leftKingInCheck(pos)) {
+            unmakeMove(pos, m, undo);
+            continue;
+        }
+        legalMoves++;
+
+        // Late quiet moves that don't give check may be pruned or reduced
+        bool reducible = s.features.lateMoveReductions && depth >= LMR_MIN_DEPTH && legalMoves > LMR_FULL_MOVES &&
+            !checked && scores[i] < KILLER_SCORES[1];
+        bool late = quiet && legalMoves > 1 && (futile || reducible) && !inCheck(pos);
+        if (late && futile) {
+            unmakeMove(pos, m, undo);
+            bestScore = max(bestScore, staticEval + FUTILITY_MARGIN[depth]);
+            continue;
+        }
+
+        s.keys.push_back(pos.key);
+        int score;
+        if (legalMoves == 1) {
+            score = -alphaBeta(s, pos, depth - 1, -beta, -alpha, ply + 1, true);
+        }
+        else {
+            // Principal variation search: a null window proves the move is no better, maybe at reduced depth
+            int reduction = 0;
+            if (late && reducible) {
+                reduction = lmrReductions[min(depth, 63)][min(legalMoves, 63)];
+                if (pvNode) reduction--;
+                if (scores[i] >= LMR_GOOD_HISTORY) reduction--;
+                reduction = max(0, min(reduction, depth - 2));
+            }
+            score = -alphaBeta(s, pos, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1, true);
+            if (score > alpha && reduction > 0) score = -alphaBeta(s, pos, depth - 1, -alpha - 1, -alpha, ply + 1, true);
+            if (score > alpha && score < beta) score = -alphaBeta(s, pos, depth - 1, -beta, -alpha, ply + 1, true);
+        }
+        s.keys.pop_back();
+        unmakeMove(pos, m, undo);
+        if (s.stop) return 0;
+
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = m;
+        }
+        if (score > alpha) {
+            alpha = score;
+            // Update the principal variation
+            s.pvTable[ply][ply] = m;
+            for (int j = ply + 1; j < s.pvLength[ply + 1]; j++) s.pvTable[ply][j] = s.pvTable[ply + 1][j];
+            s.pvLength[ply] = s.pvLength[ply + 1];
+        }
+        if (alpha >= beta) {
+            if (quiet) {
+                if (s.killers[ply][0] != m) {
+                    s.killers[ply][1] = s.killers[ply][0];
+                    s.killers[ply][0] = m;
+                }
+                s.history[movedPiece][moveTo(m)] += depth * depth;
+                if (s.history[movedPiece][moveTo(m)] > 50000) {
+                    for (auto& row : s.history) for (int& h : row) h /= 2;
+                }
+            }
+            break;
+        }
+    }
+
+    if (legalMoves == 0) return checked ? -MATE_SCORE + ply : 0;
+
+    // A root searched without some of its moves has no score of its own to store
+    if (ply > 0 || s.excludedCount == 0) {
+        int bound = bestScore >= beta ? BOUND_LOWER : (alpha > originalAlpha ? BOUND_EXACT : BOUND_UPPER);
+        ttStore(s.tt, pos.key, bestMove, scoreToTT(bestScore, ply), depth, bound);
+    }
+    return bestScore;
+}
+
+// ========== ITERATIVE DEEPENING ==========
+
+SearchResult searchPosition(Search& s, Position& pos, const SearchLimits& limits,
+    const vector<uint64_t>& gameKeys) {
+    s.limits = limits;
+    s.startTime = chrono::steady_clock::now();
+    s.hardDeadline = s.startTime + chrono::milliseconds(limits.hardMs);
+    s.nodes = 0;
+    // Room for the whole search path, so pushing keys never reallocates
+    if (s.keys.capacity() < gameKeys.size() + MAX_PLY + 1) s.keys.reserve(gameKeys.size() + MAX_PLY + 512);
+    s.keys.assign(gameKeys.begin(), gameKeys.end());
+    s.keys.push_back(pos.key);
+    memset(s.killers, 0, sizeof(s.killers));
+
+    SearchResult result;
+    Move legal[MOVE_LIST_SIZE];
+    int legalCount = generateLegalMoves(pos, legal);
+    if (legalCount == 0) return result;
+    result.bestMove = legal[0];
+    int bestMoveChanges = 0, stableIterations = 0;
+    uint64_t allocationsBefore = threadHeapAllocations(), callbackAllocations = 0;
+
+    int lineCount = max(1, min(limits.multiPv, min(MAX_MULTI_PV, legalCount)));
+
+    for (int depth = 1; depth <= limits.depth; depth++) {
+        // Each line is a root search without the first moves of the lines before it
+        int linesFound = 0;
+        for (int line = 0; line < lineCount; line++) {
+            s.excludedCount = line;
+            int score;
+            {
+                INSTRUMENT_PHASE(PHASE_SEARCH_ITERATION);
+                score = alphaBeta(s, pos, depth, -INFINITE_SCORE, INFINITE_SCORE, 0, false);
+            }
+            if (s.stop || s.pvLength[0] == 0) break;
+
+            RootLine& found = result.lines[line];
+            found.score = score;
+            found.depth = depth;
+            found.pv.length = s.pvLength[0];
+            memcpy(found.pv.moves, s.pvTable[0], sizeof(Move) * size_t(s.pvLength[0]));
+            s.excludedRootMoves[line] = found.pv[0];
+            linesFound++;
+
+            if (s.onInfo) {
+                uint64_t before = threadHeapAllocations();
+                SearchInfo info{ depth, score, s.nodes, elapsedMs(s), found.pv, line + 1 };
+                s.onInfo(info);
+                callbackAllocations += threadHeapAllocations() - before;
+            }
+        }
+        s.excludedCount = 0;
+        if (linesFound == 0) break;
+        result.lineCount = max(result.lineCount, linesFound);
+
+        Move previousBest = result.bestMove;
+        int score = result.lines[0].score;
+        result.score = score;
+        result.depth = depth;
+        result.pv = result.lines[0].pv;
+        result.bestMove = result.pv[0];
+        if (linesFound < lineCount) break;
+
+        // Recent best-move changes count for more than old ones
+        bestMoveChanges /= 2;
+        if (depth > 1 && result.bestMove != previousBest) {
+            bestMoveChanges += 2;
+            stableIterations = 0;
+        }
+        else {
+            stableIterations++;
+        }
+
+        // No point searching deeper once a forced mate has been found
+        if (isMateScore(score) && MATE_SCORE - abs(score) <= depth) break;
+        if (!s.pondering && limits.softMs > 0) {
+            int64_t elapsed = elapsedMs(s);
+            // After a ponder hit the budget may already be used up
+            if (elapsed >= limits.hardMs) break;
+            if (limits.softMs < limits.hardMs) {
+                // With a single legal move there is nothing to think about
+                if (legalCount == 1) break;
+                // Don't start an iteration that is unlikely to finish within the scaled soft limit
+                double soft = limits.softMs * softLimitScale(bestMoveChanges, stableIterations);
+                if (elapsed >= min(soft, double(limits.hardMs)) * 0.6) break;
+            }
+        }
+    }
+
+    // A finished ponder search must not answer before the opponent has moved
+    while (s.pondering && !s.stop) this_thread::sleep_for(chrono::milliseconds(1));
+    result.nodes = s.nodes;
+    result.allocations = threadHeapAllocations() - allocationsBefore - callbackAllocations;
+
+    if (result.pv.size() > 1) {
+        result.ponderMove = result.pv[1];
+    }
+    else {
+        // Fall back to the hash move of the expected reply
+        UndoInfo undo;
+        makeMove(pos, result.bestMove, undo);
+        const TTEntry* entry = ttProbe(s.tt, pos.key);
+        if (entry && entry->move != NO_MOVE && isGeneratedLegal(pos, entry->move)) result.ponderMove = entry->move;
+        unmakeMove(pos, result.bestMove, undo);
+    }
+    return result;
+}
@@ -0,0 +1,167 @@
+#pragma once
+// Alpha-beta search: iterative deepening, principal variation search,
+// quiescence, transposition table and simple move ordering (hash move,
+// MVV-LVA, killers, history), with a switchable selectivity layer on top.
+// Multi-PV finds the best few root moves per iteration in the same tree.
+
+#include "arena.h"
+#include "position.h"
+#include "timeman.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+const int MAX_PLY = 128;
+const int MATE_SCORE = 32000;
+const int INFINITE_SCORE = 32001;
+
+inline bool isMateScore(int score) { return score >= MATE_SCORE - MAX_PLY || score <= -MATE_SCORE + MAX_PLY; }
+
+// ========== TRANSPOSITION TABLE ==========
+
+const int BOUND_EXACT = 0, BOUND_LOWER = 1, BOUND_UPPER = 2;
+
+struct TTEntry {
+    uint64_t key;
+    int16_t score;
+    Move move;
+    int8_t depth;
+    uint8_t bound;
+};
+
+struct TranspositionTable {
+    std::vector<TTEntry> entries;
+    uint64_t mask = 0;
+};
+
+void ttResize(TranspositionTable& tt, size_t megabytes);
+void ttClear(TranspositionTable& tt);
+const TTEntry* ttProbe(const TranspositionTable& tt, uint64_t key);
+void ttStore(TranspositionTable& tt, uint64_t key, Move move, int score, int depth, int bound);
+
+// ========== SEARCH ==========
+
+// Most lines a multi-PV search reports
+const int MAX_MULTI_PV = 8;
+
+struct SearchLimits {
+    int depth = MAX_PLY - 1;
+    uint64_t nodes = 0;        // 0 = no node limit
+    int64_t softMs = 0;        // 0 = no time limit
+    int64_t hardMs = 0;        // soft == hard means a fixed move time
+    int multiPv = 1;           // best lines to find, up to MAX_MULTI_PV
+};
+
+// Limits for a fixed time per move
+inline SearchLimits moveTimeLimits(int64_t ms) {
+    SearchLimits limits;
+    limits.softMs = limits.hardMs = ms;
+    return limits;
+}
+
+// Selectivity layer. Everything on is the normal search; everything off is
+// the full-width search the pruning is measured against (tools/search_compare).
+struct SearchFeatures {
+    bool nullMove = true;            // null-move pruning, not with only king and pawns
+    bool lateMoveReductions = true;  // late quiet moves searched shallower, by ordering score
+    bool futility = true;            // futility pruning and razoring in the last plies
+    bool checkExtensions = true;     // positions in check searched one ply deeper
+};
+
+inline SearchFeatures fullWidthFeatures() {
+    SearchFeatures features;
+    features.nullMove = features.lateMoveReductions = features.futility = features.checkExtensions = false;
+    return features;
+}
+
+// The clock is only read every TIME_CHECK_NODES nodes
+const uint64_t TIME_CHECK_NODES = 2048;
+
+// Principal variation stored inline, so reporting one does not allocate
+struct PvLine {
+    Move moves[MAX_PLY];
+    int length = 0;
+
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + length; }
+    int size() const { return length; }
+    bool empty() const { return length == 0; }
+    Move operator[](int i) const { return moves[i]; }
+};
+
+// Reported for every line as soon as an iteration has found it
+struct SearchInfo {
+    int depth;
+    int score;
+    uint64_t nodes;
+    int64_t timeMs;
+    PvLine pv;
+    int line = 1;              // 1 = best line, 2 = second best, ...
+};
+
+// One of the best lines of a multi-PV search
+struct RootLine {
+    int score = 0;
+    int depth = 0;             // of the iteration that found it
+    PvLine pv;
+};
+
+struct SearchResult {
+    Move bestMove = NO_MOVE;
+    Move ponderMove = NO_MOVE;
+    int score = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    PvLine pv;
+    uint64_t allocations = 0;  // heap allocations made by the search itself (not onInfo)
+    // Multi-PV: lines[0] is the line above; the others come from the last
+    // iteration that finished them, which may be shallower (see RootLine::depth)
+    int lineCount = 0;
+    RootLine lines[MAX_MULTI_PV];
+};
+
+// Each ply takes one move list and its scores from the search stack arena
+const size_t SEARCH_FRAME_BYTES = MOVE_LIST_SIZE * (sizeof(Move) + sizeof(int)) + 16;
+
+struct Search {
+    TranspositionTable tt;
+    std::atomic<bool> stop{ false };
+    // While pondering the search ignores its time and node limits. Clearing
+    // the flag (a ponder hit) turns it into a normal search that keeps all the
+    // work done so far and is charged for the time already spent.
+    std::atomic<bool> pondering{ false };
+    std::function<void(const SearchInfo&)> onInfo;
+    SearchFeatures features;
+
+    // Scratch memory for the move lists of every ply, allocated by initSearch
+    Arena stack;
+
+    // Per-search state
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point hardDeadline;
+    uint64_t nodes = 0;
+    std::vector<uint64_t> keys;          // game history followed by the current search path
+    Move killers[MAX_PLY][2];
+    int history[13][64];
+    Move pvTable[MAX_PLY][MAX_PLY];
+    int pvLength[MAX_PLY];
+    // Multi-PV: root moves that start the better lines of this iteration, which
+    // the search for the next line skips. All lines share the tree and the table.
+    Move excludedRootMoves[MAX_MULTI_PV];
+    int excludedCount = 0;
+};
+
+void initSearch(Search& s, size_t hashMegabytes);
+void newGame(Search& s);
+
+// Searches pos within the given limits. gameKeys holds the hash keys of the
+// positions played before pos, for repetition detection. The caller clears
+// s.stop before starting; setting it from another thread ends the search.
+SearchResult searchPosition(Search& s, Position& pos, const SearchLimits& limits,
+    const std::vector<uint64_t>& gameKeys);
+
+int64_t elapsedMs(const Search& s);
@@ -0,0 +1,289 @@
+#include "server.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+// ========== GAME SLOTS ==========
+
+static uint64_t makeGameId(int shard, uint32_t slot, uint32_t generation) {
+    return uint64_t(shard) | (uint64_t(slot) << 8) | (uint64_t(generation) << 32);
+}
+
+static ServerGame* findGame(ServerShard& shard, uint64_t id) {
+    uint32_t slot = gameSlot(id);
+    if (slot >= shard.games.items.size()) return nullptr;
+    ServerGame& game = shard.games.items[slot];
+    if (!game.active || game.generation != gameGeneration(id)) return nullptr;
+    return &game;
+}
+
+// Parsed once; copying it lets new games start without touching the FEN parser
+static const Position& startPosition() {
+    static const Position pos = [] {
+        Position p;
+        setStartPosition(p);
+        return p;
+    }();
+    return pos;
+}
+
+static void pushKey(ServerGame& game, uint64_t key) {
+    game.keys[game.keyCount % GAME_KEY_HISTORY] = key;
+    game.keyCount++;
+}
+
+// Threefold repetition over the positions since the last irreversible move
+static bool isThreefold(const ServerGame& game) {
+    int span = min(game.pos.halfmoveClock, min(game.keyCount - 1, GAME_KEY_HISTORY - 1));
+    int seen = 1;
+    for (int back = 2; back <= span; back += 2) {
+        if (game.keys[(game.keyCount - 1 - back) % GAME_KEY_HISTORY] == game.pos.key && ++seen == 3) return true;
+    }
+    return false;
+}
+
+static int gameResult(ServerGame& game) {
+    GameEnd end = gameEnd(game.pos);
+    if (end == GAME_END_STALEMATE) return GAME_DRAWN;
+    if (end == GAME_END_CHECKMATE) return game.pos.whiteToMove ? GAME_BLACK_WINS : GAME_WHITE_WINS;
+    if (game.pos.halfmoveClock >= 100 || isThreefold(game)) return GAME_DRAWN;
+    return GAME_ONGOING;
+}
+
+// ========== SHARD WORKER ==========
+
+static void handleRequest(ServerShard& shard, int shardIndex, const ServerRequest& request) {
+    ServerReply& reply = *request.reply;
+    reply.status = STATUS_OK;
+    reply.gameId = request.gameId;
+
+    if (request.type == REQ_NEW_GAME) {
+        int64_t slot = poolAcquire(shard.games);
+        if (slot < 0) {
+            reply.status = STATUS_FULL;
+            return;
+        }
+        ServerGame& game = shard.games.items[size_t(slot)];
+        game.pos = startPosition();
+        game.keyCount = 0;
+        pushKey(game, game.pos.key);
+        game.plies = 0;
+        game.result = GAME_ONGOING;
+        game.active = true;
+        shard.activeGames++;
+        reply.gameId = makeGameId(shardIndex, uint32_t(slot), game.generation);
+        reply.result = GAME_ONGOING;
+        return;
+    }
+
+    ServerGame* game = findGame(shard, request.gameId);
+    if (!game) {
+        reply.status = STATUS_NO_GAME;
+        return;
+    }
+    reply.result = game->result;
+
+    if (request.type == REQ_MOVE) {
+        if (game->result != GAME_ONGOING) {
+            reply.status = STATUS_GAME_OVER;
+            return;
+        }
+        shard.movesValidated.fetch_add(1, memory_order_relaxed);
+        Move m = parseUciMove(game->pos, request.move);
+        if (m == NO_MOVE) {
+            reply.status = STATUS_ILLEGAL;
+            return;
+        }
+        UndoInfo undo;
+        makeMove(game->pos, m, undo);
+        pushKey(*game, game->pos.key);
+        game->plies++;
+        game->result = reply.result = gameResult(*game);
+    }
+    else if (request.type == REQ_STATE) {
+        writeFen(game->pos, reply.fen, sizeof(reply.fen));
+    }
+    else if (request.type == REQ_CLOSE) {
+        game->active = false;
+        game->generation++;
+        poolRelease(shard.games, uint32_t(game - shard.games.items.data()));
+        shard.activeGames--;
+    }
+}
+
+static void shardWorker(ServerShard& shard, int shardIndex) {
+    vector<ServerRequest> batch;
+    batch.reserve(shard.pending.capacity());
+    for (;;) {
+        {
+            unique_lock<mutex> lock(shard.mutex);
+            shard.wake.wait(lock, [&] { return shard.stopping || !shard.pending.empty(); });
+            if (shard.pending.empty()) return;
+            // Take everything queued so far; both vectors keep their capacity
+            swap(batch, shard.pending);
+        }
+        uint64_t allocationsBefore = threadHeapAllocations();
+        for (const ServerRequest& request : batch) {
+            handleRequest(shard, shardIndex, request);
+            ServerReply& reply = *request.reply;
+            {
+                lock_guard<mutex> lock(reply.mutex);
+                reply.done = true;
+            }
+            reply.ready.notify_one();
+        }
+        shard.allocations.fetch_add(threadHeapAllocations() - allocationsBefore, memory_order_relaxed);
+        batch.clear();
+    }
+}
+
+// ========== SERVER ==========
+
+void startServer(GameServer& server, int shardCount, int gamesPerShard) {
+    shardCount = max(1, min(shardCount, 256));
+    gamesPerShard = max(1, min(gamesPerShard, 0xFFFFFF));
+    for (int i = 0; i < shardCount; i++) {
+        server.shards.push_back(make_unique<ServerShard>());
+        ServerShard& shard = *server.shards.back();
+        // All game memory is allocated up front
+        poolInit(shard.games, size_t(gamesPerShard));
+        shard.pending.reserve(1024);
+        shard.worker = thread(shardWorker, ref(shard), i);
+    }
+}
+
+void stopServer(GameServer& server) {
+    for (auto& shard : server.shards) {
+        {
+            lock_guard<mutex> lock(shard->mutex);
+            shard->stopping = true;
+        }
+        shard->wake.notify_one();
+    }
+    for (auto& shard : server.shards) shard->worker.join();
+    server.shards.clear();
+}
+
+void submitRequest(GameServer& server, const ServerRequest& request) {
+    // New games are spread round-robin, everything else goes to the game's shard
+    uint32_t index = request.type == REQ_NEW_GAME ?
+        server.nextShard.fetch_add(1, memory_order_relaxed) % uint32_t(server.shards.size()) :
+        uint32_t(gameShard(request.gameId));
+    request.reply->done = false;
+    if (index >= server.shards.size()) {
+        request.reply->status = STATUS_NO_GAME;
+        request.reply->done = true;
+        return;
+    }
+    ServerShard& shard = *server.shards[index];
+    {
+        lock_guard<mutex> lock(shard.mutex);
+        shard.pending.push_back(request);
+    }
+    shard.wake.notify_one();
+}
+
+void waitForReply(ServerReply& reply) {
+    unique_lock<mutex> lock(reply.mutex);
+    reply.ready.wait(lock, [&] { return reply.done; });
+}
+
+static int call(GameServer& server, int type, uint64_t gameId, const char* uci, ServerReply& reply) {
+    ServerRequest request{ type, gameId, "", &reply };
+    if (uci) {
+        strncpy(request.move, uci, sizeof(request.move) - 1);
+        request.move[sizeof(request.move) - 1] = '\0';
+    }
+    submitRequest(server, request);
+    waitForReply(reply);
+    return reply.status;
+}
+
+int serverNewGame(GameServer& server, ServerReply& reply) {
+    return call(server, REQ_NEW_GAME, 0, nullptr, reply);
+}
+
+int serverMove(GameServer& server, uint64_t gameId, const char* uci, ServerReply& reply) {
+    // Longer strings can never be moves; don't let truncation turn them into one
+    if (strlen(uci) >= sizeof(ServerRequest::move)) {
+        reply.status = STATUS_ILLEGAL;
+        return reply.status;
+    }
+    return call(server, REQ_MOVE, gameId, uci, reply);
+}
+
+int serverState(GameServer& server, uint64_t gameId, ServerReply& reply) {
+    return call(server, REQ_STATE, gameId, nullptr, reply);
+}
+
+int serverClose(GameServer& server, uint64_t gameId, ServerReply& reply) {
+    return call(server, REQ_CLOSE, gameId, nullptr, reply);
+}
+
+uint64_t movesValidated(const GameServer& server) {
+    uint64_t total = 0;
+    for (const auto& shard : server.shards) total += shard->movesValidated.load(memory_order_relaxed);
+    return total;
+}
+
+int activeGames(const GameServer& server) {
+    int total = 0;
+    for (const auto& shard : server.shards) total += shard->activeGames.load(memory_order_relaxed);
+    return total;
+}
+
+uint64_t serverAllocations(const GameServer& server) {
+    uint64_t total = 0;
+    for (const auto& shard : server.shards) total += shard->allocations.load(memory_order_relaxed);
+    return total;
+}
+
+const char* resultString(int result) {
+    switch (result) {
+    case GAME_WHITE_WINS: return "1-0";
+    case GAME_BLACK_WINS: return "0-1";
+    case GAME_DRAWN: return "1/2-1/2";
+    default: return "*";
+    }
+}
+
+// ========== TEXT PROTOCOL ==========
+
+static string statusError(int status) {
+    switch (status) {
+    case STATUS_ILLEGAL: return "illegal";
+    case STATUS_NO_GAME: return "error no-game";
+    case STATUS_FULL: return "error full";
+    case STATUS_GAME_OVER: return "error game-over";
+    default: return "error";
+    }
+}
+
+string handleServerLine(GameServer& server, const string& line, ServerReply& reply) {
+    istringstream in(line);
+    string command, move;
+    uint64_t id = 0;
+    in >> command;
+
+    if (command == "new") {
+        if (serverNewGame(server, reply) != STATUS_OK) return statusError(reply.status);
+        return "ok " + to_string(reply.gameId);
+    }
+    if (!(in >> id)) return "error syntax";
+    if (command == "move") {
+        if (!(in >> move)) return "error syntax";
+        if (serverMove(server, id, move.c_str(), reply) != STATUS_OK) return statusError(reply.status);
+        return string("ok ") + resultString(reply.result);
+    }
+    if (command == "fen") {
+        if (serverState(server, id, reply) != STATUS_OK) return statusError(reply.status);
+        return string("ok ") + resultString(reply.result) + " " + reply.fen;
+    }
+    if (command == "close") {
+        if (serverClose(server, id, reply) != STATUS_OK) return statusError(reply.status);
+        return "ok";
+    }
+    return "error unknown-command";
+}
@@ -0,0 +1,107 @@
+#pragma once
+// Headless game server: hosts many independent games in one process.
+// Games live in fixed-size slots preallocated per shard, so memory per game is
+// bounded and no allocation happens while games are played. Each shard is
+// owned by one worker thread that applies requests in batches; callers submit
+// requests and wait on a reply they own.
+//
+// Text protocol (one request per line, see handleServerLine):
+//   new                 -> ok <game-id>
+//   move <game-id> <uci> -> ok <result> | illegal
+//   fen <game-id>        -> ok <result> <fen>
+//   close <game-id>      -> ok
+// Errors are reported as "error <reason>". <result> is *, 1-0, 0-1 or 1/2-1/2.
+
+#include "arena.h"
+#include "position.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Positions since the last capture or pawn move are all a repetition check
+// needs, and the fifty-move rule ends the game before more accumulate
+const int GAME_KEY_HISTORY = 128;
+
+const int GAME_ONGOING = 0, GAME_WHITE_WINS = 1, GAME_BLACK_WINS = 2, GAME_DRAWN = 3;
+
+struct ServerGame {
+    Position pos;
+    uint64_t keys[GAME_KEY_HISTORY];    // ring buffer of position keys
+    int keyCount;
+    int plies;
+    int result;
+    uint32_t generation;                // bumped on close so stale ids are rejected
+    bool active;
+};
+
+const int REQ_NEW_GAME = 0, REQ_MOVE = 1, REQ_STATE = 2, REQ_CLOSE = 3;
+const int STATUS_OK = 0, STATUS_ILLEGAL = 1, STATUS_NO_GAME = 2, STATUS_FULL = 3, STATUS_GAME_OVER = 4;
+
+// Filled in by the shard worker. A client reuses one reply for all its requests.
+struct ServerReply {
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool done = false;
+    int status = STATUS_OK;
+    uint64_t gameId = 0;
+    int result = GAME_ONGOING;
+    char fen[96] = "";
+};
+
+struct ServerRequest {
+    int type;
+    uint64_t gameId;
+    char move[6];
+    ServerReply* reply;
+};
+
+struct ServerShard {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<ServerRequest> pending;     // swapped with the worker's batch
+    bool stopping = false;
+
+    // Owned by the worker thread
+    Pool<ServerGame> games;
+    std::thread worker;
+    std::atomic<uint64_t> movesValidated{ 0 };
+    std::atomic<int> activeGames{ 0 };
+    std::atomic<uint64_t> allocations{ 0 };   // heap allocations made by the worker
+};
+
+struct GameServer {
+    std::vector<std::unique_ptr<ServerShard>> shards;
+    std::atomic<uint32_t> nextShard{ 0 };
+};
+
+// Game ids carry the shard, the slot and the slot's generation
+inline int gameShard(uint64_t id) { return int(id & 0xFF); }
+inline uint32_t gameSlot(uint64_t id) { return uint32_t(id >> 8) & 0xFFFFFF; }
+inline uint32_t gameGeneration(uint64_t id) { return uint32_t(id >> 32); }
+
+void startServer(GameServer& server, int shardCount, int gamesPerShard);
+void stopServer(GameServer& server);
+
+// Queues a request; the shard worker fills request.reply and signals it
+void submitRequest(GameServer& server, const ServerRequest& request);
+void waitForReply(ServerReply& reply);
+
+// Convenience wrappers that submit a request and wait for the answer
+int serverNewGame(GameServer& server, ServerReply& reply);
+int serverMove(GameServer& server, uint64_t gameId, const char* uci, ServerReply& reply);
+int serverState(GameServer& server, uint64_t gameId, ServerReply& reply);
+int serverClose(GameServer& server, uint64_t gameId, ServerReply& reply);
+
+// Executes one protocol line and returns the response line
+std::string handleServerLine(GameServer& server, const std::string& line, ServerReply& reply);
+
+const char* resultString(int result);
+uint64_t movesValidated(const GameServer& server);
+int activeGames(const GameServer& server);
+uint64_t serverAllocations(const GameServer& server);
@@ -0,0 +1,112 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static bool takeOwn(WorkRange& range, size_t& index) {
+    lock_guard<mutex> guard(range.lock);
+    if (range.next >= range.end) return false;
+    index = range.next++;
+    return true;
+}
+
+// Moves the back half of the largest other range into ours
+static bool steal(ThreadPool& pool, int worker) {
+    int workers = poolWorkers(pool);
+    int victim = -1;
+    size_t largest = 0;
+    for (int i = 0; i < workers; i++) {
+        if (i == worker) continue;
+        WorkRange& range = *pool.ranges[i];
+        lock_guard<mutex> guard(range.lock);
+        size_t left = range.end > range.next ? range.end - range.next : 0;
+        if (left > largest) { largest = left; victim = i; }
+    }
+    if (victim < 0) return false;
+
+    size_t begin, end;
+    {
+        WorkRange& range = *pool.ranges[victim];
+        lock_guard<mutex> guard(range.lock);
+        if (range.next >= range.end) return true;   // emptied meanwhile; look again
+        size_t mid = range.next + (range.end - range.next) / 2;
+        begin = mid;
+        end = range.end;
+        range.end = mid;
+    }
+    WorkRange& own = *pool.ranges[worker];
+    lock_guard<mutex> guard(own.lock);
+    own.next = begin;
+    own.end = end;
+    lock_guard<mutex> poolGuard(pool.lock);
+    pool.steals++;
+    return true;
+}
+
+static void work(ThreadPool& pool, const TaskBody& body, int worker) {
+    for (;;) {
+        size_t index;
+        if (takeOwn(*pool.ranges[worker], index)) {
+            body(index, worker);
+            continue;
+        }
+        if (!steal(pool, worker)) return;
+    }
+}
+
+static void workerLoop(ThreadPool& pool, int worker) {
+    uint64_t seen = 0;
+    for (;;) {
+        const TaskBody* body;
+        {
+            unique_lock<mutex> guard(pool.lock);
+            pool.wake.wait(guard, [&] { return pool.stopping || pool.generation != seen; });
+            if (pool.stopping) return;
+            seen = pool.generation;
+            body = pool.body;
+        }
+        work(pool, *body, worker);
+        lock_guard<mutex> guard(pool.lock);
+        if (--pool.running == 0) pool.finished.notify_one();
+    }
+}
+
+void startThreadPool(ThreadPool& pool, int threads) {
+    if (threads <= 0) threads = max(1, int(thread::hardware_concurrency()));
+    pool.stopping = false;
+    pool.ranges.clear();
+    for (int i = 0; i < threads; i++) pool.ranges.push_back(make_unique<WorkRange>());
+    for (int i = 1; i < threads; i++) pool.threads.emplace_back(workerLoop, ref(pool), i);
+}
+
+void stopThreadPool(ThreadPool& pool) {
+    {
+        lock_guard<mutex> guard(pool.lock);
+        pool.stopping = true;
+    }
+    pool.wake.notify_all();
+    for (thread& t : pool.threads) t.join();
+    pool.threads.clear();
+}
+
+void parallelFor(ThreadPool& pool, size_t count, const TaskBody& body) {
+    int workers = poolWorkers(pool);
+    for (int i = 0; i < workers; i++) {
+        WorkRange& range = *pool.ranges[i];
+        lock_guard<mutex> guard(range.lock);
+        range.next = count * i / workers;
+        range.end = count * (i + 1) / workers;
+    }
+    {
+        lock_guard<mutex> guard(pool.lock);
+        pool.body = &body;
+        pool.running = workers - 1;
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    work(pool, body, 0);
+    unique_lock<mutex> guard(pool.lock);
+    pool.finished.wait(guard, [&] { return pool.running == 0; });
+    pool.body = nullptr;
+}
@@ -0,0 +1,46 @@
+#pragma once
+// Work-stealing thread pool for batch jobs (parallel perft, batch tools).
+// parallelFor hands every worker an equal slice of the index range; a worker
+// takes indices from the front of its own slice and, when that runs dry,
+// steals the back half of the fullest other slice. The calling thread works
+// as worker 0, so a pool of one thread runs everything inline.
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The part of the index range a worker still owns
+struct WorkRange {
+    std::mutex lock;
+    size_t next = 0;
+    size_t end = 0;
+};
+
+typedef std::function<void(size_t index, int worker)> TaskBody;
+
+struct ThreadPool {
+    std::vector<std::thread> threads;      // workers 1..n-1
+    std::vector<std::unique_ptr<WorkRange>> ranges;
+    std::mutex lock;
+    std::condition_variable wake, finished;
+    const TaskBody* body = nullptr;
+    uint64_t generation = 0;               // bumped for each parallelFor
+    int running = 0;                       // background workers still on the current job
+    bool stopping = false;
+    uint64_t steals = 0;                   // successful steals, for diagnostics
+};
+
+// threads <= 0 uses every hardware thread
+void startThreadPool(ThreadPool& pool, int threads);
+void stopThreadPool(ThreadPool& pool);
+
+inline int poolWorkers(const ThreadPool& pool) { return int(pool.ranges.size()); }
+
+// Runs body(i, worker) for every i in [0, count) and returns when all are done.
+// Calls must not be nested or made from several threads at once.
+void parallelFor(ThreadPool& pool, size_t count, const TaskBody& body);
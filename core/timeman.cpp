@@ -0,0 +1,29 @@
+#include "timeman.h"
+
+#include <algorithm>
+
+using namespace std;
+
+TimeBudget allocateTime(const ClockState& clock) {
+    int64_t available = max<int64_t>(1, clock.timeLeftMs - MOVE_OVERHEAD_MS);
+
+    // Plan for the moves left to the time control, or a fixed horizon in sudden death
+    int horizon = clock.movesToGo > 0 ? min(clock.movesToGo, 40) : 30;
+    int64_t soft = available / horizon + clock.incrementMs * 3 / 4;
+
+    // Never risk more than a fraction of the clock on one move, except on the
+    // last move before the time control
+    int64_t hard = clock.movesToGo == 1 ? available * 9 / 10 : min(available * 2 / 5, soft * 5);
+
+    TimeBudget budget;
+    budget.hardMs = max<int64_t>(1, hard);
+    budget.softMs = max<int64_t>(1, min(soft, budget.hardMs));
+    return budget;
+}
+
+double softLimitScale(int bestMoveChanges, int stableIterations) {
+    double scale = 1.0 + 0.4 * min(bestMoveChanges, 4);
+    if (bestMoveChanges == 0 && stableIterations >= 6) scale = 0.5;
+    else if (bestMoveChanges == 0 && stableIterations >= 4) scale = 0.7;
+    return scale;
+}
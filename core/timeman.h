@@ -0,0 +1,28 @@
+#pragma once
+// Time management: turns the state of a chess clock into per-move budgets.
+// The soft limit is the time the search aims for and is scaled while
+// searching (longer when the best move keeps changing, shorter when it is
+// stable); the hard limit is never exceeded.
+
+#include <cstdint>
+
+struct ClockState {
+    int64_t timeLeftMs = 0;
+    int64_t incrementMs = 0;
+    int movesToGo = 0;          // 0 = sudden death
+};
+
+struct TimeBudget {
+    int64_t softMs;
+    int64_t hardMs;
+};
+
+// Time kept back for GUI and operating system latency
+const int64_t MOVE_OVERHEAD_MS = 30;
+
+TimeBudget allocateTime(const ClockState& clock);
+
+// Factor applied to the soft limit after an iteration. bestMoveChanges is the
+// number of times the root best move changed in recent iterations and
+// stableIterations the number of iterations it has stayed the same.
+double softLimitScale(int bestMoveChanges, int stableIterations);
@@ -1,7 +1,21 @@
 ﻿#include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
+#include <fstream>
 #include <iostream>  
 #include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <cstring>
+#include "core/book.h"
+#include "core/gameindex.h"
+#include "core/geometry.h"
+#include "core/history.h"
+#include "core/instrument.h"
+#include "core/log.h"
+#include "core/search.h"
 
 using namespace std;
 using namespace sf;
@@ -15,7 +29,12 @@ bool gameOver = false;
 bool gameStarted = false;
 string gameResult = "";
 
-const float VIRTUAL_WIDTH = BOARD_PIXELS + (LABEL_MARGIN * 2.0f);
+// Side panel right of the board with the move history and the analysis lines
+const float PANEL_LEFT = BOARD_PIXELS + (LABEL_MARGIN * 2.0f);
+const float PANEL_WIDTH = 320.0f;
+const float PANEL_TOP = 100.0f;
+
+const float VIRTUAL_WIDTH = PANEL_LEFT + PANEL_WIDTH;
 const float VIRTUAL_HEIGHT = BOARD_PIXELS + (LABEL_MARGIN * 2.0f);
 const float squareSize = BOARD_PIXELS / boardSize;
 
@@ -27,10 +46,6 @@ const Color moveDotColor(100, 255, 100, 180);
 const Color captureColor(255, 100, 100);
 
 
-// Integer constants for Piece Types
-const int NONE = 0, W_KING = 1, W_QUEEN = 2, W_BISHOP = 3, W_KNIGHT = 4, W_ROOK = 5;
-const int W_PAWN = 6, B_KING = 7, B_QUEEN = 8, B_BISHOP = 9, B_KNIGHT = 10, B_ROOK = 11, B_PAWN = 12;
-
 // Globals for selection/highlighting
 int selectedRow = -1;
 int selectedCol = -1;
@@ -58,15 +73,26 @@ bool whiteInCheck = false, blackInCheck = false;
 int whiteKingRow = 7, whiteKingCol = 4;
 int blackKingRow = 0, blackKingCol = 4;
 
-// Parallel arrays to store move history
-const int MAX_MOVES = 1000;  // Maximum moves in a game
-int moveHistory_fromRow[MAX_MOVES];
-int moveHistory_fromCol[MAX_MOVES];
-int moveHistory_toRow[MAX_MOVES];
-int moveHistory_toCol[MAX_MOVES];
-int moveHistory_pieceMoved[MAX_MOVES];
-int moveHistory_pieceCaptured[MAX_MOVES];
-int moveHistoryCount = 0;  // Current number of moves stored
+// What clicks and game-over checks need to know about the position on screen,
+// worked out once per position by refreshPositionCache() after every move,
+// takeback and restart instead of on every click.
+enum GameStatus { STATUS_PLAYING, STATUS_CHECKMATE, STATUS_STALEMATE };
+
+struct PositionCache {
+    bool forWhite = true;           // side the moves are for
+    Bitboard targets[64] = {};      // legal destinations of that side's piece on each square
+    int moveCount = 0;              // legal moves (a promotion counts once)
+    Bitboard attacked[2] = {};      // squares attacked by White [0] and Black [1]
+    bool inCheck = false;
+    GameStatus status = STATUS_PLAYING;
+};
+PositionCache positionCache;
+
+// Move history (U takes back, Y replays, P saves the game as PGN). gamePos is
+// the core's copy of the position on screen and is kept in step with it.
+GameHistory history;
+Position gamePos;
+const char* PGN_EXPORT_FILE = "game.pgn";
 
 // Sound system
 bool soundsEnabled = true;
@@ -98,42 +124,158 @@ Music backgroundMusic;
 // Global font object
 Font globalFont;
 
+// Tried in order after --font and the CHESS_FONT environment variable
+const char* FONT_CANDIDATES[] = {
+    "fonts/font.ttf",
+    "C:/Windows/Fonts/Arial.ttf",
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/TTF/DejaVuSans.ttf",
+    "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+    "/System/Library/Fonts/Supplemental/Arial.ttf",
+    "/Library/Fonts/Arial.ttf",
+};
+
+// Opening book (optional, loaded from book.bin next to the executable)
+OpeningBook openingBook;
+bool bookHintsEnabled = false;
+
+// Position index over a game archive (optional, games.idx or --games-index
+// FILE, built with tools/game_index). G lists the indexed games that reached
+// the position on the board in the side panel.
+const int INDEXED_GAMES_SHOWN = 5;
+GameIndex gameIndex;
+string gameIndexPath = "games.idx";
+bool indexedGamesEnabled = false;
+
+// Chess clock (T toggles it). [0] is White, [1] is Black.
+const int64_t CLOCK_BASE_MS = 10 * 60 * 1000;
+const int64_t CLOCK_INCREMENT_MS = 5 * 1000;
+bool clockEnabled = true;
+int64_t clockRemainingMs[2] = { CLOCK_BASE_MS, CLOCK_BASE_MS };
+Clock turnClock;    // time used by the side to move in the current turn
+
+// Computer opponent (plays Black when enabled). After each of its moves it
+// ponders on the expected reply while the human is thinking. Without the
+// chess clock it thinks for a fixed time per move.
+const int COMPUTER_MOVE_MS = 1000;
+bool computerEnabled = false;
+Search engine;
+thread engineThread;
+atomic<bool> engineMoveReady(false);
+SearchResult engineResult;
+Move ponderMove = NO_MOVE;       // reply the current ponder search assumes
+int ponderHits = 0, ponderMisses = 0;
+mt19937_64 bookRandom(random_device{}());
+
+// Analysis mode (A toggles it): the engine searches the position on the board
+// without a time limit and the best lines stream into the side panel. The
+// search thread hands each line over under analysisLock.
+const int ANALYSIS_LINES = 3;
+const int ANALYSIS_PV_MOVES = 6;    // moves of each line shown
+bool analysisMode = false;
+mutex analysisLock;
+SearchInfo analysisLines[ANALYSIS_LINES];   // depth 0 = not found yet
+atomic<bool> analysisChanged(false);
+
 // Board representation
 int board[8][8];
 Sprite pieceSprites[8][8];
-Texture pieceTextures[12];
+
+// All twelve piece images live in one atlas texture: six columns (king, queen,
+// bishop, knight, rook, pawn) by two rows (white, black). It is loaded with a
+// single read; on the first start it is packed from the individual images.
+const char* PIECE_ATLAS_FILE = "images/pieces-atlas.png";
+const char* pieceImageNames[12] = {
+    "white-king", "white-queen", "white-bishop", "white-knight", "white-rook", "white-pawn",
+    "black-king", "black-queen", "black-bishop", "black-knight", "black-rook", "black-pawn"
+};
+Texture pieceAtlas;
+IntRect pieceAtlasRects[12];
+
+// Low-power rendering (L toggles it, --low-power turns it on at startup).
+// The squares and labels are rendered once into boardLayer, highlights and
+// pieces are batched into two vertex arrays (pieces from a single atlas
+// texture), the status texts are only updated when something changes, and a
+// frame is only drawn after an event, a move or a visible clock change.
+bool lowPowerRendering = false;
+bool allocationReport = false;  // --alloc-report: print heap allocations made while rendering
+bool instrumentationOverlay = false;    // I shows counters and phase timings, J writes them as JSON
+const char* INSTRUMENTATION_FILE = "instrumentation.json";
+const int INSTRUMENT_REFRESH_MS = 500;
+Clock instrumentRefreshClock;
+bool renderDirty = true;        // game state changed since the last cached frame
+bool boardLayerDirty = true;    // window resized, board layer must be re-rendered
+RenderTexture boardLayer;
+Sprite boardLayerSprite;
+VertexArray overlayVertices(Triangles);
+VertexArray pieceVertices(Triangles);
+Text statusText, controlsText, audioText, clockText, instrumentText, historyText, analysisText, gamesText;
+char clockString[64] = "";
 
 // Function prototypes
 void setupView(RenderWindow& window, View& view);
 void drawBoard(RenderWindow& window);
-void drawCellReferences(RenderWindow& window);
+void drawCellReferences(RenderTarget& target);
 void drawGameStatus(RenderWindow& window);
-void drawMoveHistory(RenderWindow& window);
+void updatePanelTexts();
 void handleMouseClick(const Event& event, const RenderWindow& window);
+void playMove(int sr, int sc, int tr, int tc, int promotionKind);
+bool loadFont(const char* requested);
 bool loadTextures();
+bool packPieceAtlas(Image& atlasImage);
 bool loadSounds();
 void initializeSprites();
+void setPieceSprite(int row, int col, int piece);
 void initializeBoard();
 void promotePawn(int promotionType);
 void updateSpritePosition(int row, int col);
 void playSoundEffect(Sound& sound);
 void generateBeepSound(SoundBuffer& buffer, float frequency, float duration);
 
-// Movement helpers
-bool insideBoard(int r, int c) { return r >= 0 && r < 8 && c >= 0 && c < 8; }
+// Movement helpers (insideBoard, isWhite, isBlack, isEnemyPiece come from core/position.h)
 void clearHighlights() { for (int r = 0; r < 8; ++r) for (int c = 0; c < 8; ++c) highlightMovesArr[r][c] = false; }
-bool isWhite(int p) { return p >= W_KING && p <= W_PAWN; }
-bool isBlack(int p) { return p >= B_KING && p <= B_PAWN; }
-bool isEnemyPiece(int target, int me) {
-    return (isWhite(me) && isBlack(target)) || (isBlack(me) && isWhite(target));
-}
+
+// Bridge to the headless core
+void syncGuiFromPosition();
+void undoMove();
+void redoMove();
+void exportPgn();
+string bookHintText();
+string indexedGamesText();
+
+// Low-power rendering
+void buildBoardLayer(const RenderWindow& window, const View& view);
+void rebuildFrameCache();
+void updateStatusTexts();
+bool updateClockText();
+void drawCachedFrame(RenderWindow& window);
+void reportFrameAllocations(uint64_t allocations);
+bool instrumentationOverlayDue();
+void drawInstrumentationOverlay(RenderWindow& window);
+
+// Chess clock
+int64_t clockTimeLeft(bool white);
+void pressClock();
+int formatClock(int64_t ms, char* buffer, size_t size);
+
+// Computer opponent
+bool isComputerTurn();
+void startEngine(const Position& pos, const vector<uint64_t>& keys, bool ponder);
+void stopEngine();
+void startAnalysis();
+void recordAnalysisLine(const SearchInfo& info);
+void startComputerTurn(Move lastMove);
+void startPondering();
+void applyComputerMove();
 
 // Check detection
 bool isSquareAttacked(int row, int col, bool byWhite);
 bool isInCheck(bool whiteKing);
-void updateKingPosition();
 
 // Move generation with check validation
+void genSliderMoves(int r, int c, int firstDirection, int lastDirection);
+void genStepMoves(int r, int c, Bitboard targets);
 void genRookMoves(int r, int c);
 void genBishopMoves(int r, int c);
 void genKnightMoves(int r, int c);
@@ -143,37 +285,67 @@ void genQueenMoves(int r, int c);
 void generateValidMoves(int r, int c);
 
 // Game state checking
-bool hasValidMoves(bool forWhite);
-bool isCheckmate(bool forWhite);
-bool isStalemate(bool forWhite);
+void refreshPositionCache(bool forWhite);
+bool updateGameOver();
 
 // Move execution
 void movePiece(int sr, int sc, int tr, int tc);
 void performCastling(bool kingside);
+void relocatePiece(int from, int to);
+bool castlingRightKept(int path);
+bool squaresEmpty(Bitboard squares);
+bool squaresAttacked(Bitboard squares, bool byWhite);
+
+int main(int argc, char* argv[]) {
+    const char* fontPath = getenv("CHESS_FONT");
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--font" && i + 1 < argc) fontPath = argv[++i];
+        else if (string(argv[i]) == "--low-power") lowPowerRendering = true;
+        else if (string(argv[i]) == "--alloc-report") allocationReport = true;
+        else if (string(argv[i]) == "--games-index" && i + 1 < argc) gameIndexPath = argv[++i];
+        else if (string(argv[i]) == "--log-level" && i + 1 < argc && !setLogLevel(argv[++i])) {
+            LOG(LOG_WARN, "Unknown log level " << argv[i]);
+        }
+    }
 
-int main() {
     VideoMode desktopMode = VideoMode::getDesktopMode();
     RenderWindow window(desktopMode, "Chess Game By Subhan Ali", Style::Fullscreen);
 
     View view(FloatRect(0.f, 0.f, VIRTUAL_WIDTH, VIRTUAL_HEIGHT));
     setupView(window, view);
 
-    if (!globalFont.loadFromFile("C:/Windows/Fonts/Arial.ttf")) {
-        cerr << "Error loading font file!" << endl;
+    if (!loadFont(fontPath)) {
+        LOG(LOG_ERROR, "Error loading font file! Pass --font or set CHESS_FONT to a .ttf file");
     }
 
+    Clock loadClock;
     if (!loadTextures()) return 1;
+    for (Text* text : { &statusText, &controlsText, &audioText, &clockText, &instrumentText, &historyText, &analysisText, &gamesText }) {
+        text->setFont(globalFont);
+    }
+
+    if (openBook(openingBook, "book.bin")) {
+        LOG(LOG_INFO, "Opening book loaded (" << openingBook.count << " entries)");
+    }
+    if (openGameIndex(gameIndex, gameIndexPath)) {
+        LOG(LOG_INFO, "Game index loaded (" << gameIndex.header->gameCount << " games)");
+    }
 
     // Load sounds
     if (loadSounds()) {
-        cout << "All sounds loaded successfully!" << endl;
+        LOG(LOG_INFO, "All sounds loaded successfully!");
     }
     else {
-        cout << "Some sounds failed to load, using generated sounds instead" << endl;
+        LOG(LOG_INFO, "Some sounds failed to load, using generated sounds instead");
     }
+    LOG(LOG_INFO, "Assets ready in " << loadClock.getElapsedTime().asMilliseconds() << " ms");
 
     initializeBoard();
     initializeSprites();
+    refreshPositionCache(whiteTurn);
+    setStartPosition(gamePos);
+    historyReset(history, gamePos);
+    initSearch(engine, 64);
 
     // Start background music if available
     if (musicEnabled) {
@@ -183,6 +355,7 @@ int main() {
 
     // Play game start sound
     playSoundEffect(gameStartSound);
+    turnClock.restart();
 
     Clock clock;
     gameStarted = true;
@@ -190,22 +363,27 @@ int main() {
     while (window.isOpen()) {
         Event event;
         while (window.pollEvent(event)) {
+            // Pointer motion alone never changes what is drawn
+            if (event.type != Event::MouseMoved) renderDirty = true;
             if (event.type == Event::Closed) window.close();
             else if (event.type == Event::MouseButtonPressed && !gameOver)
                 handleMouseClick(event, window);
-            else if (event.type == Event::Resized) setupView(window, view);
+            else if (event.type == Event::Resized) {
+                setupView(window, view);
+                boardLayerDirty = true;
+            }
             else if (event.type == Event::KeyPressed) {
                 if (event.key.code == Keyboard::Escape) window.close();
                 else if (event.key.code == Keyboard::R && gameOver) {
                     // Restart game
-                    gameOver = false;
+                    stopEngine();
+                    newGame(engine);
                     gameStarted = true;
-                    whiteTurn = true;
-                    gameResult = "";
-                    initializeBoard();
-                    initializeSprites();
-                    moveHistoryCount = 0;
-                    whiteInCheck = blackInCheck = false;
+                    setStartPosition(gamePos);
+                    historyReset(history, gamePos);
+                    syncGuiFromPosition();
+                    clockRemainingMs[0] = clockRemainingMs[1] = CLOCK_BASE_MS;
+                    turnClock.restart();
                     playSoundEffect(gameStartSound);
                 }
                 else if (event.key.code == Keyboard::M) {
@@ -222,15 +400,109 @@ int main() {
                     // Toggle sound effects
                     soundsEnabled = !soundsEnabled;
                 }
+                else if (event.key.code == Keyboard::B) {
+                    // Toggle opening book hints
+                    bookHintsEnabled = !bookHintsEnabled;
+                }
+                else if (event.key.code == Keyboard::G) {
+                    // Toggle the list of indexed games that reached this position
+                    indexedGamesEnabled = !indexedGamesEnabled;
+                }
+                else if (event.key.code == Keyboard::C) {
+                    // Toggle the computer opponent
+                    computerEnabled = !computerEnabled;
+                    analysisMode = false;
+                    stopEngine();
+                    clearHighlights();
+                    selectedRow = selectedCol = -1;
+                    if (isComputerTurn()) startComputerTurn(NO_MOVE);
+                }
+                else if (event.key.code == Keyboard::A) {
+                    // Toggle analysis of the position on the board; it replaces the computer opponent
+                    analysisMode = !analysisMode;
+                    stopEngine();
+                    if (analysisMode) {
+                        computerEnabled = false;
+                        startAnalysis();
+                    }
+                }
+                else if (event.key.code == Keyboard::T) {
+                    // Toggle the chess clock; time spent while it was off is not charged
+                    clockEnabled = !clockEnabled;
+                    turnClock.restart();
+                }
+                else if (event.key.code == Keyboard::U || event.key.code == Keyboard::Left) {
+                    // Take back a move (and the computer's reply)
+                    undoMove();
+                }
+                else if (event.key.code == Keyboard::Y || event.key.code == Keyboard::Right) {
+                    // Replay a taken-back move
+                    redoMove();
+                }
+                else if (event.key.code == Keyboard::P) {
+                    exportPgn();
+                }
+                else if (event.key.code == Keyboard::I) {
+                    instrumentationOverlay = !instrumentationOverlay;
+                    renderDirty = true;
+                }
+                else if (event.key.code == Keyboard::J) {
+                    ofstream out(INSTRUMENTATION_FILE);
+                    writeInstrumentationJson(out);
+                    LOG(LOG_INFO, (out ? "Wrote " : "Could not write ") << INSTRUMENTATION_FILE);
+                }
+                else if (event.key.code == Keyboard::L) {
+                    // Toggle low-power rendering
+                    lowPowerRendering = !lowPowerRendering;
+                }
+            }
+        }
+
+        // Play the computer's move once its search has finished
+        if (engineMoveReady) applyComputerMove();
+        if (analysisChanged.exchange(false)) renderDirty = true;
+
+        // Flag fall
+        if (clockEnabled && !gameOver && clockTimeLeft(whiteTurn) <= 0) {
+            clockRemainingMs[whiteTurn ? 0 : 1] = 0;
+            gameOver = true;
+            gameResult = (whiteTurn ? "Black" : "White") + string(" wins on time!");
+            stopEngine();
+            playSoundEffect(gameEndSound);
+            renderDirty = true;
+        }
+
+        if (lowPowerRendering) {
+            if (boardLayerDirty) {
+                buildBoardLayer(window, view);
+                boardLayerDirty = false;
+                renderDirty = true;
+            }
+            bool clockChanged = updateClockText();
+            if (!renderDirty && !clockChanged && !instrumentationOverlayDue()) {
+                // Nothing visible changed: keep the last frame on screen and sleep
+                sleep(milliseconds(10));
+                continue;
             }
+            INSTRUMENT_PHASE(PHASE_RENDER_FRAME);
+            uint64_t frameAllocations = threadHeapAllocations();
+            if (renderDirty) rebuildFrameCache();
+            renderDirty = false;
+            window.setView(view);
+            drawCachedFrame(window);
+            drawInstrumentationOverlay(window);
+            window.display();
+            reportFrameAllocations(threadHeapAllocations() - frameAllocations);
+            continue;
         }
 
+        INSTRUMENT_PHASE(PHASE_RENDER_FRAME);
+        uint64_t frameAllocations = threadHeapAllocations();
         window.clear(Color::Black);
         window.setView(view);
         drawBoard(window);
         drawCellReferences(window);
         drawGameStatus(window);
-        //drawMoveHistory(window);
 
         // Draw all sprites
         for (int r = 0; r < 8; r++) {
@@ -240,30 +512,52 @@ int main() {
                 }
             }
         }
+        drawInstrumentationOverlay(window);
 
         window.display();
+        renderDirty = false;
+        reportFrameAllocations(threadHeapAllocations() - frameAllocations);
     }
+    stopEngine();
+    closeBook(openingBook);
+    closeGameIndex(gameIndex);
     return 0;
 }
 
+// One period of a sine wave; the oscillator below steps through it with a
+// 32-bit phase accumulator instead of calling sin for every sample
+const int SINE_TABLE_BITS = 12;
+Int16 sineTable[1 << SINE_TABLE_BITS];
+
+void initSineTable() {
+    for (int i = 0; i < (1 << SINE_TABLE_BITS); i++) {
+        sineTable[i] = static_cast<Int16>(32767 * sin(2 * 3.14159265358979 * i / (1 << SINE_TABLE_BITS)));
+    }
+}
+
 void generateBeepSound(SoundBuffer& buffer, float frequency, float duration) {
     // Generate a simple beep sound
     const unsigned sampleRate = 44100;
-    const unsigned sampleCount = static_cast<unsigned>(sampleRate * duration);
-    vector<Int16> samples(sampleCount);
+    const unsigned maxSamples = sampleRate;  // longest effect is well under a second
+    static Int16 samples[maxSamples];
+    const unsigned sampleCount = min(maxSamples, static_cast<unsigned>(sampleRate * duration));
 
+    uint32_t phase = 0;
+    const uint32_t step = static_cast<uint32_t>(frequency / sampleRate * 4294967296.0);
     for (unsigned i = 0; i < sampleCount; ++i) {
-        samples[i] = static_cast<Int16>(32767 * sin(2 * 3.14159 * frequency * i / sampleRate));
+        samples[i] = sineTable[phase >> (32 - SINE_TABLE_BITS)];
+        phase += step;
     }
 
-    buffer.loadFromSamples(&samples[0], sampleCount, 1, sampleRate);
+    buffer.loadFromSamples(samples, sampleCount, 1, sampleRate);
 }
 
 bool loadSounds() {
     bool allLoaded = true;
 
     // Generate sounds programmatically if files don't exist
-    cout << "Generating sound effects..." << endl;
+    LOG(LOG_INFO, "Generating sound effects...");
+    initSineTable();
 
     // Capture sound - sharp beep
     generateBeepSound(captureSoundBuffer, 800, 0.1f);
@@ -305,7 +599,7 @@ bool loadSounds() {
     illegalMoveSound.setBuffer(illegalMoveSoundBuffer);
     illegalMoveSound.setVolume(60);
 
-    cout << "All sound effects generated successfully!" << endl;
+    LOG(LOG_INFO, "All sound effects generated successfully!");
     return true;
 }
 
@@ -315,61 +609,86 @@ void playSoundEffect(Sound& sound) {
     }
 }
 
-void drawMoveHistory(RenderWindow& window) {
-    if (globalFont.getInfo().family == "" || moveHistoryCount == 0) return;
-
-    Text historyText;
-    historyText.setFont(globalFont);
+// The last moves and, when turned on, the engine's best lines and the indexed games
+void updatePanelTexts() {
     historyText.setCharacterSize(16);
     historyText.setFillColor(Color::White);
-    historyText.setPosition(VIRTUAL_WIDTH - 220, 50);
+    historyText.setPosition(PANEL_LEFT, PANEL_TOP);
 
+    const char pieceLetters[] = " KQBNR ";
     string historyStr = "Move History:\n";
-    int startIdx = (moveHistoryCount - 6 > 0) ? moveHistoryCount - 6 : 0; // Show last 6 moves
-
-    for (int i = startIdx; i < moveHistoryCount; i++) {
-        int pieceMoved = moveHistory_pieceMoved[i];
-        string pieceName = "";
-
-        // Determine piece name
-        if (pieceMoved == W_KING || pieceMoved == B_KING) pieceName = "K";
-        else if (pieceMoved == W_QUEEN || pieceMoved == B_QUEEN) pieceName = "Q";
-        else if (pieceMoved == W_ROOK || pieceMoved == B_ROOK) pieceName = "R";
-        else if (pieceMoved == W_BISHOP || pieceMoved == B_BISHOP) pieceName = "B";
-        else if (pieceMoved == W_KNIGHT || pieceMoved == B_KNIGHT) pieceName = "N";
-        else if (pieceMoved == W_PAWN || pieceMoved == B_PAWN) pieceName = "";
-        // No default needed since pieceName already initialized to ""
-
-        char fromFile = 'a' + moveHistory_fromCol[i];
-        int fromRank = 8 - moveHistory_fromRow[i];
-        char toFile = 'a' + moveHistory_toCol[i];
-        int toRank = 8 - moveHistory_toRow[i];
-
-        string moveNotation = pieceName + string(1, fromFile) + to_string(fromRank);
-        if (moveHistory_pieceCaptured[i] != NONE) {
-            moveNotation += "x";
-        }
-        else {
-            moveNotation += "-";
-        }
-        moveNotation += string(1, toFile) + to_string(toRank);
+    size_t startIdx = history.count > 20 ? history.count - 20 : 0; // Show the last 10 moves
+    startIdx -= startIdx % 2;
+
+    for (size_t i = startIdx; i < history.count; i++) {
+        const MoveRecord& record = history.records[i];
+        int from = moveFrom(record.move), to = moveTo(record.move);
+        bool capture = record.captured != NONE || moveFlag(record.move) == MOVE_EN_PASSANT;
+
+        string moveNotation;
+        if (pieceKind(record.piece) != W_PAWN) moveNotation += pieceLetters[pieceKind(record.piece)];
+        moveNotation += squareName(from) + (capture ? "x" : "-") + squareName(to);
 
         // Add move number for white moves
-        if (i % 2 == 0) {
+        if (isWhite(record.piece)) {
             historyStr += to_string(i / 2 + 1) + ". " + moveNotation;
         }
         else {
             historyStr += " " + moveNotation + "\n";
         }
     }
+    historyText.setString(historyStr);
+
+    float y = PANEL_TOP + historyText.getLocalBounds().height + 30;
 
-    // Add newline if last move was white
-    if (moveHistoryCount % 2 == 1) {
-        historyStr += "\n";
+    if (analysisMode) {
+        SearchInfo lines[ANALYSIS_LINES];
+        {
+            lock_guard<mutex> guard(analysisLock);
+            copy(analysisLines, analysisLines + ANALYSIS_LINES, lines);
+        }
+        string analysisStr = "Analysis";
+        if (lines[0].depth > 0) analysisStr += " (depth " + to_string(lines[0].depth) + ")";
+        analysisStr += ":\n";
+        for (int i = 0; i < ANALYSIS_LINES && lines[i].depth > 0; i++) {
+            // Scores from White's point of view
+            int score = gamePos.whiteToMove ? lines[i].score : -lines[i].score;
+            char scoreStr[16];
+            if (isMateScore(score)) {
+                int moves = (MATE_SCORE - abs(score) + 1) / 2;
+                snprintf(scoreStr, sizeof(scoreStr), "%s#%d", score > 0 ? "" : "-", moves);
+            }
+            else {
+                snprintf(scoreStr, sizeof(scoreStr), "%+.2f", score / 100.0);
+            }
+            analysisStr += to_string(i + 1) + ". " + scoreStr;
+
+            // A line that arrived just before the position changed is cut at its first illegal move
+            Position pos = gamePos;
+            for (int j = 0; j < lines[i].pv.length && j < ANALYSIS_PV_MOVES; j++) {
+                Move m = lines[i].pv[j];
+                Move legal[MOVE_LIST_SIZE];
+                int legalCount = generateLegalMoves(pos, legal);
+                if (find(legal, legal + legalCount, m) == legal + legalCount) break;
+                analysisStr += " " + moveToSan(pos, m);
+                UndoInfo undo;
+                makeMove(pos, m, undo);
+            }
+            analysisStr += "\n";
+        }
+        analysisText.setCharacterSize(16);
+        analysisText.setFillColor(Color::Cyan);
+        analysisText.setString(analysisStr);
+        analysisText.setPosition(PANEL_LEFT, y);
+        y += analysisText.getLocalBounds().height + 30;
     }
 
-    historyText.setString(historyStr);
-    window.draw(historyText);
+    if (indexedGamesEnabled) {
+        gamesText.setCharacterSize(16);
+        gamesText.setFillColor(Color::Yellow);
+        gamesText.setString(indexedGamesText());
+        gamesText.setPosition(PANEL_LEFT, y);
+    }
 }
 
 void setupView(RenderWindow& window, View& view) {
@@ -386,29 +705,42 @@ void setupView(RenderWindow& window, View& view) {
 }
 
 void drawBoard(RenderWindow& window) {
-    RectangleShape square(Vector2f(squareSize, squareSize));
-    RectangleShape captureBox(Vector2f(squareSize - 6, squareSize - 6));
+    // Shapes keep their vertices between frames, so they are built only once
+    static RectangleShape square(Vector2f(squareSize, squareSize));
+    static RectangleShape captureBox(Vector2f(squareSize - 6, squareSize - 6));
     captureBox.setFillColor(Color::Transparent);
     captureBox.setOutlineColor(captureColor);
     captureBox.setOutlineThickness(4);
 
     // Check highlight
-    RectangleShape checkHighlight(Vector2f(squareSize, squareSize));
+    static RectangleShape checkHighlight(Vector2f(squareSize, squareSize));
     checkHighlight.setFillColor(Color(255, 100, 100, 150));
 
     // Last move highlight
-    RectangleShape lastMoveHighlight(Vector2f(squareSize, squareSize));
+    static RectangleShape lastMoveHighlight(Vector2f(squareSize, squareSize));
     lastMoveHighlight.setFillColor(Color(100, 200, 255, 100));
 
+    // Move dot
+    static CircleShape dot(squareSize / 8.f);
+    dot.setFillColor(moveDotColor);
+    dot.setOrigin(dot.getRadius(), dot.getRadius());
+
     for (int i = 0; i < boardSize; ++i) {
         for (int j = 0; j < boardSize; ++j) {
             square.setFillColor((i + j) % 2 == 0 ? lightSquareColor : darkSquareColor);
 
+            // Selected square
+            if (i == selectedRow && j == selectedCol) {
+                square.setFillColor(highlightColor);
+            }
+
+            // The square goes first so the highlights below show on top of it
+            square.setPosition(j * squareSize + LABEL_MARGIN, i * squareSize + LABEL_MARGIN);
+            window.draw(square);
+
             // Highlight last move
-            if (moveHistoryCount > 0) {
-                int lastIdx = moveHistoryCount - 1;
-                if ((i == moveHistory_fromRow[lastIdx] && j == moveHistory_fromCol[lastIdx]) ||
-                    (i == moveHistory_toRow[lastIdx] && j == moveHistory_toCol[lastIdx])) {
+            if (const MoveRecord* last = lastRecord(history)) {
+                if (squareOf(i, j) == moveFrom(last->move) || squareOf(i, j) == moveTo(last->move)) {
                     lastMoveHighlight.setPosition(j * squareSize + LABEL_MARGIN, i * squareSize + LABEL_MARGIN);
                     window.draw(lastMoveHighlight);
                 }
@@ -424,14 +756,6 @@ void drawBoard(RenderWindow& window) {
                 window.draw(checkHighlight);
             }
 
-            // Selected square
-            if (i == selectedRow && j == selectedCol) {
-                square.setFillColor(highlightColor);
-            }
-
-            square.setPosition(j * squareSize + LABEL_MARGIN, i * squareSize + LABEL_MARGIN);
-            window.draw(square);
-
             // Move highlights
             if (highlightMovesArr[i][j]) {
                 bool isCapture = board[i][j] != NONE;
@@ -441,9 +765,6 @@ void drawBoard(RenderWindow& window) {
                     window.draw(captureBox);
                 }
                 else {
-                    CircleShape dot(squareSize / 8.f);
-                    dot.setFillColor(moveDotColor);
-                    dot.setOrigin(dot.getRadius(), dot.getRadius());
                     dot.setPosition(j * squareSize + LABEL_MARGIN + squareSize / 2.f,
                         i * squareSize + LABEL_MARGIN + squareSize / 2.f);
                     window.draw(dot);
@@ -453,32 +774,52 @@ void drawBoard(RenderWindow& window) {
     }
 }
 
-void drawCellReferences(RenderWindow& window) {
+void drawCellReferences(RenderTarget& window) {
     if (globalFont.getInfo().family == "") return;
-    Text text;
-    text.setFont(globalFont);
-    text.setCharacterSize(20);
-    text.setFillColor(Color::White);
 
-    for (int i = 0; i < 8; ++i) {
-        text.setString(static_cast<char>('A' + i));
-        text.setPosition(LABEL_MARGIN + i * squareSize + squareSize / 2.f - text.getLocalBounds().width / 2.f,
-            BOARD_PIXELS + LABEL_MARGIN + 5.f);
-        window.draw(text);
-    }
-
-    for (int i = 0; i < 8; ++i) {
-        text.setString(std::to_string(8 - i));
-        text.setPosition(5.f, LABEL_MARGIN + i * squareSize + squareSize / 2.f - text.getLocalBounds().height / 2.f);
-        window.draw(text);
+    // Files A-H along the bottom, ranks 8-1 down the left side
+    static Text labels[16];
+    static bool labelsReady = false;
+    if (!labelsReady) {
+        for (int i = 0; i < 16; ++i) {
+            Text& text = labels[i];
+            text.setFont(globalFont);
+            text.setCharacterSize(20);
+            text.setFillColor(Color::White);
+            if (i < 8) {
+                text.setString(static_cast<char>('A' + i));
+                text.setPosition(LABEL_MARGIN + i * squareSize + squareSize / 2.f - text.getLocalBounds().width / 2.f,
+                    BOARD_PIXELS + LABEL_MARGIN + 5.f);
+            }
+            else {
+                text.setString(std::to_string(16 - i));
+                text.setPosition(5.f, LABEL_MARGIN + (i - 8) * squareSize + squareSize / 2.f - text.getLocalBounds().height / 2.f);
+            }
+        }
+        labelsReady = true;
     }
+    for (const Text& text : labels) window.draw(text);
 }
 
 void drawGameStatus(RenderWindow& window) {
     if (globalFont.getInfo().family == "") return;
 
-    Text statusText;
-    statusText.setFont(globalFont);
+    // The texts only change with the game state
+    if (renderDirty) updateStatusTexts();
+    updateClockText();
+    window.draw(statusText);
+    if (!gameOver) {
+        window.draw(controlsText);
+        window.draw(audioText);
+    }
+    if (clockEnabled) window.draw(clockText);
+    window.draw(historyText);
+    if (analysisMode) window.draw(analysisText);
+    if (indexedGamesEnabled) window.draw(gamesText);
+}
+
+// Sets the status, controls and audio lines from the current game state
+void updateStatusTexts() {
     statusText.setCharacterSize(24);
     statusText.setFillColor(Color::White);
     statusText.setPosition(LABEL_MARGIN, 10);
@@ -491,84 +832,104 @@ void drawGameStatus(RenderWindow& window) {
         string check = "";
         if (whiteInCheck) check = " - White in CHECK!";
         if (blackInCheck) check = " - Black in CHECK!";
-        statusText.setString(turn + check);
+        string book = bookHintsEnabled ? "   " + bookHintText() : "";
+        string computer = analysisMode ? " (analysing)" : "";
+        if (computerEnabled) {
+            computer = isComputerTurn() ? " (computer thinking)" :
+                (ponderMove != NO_MOVE ? " (computer pondering)" : "");
+        }
+        statusText.setString(turn + computer + check + book);
 
         // Controls info
-        Text controlsText;
-        controlsText.setFont(globalFont);
-        controlsText.setCharacterSize(16);
+        controlsText.setCharacterSize(14);
         controlsText.setFillColor(Color::Yellow);
         controlsText.setPosition(LABEL_MARGIN, 40);
-        controlsText.setString("Controls: M - Music | S - Sounds | R - Restart | ESC - Quit");
-        window.draw(controlsText);
+        controlsText.setString("Controls: M Music | S Sounds | B Book | G Games | C Computer | A Analysis | T Clock | L Low power | U/Y Undo/Redo | P Save PGN | R Restart | ESC Quit");
 
         // Audio status
-        Text audioText;
-        audioText.setFont(globalFont);
         audioText.setCharacterSize(14);
         audioText.setFillColor(Color::Green);
         audioText.setPosition(LABEL_MARGIN, 65);
         audioText.setString("Audio: Music " + string(musicEnabled ? "ON" : "OFF") +
             " | Sounds " + string(soundsEnabled ? "ON" : "OFF"));
-        window.draw(audioText);
     }
+    updatePanelTexts();
+}
 
-    window.draw(statusText);
+// Formats both clocks into a fixed buffer and only touches clockText when the
+// displayed value changes. Returns true if it did.
+bool updateClockText() {
+    if (!clockEnabled) return false;
+    char white[16], black[16], buffer[64];
+    formatClock(clockTimeLeft(true), white, sizeof(white));
+    formatClock(clockTimeLeft(false), black, sizeof(black));
+    snprintf(buffer, sizeof(buffer), "White %s   Black %s", white, black);
+    if (strcmp(buffer, clockString) == 0) return false;
+    strcpy(clockString, buffer);
+
+    clockText.setCharacterSize(24);
+    clockText.setFillColor(Color::White);
+    clockText.setString(clockString);
+    clockText.setPosition(VIRTUAL_WIDTH - LABEL_MARGIN - clockText.getLocalBounds().width, 10);
+    return true;
 }
 
-bool loadTextures() {
-    // Load white pieces
-    if (!pieceTextures[W_KING - 1].loadFromFile("images/white-king.png")) {
-        cerr << "Failed to load white king texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[W_QUEEN - 1].loadFromFile("images/white-queen.png")) {
-        cerr << "Failed to load white queen texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[W_BISHOP - 1].loadFromFile("images/white-bishop.png")) {
-        cerr << "Failed to load white bishop texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[W_KNIGHT - 1].loadFromFile("images/white-knight.png")) {
-        cerr << "Failed to load white knight texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[W_ROOK - 1].loadFromFile("images/white-rook.png")) {
-        cerr << "Failed to load white rook texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[W_PAWN - 1].loadFromFile("images/white-pawn.png")) {
-        cerr << "Failed to load white pawn texture!" << endl;
-        return false;
+// The requested font if one was given, otherwise the first candidate that
+// exists; only existing files are handed to SFML so it does not log misses
+bool loadFont(const char* requested) {
+    if (requested) return globalFont.loadFromFile(requested);
+    for (const char* path : FONT_CANDIDATES) {
+        if (ifstream(path).good() && globalFont.loadFromFile(path)) {
+            LOG(LOG_DEBUG, "Using font " << path);
+            return true;
+        }
     }
+    return false;
+}
 
-    // Load black pieces
-    if (!pieceTextures[B_KING - 1].loadFromFile("images/black-king.png")) {
-        cerr << "Failed to load black king texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[B_QUEEN - 1].loadFromFile("images/black-queen.png")) {
-        cerr << "Failed to load black queen texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[B_BISHOP - 1].loadFromFile("images/black-bishop.png")) {
-        cerr << "Failed to load black bishop texture!" << endl;
-        return false;
-    }
-    if (!pieceTextures[B_KNIGHT - 1].loadFromFile("images/black-knight.png")) {
-        cerr << "Failed to load black knight texture!" << endl;
-        return false;
+bool loadTextures() {
+    // Normal start: one file read and one texture upload
+    if (!pieceAtlas.loadFromFile(PIECE_ATLAS_FILE)) {
+        // First start: pack the individual images and keep the atlas for next time
+        Image atlasImage;
+        if (!packPieceAtlas(atlasImage)) return false;
+        if (!atlasImage.saveToFile(PIECE_ATLAS_FILE)) {
+            LOG(LOG_WARN, "Could not save " << PIECE_ATLAS_FILE << ", the pieces will be packed again next start");
+        }
+        if (!pieceAtlas.loadFromImage(atlasImage)) {
+            LOG(LOG_ERROR, "Failed to create piece texture atlas!");
+            return false;
+        }
     }
-    if (!pieceTextures[B_ROOK - 1].loadFromFile("images/black-rook.png")) {
-        cerr << "Failed to load black rook texture!" << endl;
-        return false;
+
+    int cellWidth = pieceAtlas.getSize().x / 6, cellHeight = pieceAtlas.getSize().y / 2;
+    for (int i = 0; i < 12; i++) {
+        pieceAtlasRects[i] = IntRect((i % 6) * cellWidth, (i / 6) * cellHeight, cellWidth, cellHeight);
     }
-    if (!pieceTextures[B_PAWN - 1].loadFromFile("images/black-pawn.png")) {
-        cerr << "Failed to load black pawn texture!" << endl;
-        return false;
+    return true;
+}
+
+// Copies images/<colour>-<piece>.png into a 6x2 grid of equal cells, each
+// image centred in its cell so every piece can use the full cell rectangle
+bool packPieceAtlas(Image& atlasImage) {
+    Image images[12];
+    unsigned cellWidth = 0, cellHeight = 0;
+    for (int i = 0; i < 12; i++) {
+        if (!images[i].loadFromFile("images/" + string(pieceImageNames[i]) + ".png")) {
+            LOG(LOG_ERROR, "Failed to load " << pieceImageNames[i] << " texture!");
+            return false;
+        }
+        cellWidth = max(cellWidth, images[i].getSize().x);
+        cellHeight = max(cellHeight, images[i].getSize().y);
     }
 
+    atlasImage.create(cellWidth * 6, cellHeight * 2, Color::Transparent);
+    for (int i = 0; i < 12; i++) {
+        unsigned x = (i % 6) * cellWidth + (cellWidth - images[i].getSize().x) / 2;
+        unsigned y = (i / 6) * cellHeight + (cellHeight - images[i].getSize().y) / 2;
+        atlasImage.copy(images[i], x, y);
+    }
+    LOG(LOG_INFO, "Packed piece images into " << PIECE_ATLAS_FILE);
     return true;
 }
 
@@ -599,24 +960,24 @@ void initializeBoard() {
 void initializeSprites() {
     for (int r = 0; r < 8; r++) {
         for (int c = 0; c < 8; c++) {
-            if (board[r][c] != NONE) {
-                int textureIndex = board[r][c] - 1;
-                pieceSprites[r][c].setTexture(pieceTextures[textureIndex]);
+            if (board[r][c] != NONE) setPieceSprite(r, c, board[r][c]);
+        }
+    }
+}
 
-                // Calculate scale to fit within square with some padding
-                float textureWidth = pieceTextures[textureIndex].getSize().x;
-                float textureHeight = pieceTextures[textureIndex].getSize().y;
-                float scale = (squareSize * 0.8f) / std::max(textureWidth, textureHeight);
+// Points the sprite at the piece's cell in the shared atlas
+void setPieceSprite(int row, int col, int piece) {
+    const IntRect& rect = pieceAtlasRects[piece - 1];
+    pieceSprites[row][col].setTexture(pieceAtlas);
+    pieceSprites[row][col].setTextureRect(rect);
 
-                pieceSprites[r][c].setScale(scale, scale);
+    // Calculate scale to fit within square with some padding
+    float scale = (squareSize * 0.8f) / std::max(rect.width, rect.height);
+    pieceSprites[row][col].setScale(scale, scale);
 
-                // Center the sprite in the square
-                FloatRect bounds = pieceSprites[r][c].getLocalBounds();
-                pieceSprites[r][c].setOrigin(bounds.width / 2, bounds.height / 2);
-                updateSpritePosition(r, c);
-            }
-        }
-    }
+    // Center the sprite in the square
+    pieceSprites[row][col].setOrigin(rect.width / 2.f, rect.height / 2.f);
+    updateSpritePosition(row, col);
 }
 
 void updateSpritePosition(int row, int col) {
@@ -628,127 +989,17 @@ void updateSpritePosition(int row, int col) {
 
 void handleMouseClick(const Event& event, const RenderWindow& window) {
     if (event.mouseButton.button == Mouse::Left) {
+        // Clicks are ignored while the computer is to move
+        if (isComputerTurn()) return;
+
         Vector2f worldPos = window.mapPixelToCoords(Vector2i(event.mouseButton.x, event.mouseButton.y));
         int scol = int((worldPos.x - LABEL_MARGIN) / squareSize);
         int srow = int((worldPos.y - LABEL_MARGIN) / squareSize);
 
         if (scol >= 0 && scol < boardSize && srow >= 0 && srow < boardSize) {
-            // Handle pawn promotion FIRST
-            if (pawnPromotionPending) {
-                // Auto-promote to queen immediately when any square is clicked
-                promotePawn(promotionPawnType == W_PAWN ? W_QUEEN : B_QUEEN);
-                pawnPromotionPending = false;
-
-                // Check for game end conditions after promotion
-                updateKingPosition();
-                whiteInCheck = isInCheck(true);
-                blackInCheck = isInCheck(false);
-
-                if (isCheckmate(!whiteTurn)) {
-                    gameOver = true;
-                    gameResult = (whiteTurn ? "White" : "Black") + string(" wins by checkmate!");
-                    playSoundEffect(gameEndSound);
-                    cout << "CHECKMATE DETECTED AFTER PROMOTION!" << endl;
-                }
-                else if (isStalemate(!whiteTurn)) {
-                    gameOver = true;
-                    gameResult = "Stalemate!";
-                    playSoundEffect(gameEndSound);
-                }
-                else {
-                    whiteTurn = !whiteTurn; // Switch turn only if game not over
-                }
-
-                clearHighlights();
-                selectedRow = -1;
-                selectedCol = -1;
-                return;
-            }
-
             // If clicking a highlighted move
             if (selectedRow != -1 && highlightMovesArr[srow][scol]) {
-                // Check if this is a castling move
-                int movingPiece = board[selectedRow][selectedCol];
-                bool isCapture = board[srow][scol] != NONE;
-
-                if (movingPiece == W_KING || movingPiece == B_KING) {
-                    if (abs(selectedCol - scol) == 2) {
-                        // This is a castling move
-                        performCastling(scol > selectedCol);
-                        playSoundEffect(castleSound);
-                        whiteTurn = !whiteTurn;
-
-                        // Check for game end conditions
-                        updateKingPosition();
-                        whiteInCheck = isInCheck(true);
-                        blackInCheck = isInCheck(false);
-
-                        if (isCheckmate(!whiteTurn)) {
-                            gameOver = true;
-                            gameResult = (whiteTurn ? "White" : "Black") + string(" wins by checkmate!");
-                            playSoundEffect(gameEndSound);
-                            cout << "CHECKMATE DETECTED AFTER CASTLING!" << endl;
-                        }
-
-                        clearHighlights();
-                        selectedRow = -1;
-                        selectedCol = -1;
-                        return;
-                    }
-                }
-
-                // Store move in history before executing
-                if (moveHistoryCount < MAX_MOVES) {
-                    moveHistory_fromRow[moveHistoryCount] = selectedRow;
-                    moveHistory_fromCol[moveHistoryCount] = selectedCol;
-                    moveHistory_toRow[moveHistoryCount] = srow;
-                    moveHistory_toCol[moveHistoryCount] = scol;
-                    moveHistory_pieceMoved[moveHistoryCount] = board[selectedRow][selectedCol];
-                    moveHistory_pieceCaptured[moveHistoryCount] = board[srow][scol];
-                    moveHistoryCount++;
-                }
-
-                // Play appropriate sound
-                if (isCapture) {
-                    playSoundEffect(captureSound);
-                }
-                else {
-                    playSoundEffect(moveSound);
-                }
-
-                // Execute the move
-                movePiece(selectedRow, selectedCol, srow, scol);
-
-                // Check for game end conditions immediately after move
-                updateKingPosition();
-                whiteInCheck = isInCheck(true);
-                blackInCheck = isInCheck(false);
-
-                // Play check sound if applicable
-                if (whiteInCheck || blackInCheck) {
-                    playSoundEffect(checkSound);
-                }
-
-                // Check for checkmate on the player who just got moved against
-                if (isCheckmate(!whiteTurn)) {
-                    gameOver = true;
-                    gameResult = (whiteTurn ? "White" : "Black") + string(" wins by checkmate!");
-                    playSoundEffect(gameEndSound);
-                    cout << "CHECKMATE DETECTED!" << endl;
-                }
-                else if (isStalemate(!whiteTurn)) {
-                    gameOver = true;
-                    gameResult = "Stalemate!";
-                    playSoundEffect(gameEndSound);
-                }
-                else {
-                    whiteTurn = !whiteTurn; // Only switch turn if game is not over
-                }
-
-                clearHighlights();
-                selectedRow = -1;
-                selectedCol = -1;
-                selectedPieceType = NONE;
+                playMove(selectedRow, selectedCol, srow, scol, W_QUEEN);
                 return;
             }
 
@@ -770,94 +1021,145 @@ void handleMouseClick(const Event& event, const RenderWindow& window) {
             }
 
             clearHighlights();
-            if (selectedPieceType != NONE) {
-                generateValidMoves(srow, scol);
+            for (Bitboard targets = positionCache.targets[squareOf(srow, scol)]; targets; ) {
+                int sq = popLsb(targets);
+                highlightMovesArr[rowOf(sq)][colOf(sq)] = true;
             }
         }
     }
 }
 
+// Executes a move for whoever is to move (human or computer), then checks for
+// the end of the game and hands the turn over.
+void playMove(int sr, int sc, int tr, int tc, int promotionKind) {
+    int movingPiece = board[sr][sc];
+    bool isCapture = board[tr][tc] != NONE;
+    bool moverIsComputer = isComputerTurn();
+    if (analysisMode) stopEngine();
+    pressClock();
+
+    // Work out the move in core terms
+    Move played = NO_MOVE;
+    Move legal[MOVE_LIST_SIZE];
+    int legalCount = generateLegalMoves(gamePos, legal);
+    for (int i = 0; i < legalCount; i++) {
+        if (moveFrom(legal[i]) == squareOf(sr, sc) && moveTo(legal[i]) == squareOf(tr, tc) &&
+            (moveFlag(legal[i]) != MOVE_PROMOTION || movePromotion(legal[i]) == promotionKind)) {
+            played = legal[i];
+        }
+    }
+
+    if ((movingPiece == W_KING || movingPiece == B_KING) && abs(sc - tc) == 2) {
+        // This is a castling move
+        performCastling(tc > sc);
+        playSoundEffect(castleSound);
+    }
+    else {
+        // Play appropriate sound
+        if (isCapture) {
+            playSoundEffect(captureSound);
+        }
+        else {
+            playSoundEffect(moveSound);
+        }
+
+        // Execute the move
+        movePiece(sr, sc, tr, tc);
+
+        // Pawns reaching the last rank are promoted straight away
+        if (pawnPromotionPending) {
+            promotePawn(colouredPiece(promotionKind, isWhite(movingPiece)));
+        }
+    }
+
+    // Record the move and keep the core position in step
+    if (played != NO_MOVE) historyPlay(history, gamePos, played);
+
+    // Moves, checks and game end for the player who just got moved against
+    refreshPositionCache(!whiteTurn);
+
+    // Play check sound if applicable
+    if (whiteInCheck || blackInCheck) {
+        playSoundEffect(checkSound);
+    }
+
+    if (updateGameOver()) {
+        playSoundEffect(gameEndSound);
+    }
+    else {
+        whiteTurn = !whiteTurn; // Only switch turn if game is not over
+    }
+
+    clearHighlights();
+    selectedRow = -1;
+    selectedCol = -1;
+    selectedPieceType = NONE;
+    renderDirty = true;
+
+    if (gameOver) {
+        stopEngine();
+    }
+    else if (moverIsComputer) {
+        startPondering();
+    }
+    else if (isComputerTurn()) {
+        startComputerTurn(played);
+    }
+    else if (analysisMode) {
+        startAnalysis();
+    }
+}
+
 void promotePawn(int promotionType) {
     if (!pawnPromotionPending) return;
 
-    cout << "Promoting pawn at " << promotionRow << "," << promotionCol << " to " << promotionType << endl;
+    LOG(LOG_DEBUG, "Promoting pawn at " << promotionRow << "," << promotionCol << " to " << promotionType);
 
     board[promotionRow][promotionCol] = promotionType;
 
     // Update sprite
-    int textureIndex = promotionType - 1;
-    pieceSprites[promotionRow][promotionCol].setTexture(pieceTextures[textureIndex]);
-
-    // Recalculate scale for the new piece
-    float textureWidth = pieceTextures[textureIndex].getSize().x;
-    float textureHeight = pieceTextures[textureIndex].getSize().y;
-    float scale = (squareSize * 0.8f) / std::max(textureWidth, textureHeight);
-
-    pieceSprites[promotionRow][promotionCol].setScale(scale, scale);
-
-    // Re-center the sprite
-    FloatRect bounds = pieceSprites[promotionRow][promotionCol].getLocalBounds();
-    pieceSprites[promotionRow][promotionCol].setOrigin(bounds.width / 2, bounds.height / 2);
-    updateSpritePosition(promotionRow, promotionCol);
+    setPieceSprite(promotionRow, promotionCol, promotionType);
 
     // Play promotion sound
     playSoundEffect(promoteSound);
 
     pawnPromotionPending = false;
-    cout << "Pawn promotion completed!" << endl;
+    LOG(LOG_DEBUG, "Pawn promotion completed!");
 }
 
 // ========== CHESS LOGIC FUNCTIONS ==========
 
 bool isSquareAttacked(int row, int col, bool byWhite) {
-    // Check for pawn attacks
-    int pawnDir = byWhite ? -1 : 1;
-    if (insideBoard(row + pawnDir, col - 1) &&
-        board[row + pawnDir][col - 1] == (byWhite ? W_PAWN : B_PAWN)) return true;
-    if (insideBoard(row + pawnDir, col + 1) &&
-        board[row + pawnDir][col + 1] == (byWhite ? W_PAWN : B_PAWN)) return true;
+    INSTRUMENT_COUNT(COUNTER_ATTACK_CHECKS);
+    // The 8x8 board viewed as 64 squares, matching the geometry tables
+    const int* cells = &board[0][0];
+    int sq = squareOf(row, col);
+
+    // Check for pawn attacks: a pawn attacks sq from the squares an enemy pawn on sq would attack
+    for (Bitboard from = pawnAttacks[byWhite ? 1 : 0][sq]; from; ) {
+        if (cells[popLsb(from)] == (byWhite ? W_PAWN : B_PAWN)) return true;
+    }
 
     // Check for knight attacks
-    int knightMoves[8][2] = { {-2,-1},{-2,1},{-1,-2},{-1,2},{1,-2},{1,2},{2,-1},{2,1} };
-    for (auto& move : knightMoves) {
-        int r = row + move[0], c = col + move[1];
-        if (insideBoard(r, c) && board[r][c] == (byWhite ? W_KNIGHT : B_KNIGHT)) return true;
+    for (Bitboard from = knightAttacks[sq]; from; ) {
+        if (cells[popLsb(from)] == (byWhite ? W_KNIGHT : B_KNIGHT)) return true;
     }
 
     // Check for king attacks (adjacent squares)
-    for (int dr = -1; dr <= 1; dr++) {
-        for (int dc = -1; dc <= 1; dc++) {
-            if (dr == 0 && dc == 0) continue;
-            int r = row + dr, c = col + dc;
-            if (insideBoard(r, c) && board[r][c] == (byWhite ? W_KING : B_KING)) return true;
-        }
+    for (Bitboard from = kingAttacks[sq]; from; ) {
+        if (cells[popLsb(from)] == (byWhite ? W_KING : B_KING)) return true;
     }
 
-    // Check for rook/queen attacks (horizontal/vertical)
-    int rookDirs[4][2] = { {-1,0},{1,0},{0,-1},{0,1} };
-    for (auto& dir : rookDirs) {
-        int r = row + dir[0], c = col + dir[1];
-        while (insideBoard(r, c)) {
-            if (board[r][c] != NONE) {
-                if (board[r][c] == (byWhite ? W_ROOK : B_ROOK) ||
-                    board[r][c] == (byWhite ? W_QUEEN : B_QUEEN)) return true;
+    // Check for rook/queen attacks along the first four rays, bishop/queen along the diagonal ones
+    for (int d = 0; d < 8; d++) {
+        int slider = d < 4 ? (byWhite ? W_ROOK : B_ROOK) : (byWhite ? W_BISHOP : B_BISHOP);
+        const Ray& ray = rays[d][sq];
+        for (int i = 0; i < ray.length; i++) {
+            int piece = cells[ray.squares[i]];
+            if (piece != NONE) {
+                if (piece == slider || piece == (byWhite ? W_QUEEN : B_QUEEN)) return true;
                 break;
             }
-            r += dir[0]; c += dir[1];
-        }
-    }
-
-    // Check for bishop/queen attacks (diagonal)
-    int bishopDirs[4][2] = { {-1,-1},{-1,1},{1,-1},{1,1} };
-    for (auto& dir : bishopDirs) {
-        int r = row + dir[0], c = col + dir[1];
-        while (insideBoard(r, c)) {
-            if (board[r][c] != NONE) {
-                if (board[r][c] == (byWhite ? W_BISHOP : B_BISHOP) ||
-                    board[r][c] == (byWhite ? W_QUEEN : B_QUEEN)) return true;
-                break;
-            }
-            r += dir[0]; c += dir[1];
         }
     }
 
@@ -874,22 +1176,10 @@ bool isInCheck(bool whiteKing) {
 }
 
 
-void updateKingPosition() {
-    for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            if (board[r][c] == W_KING) {
-                whiteKingRow = r; whiteKingCol = c;
-            }
-            else if (board[r][c] == B_KING) {
-                blackKingRow = r; blackKingCol = c;
-            }
-        }
-    }
-}
-
 void generateValidMoves(int r, int c) {
     int piece = board[r][c];
     if (piece == NONE) return;
+    INSTRUMENT_PHASE(PHASE_MOVE_GENERATION);
 
     // Store original board state
     int tempBoard[8][8];
@@ -914,10 +1204,15 @@ void generateValidMoves(int r, int c) {
     for (int tr = 0; tr < 8; tr++) {
         for (int tc = 0; tc < 8; tc++) {
             if (highlightMovesArr[tr][tc]) {
-                // Simulate move
+                INSTRUMENT_COUNT(COUNTER_MOVES_GENERATED);
+                INSTRUMENT_COUNT(COUNTER_LEGALITY_CHECKS);
+                // Simulate move; an en passant capture also lifts the pawn beside the mover
                 int captured = board[tr][tc];
+                bool enPassant = (piece == W_PAWN || piece == B_PAWN) && tc != c && captured == NONE;
+                int epPawn = enPassant ? board[r][tc] : NONE;
                 board[tr][tc] = piece;
                 board[r][c] = NONE;
+                if (enPassant) board[r][tc] = NONE;
 
                 // Update king position if moving king - FIXED: Initialize variables
                 int oldWhiteKingRow = whiteKingRow, oldWhiteKingCol = whiteKingCol;
@@ -944,6 +1239,7 @@ void generateValidMoves(int r, int c) {
                 // Restore board
                 board[r][c] = piece;
                 board[tr][tc] = captured;
+                if (enPassant) board[r][tc] = epPawn;
 
                 // Remove invalid move
                 if (leavesInCheck) {
@@ -954,15 +1250,13 @@ void generateValidMoves(int r, int c) {
     }
 }
 
-void genRookMoves(int r, int c) {
+// Marks every square along the given rays up to and including the first enemy piece
+void genSliderMoves(int r, int c, int firstDirection, int lastDirection) {
     int me = board[r][c];
-    const int dr[4] = { -1, 1, 0, 0 };
-    const int dc[4] = { 0, 0, -1, 1 };
-
-    for (int d = 0; d < 4; ++d) {
-        int rr = r + dr[d];
-        int cc = c + dc[d];
-        while (insideBoard(rr, cc)) {
+    for (int d = firstDirection; d < lastDirection; ++d) {
+        const Ray& ray = rays[d][squareOf(r, c)];
+        for (int i = 0; i < ray.length; ++i) {
+            int rr = rowOf(ray.squares[i]), cc = colOf(ray.squares[i]);
             if (board[rr][cc] == NONE) {
                 highlightMovesArr[rr][cc] = true;
             }
@@ -972,157 +1266,112 @@ void genRookMoves(int r, int c) {
                 }
                 break;
             }
-            rr += dr[d]; cc += dc[d];
         }
     }
 }
 
-void genBishopMoves(int r, int c) {
+// Marks the empty or enemy-occupied squares of a knight or king attack mask
+void genStepMoves(int r, int c, Bitboard targets) {
     int me = board[r][c];
-    const int dr[4] = { -1, -1, 1, 1 };
-    const int dc[4] = { -1, 1, -1, 1 };
-
-    for (int d = 0; d < 4; ++d) {
-        int rr = r + dr[d];
-        int cc = c + dc[d];
-        while (insideBoard(rr, cc)) {
-            if (board[rr][cc] == NONE) {
-                highlightMovesArr[rr][cc] = true;
-            }
-            else {
-                if (isEnemyPiece(board[rr][cc], me)) {
-                    highlightMovesArr[rr][cc] = true;
-                }
-                break;
-            }
-            rr += dr[d]; cc += dc[d];
+    while (targets) {
+        int sq = popLsb(targets);
+        int rr = rowOf(sq), cc = colOf(sq);
+        if (board[rr][cc] == NONE || isEnemyPiece(board[rr][cc], me)) {
+            highlightMovesArr[rr][cc] = true;
         }
     }
 }
 
-void genKnightMoves(int r, int c) {
-    int me = board[r][c];
-    const int dr[8] = { -2,-1,1,2,2,1,-1,-2 };
-    const int dc[8] = { 1,2,2,1,-1,-2,-2,-1 };
+void genRookMoves(int r, int c) {
+    genSliderMoves(r, c, DIR_UP, DIR_UP_LEFT);
+}
 
-    for (int i = 0; i < 8; ++i) {
-        int rr = r + dr[i], cc = c + dc[i];
-        if (!insideBoard(rr, cc)) continue;
-        if (board[rr][cc] == NONE || isEnemyPiece(board[rr][cc], me)) {
-            highlightMovesArr[rr][cc] = true;
-        }
-    }
+void genBishopMoves(int r, int c) {
+    genSliderMoves(r, c, DIR_UP_LEFT, 8);
+}
+
+void genKnightMoves(int r, int c) {
+    genStepMoves(r, c, knightAttacks[squareOf(r, c)]);
 }
 
 void genKingMoves(int r, int c) {
     int me = board[r][c];
 
     // Normal king moves
-    for (int dr = -1; dr <= 1; ++dr) {
-        for (int dc = -1; dc <= 1; ++dc) {
-            if (dr == 0 && dc == 0) continue;
-            int rr = r + dr, cc = c + dc;
-            if (!insideBoard(rr, cc)) continue;
-            if (board[rr][cc] == NONE || isEnemyPiece(board[rr][cc], me)) {
-                highlightMovesArr[rr][cc] = true;
-            }
-        }
+    genStepMoves(r, c, kingAttacks[squareOf(r, c)]);
+
+    // Castling, from the table of king and rook paths
+    bool white = me == W_KING;
+    if (squareOf(r, c) != castlingPaths[white ? 0 : 2].kingFrom || (white ? whiteInCheck : blackInCheck)) return;
+    for (int i = white ? 0 : 2; i < (white ? 2 : 4); i++) {
+        const CastlingPath& path = castlingPaths[i];
+        if (!castlingRightKept(i) || !squaresEmpty(path.empty) || squaresAttacked(path.safe, !white)) continue;
+        highlightMovesArr[rowOf(path.kingTo)][colOf(path.kingTo)] = true;
+        LOG(LOG_TRACE, (white ? "White " : "Black ") << (i % 2 == 0 ? "kingside" : "queenside") << " castling available");
     }
+}
 
-    // Castling - White
-    if (me == W_KING && r == 7 && c == 4 && !whiteKingMoved && !whiteInCheck) {
-        // Kingside castling
-        if (!whiteRookKingMoved &&
-            board[7][5] == NONE && board[7][6] == NONE &&
-            !isSquareAttacked(7, 5, false) && !isSquareAttacked(7, 6, false)) {
-            highlightMovesArr[7][6] = true;
-            cout << "White kingside castling available" << endl;
-        }
-        // Queenside castling
-        if (!whiteRookQueenMoved &&
-            board[7][3] == NONE && board[7][2] == NONE && board[7][1] == NONE &&
-            !isSquareAttacked(7, 3, false) && !isSquareAttacked(7, 2, false)) {
-            highlightMovesArr[7][2] = true;
-            cout << "White queenside castling available" << endl;
-        }
+// The GUI's castling flags for castlingPaths[path]
+bool castlingRightKept(int path) {
+    switch (path) {
+    case 0: return !whiteKingMoved && !whiteRookKingMoved;
+    case 1: return !whiteKingMoved && !whiteRookQueenMoved;
+    case 2: return !blackKingMoved && !blackRookKingMoved;
+    default: return !blackKingMoved && !blackRookQueenMoved;
     }
+}
 
-    // Castling - Black
-    if (me == B_KING && r == 0 && c == 4 && !blackKingMoved && !blackInCheck) {
-        // Kingside castling
-        if (!blackRookKingMoved &&
-            board[0][5] == NONE && board[0][6] == NONE &&
-            !isSquareAttacked(0, 5, true) && !isSquareAttacked(0, 6, true)) {
-            highlightMovesArr[0][6] = true;
-            cout << "Black kingside castling available" << endl;
-        }
-        // Queenside castling
-        if (!blackRookQueenMoved &&
-            board[0][3] == NONE && board[0][2] == NONE && board[0][1] == NONE &&
-            !isSquareAttacked(0, 3, true) && !isSquareAttacked(0, 2, true)) {
-            highlightMovesArr[0][2] = true;
-            cout << "Black queenside castling available" << endl;
-        }
+bool squaresEmpty(Bitboard squares) {
+    while (squares) {
+        int sq = popLsb(squares);
+        if (board[rowOf(sq)][colOf(sq)] != NONE) return false;
     }
+    return true;
 }
 
-void genPawnMoves(int r, int c) {
-    int me = board[r][c];
-
-    if (me == W_PAWN) {
-        // Forward move
-        if (insideBoard(r - 1, c) && board[r - 1][c] == NONE) {
-            highlightMovesArr[r - 1][c] = true;
-            // Double move from starting position
-            if (r == 6 && board[4][c] == NONE) {
-                highlightMovesArr[4][c] = true;
-            }
-        }
-
-        // Captures
-        if (insideBoard(r - 1, c - 1) && isBlack(board[r - 1][c - 1])) {
-            highlightMovesArr[r - 1][c - 1] = true;
-        }
-        if (insideBoard(r - 1, c + 1) && isBlack(board[r - 1][c + 1])) {
-            highlightMovesArr[r - 1][c + 1] = true;
-        }
+// Reads the attack maps, so only valid while refreshPositionCache() generates moves
+bool squaresAttacked(Bitboard squares, bool byWhite) {
+    return (squares & positionCache.attacked[byWhite ? 0 : 1]) != 0;
+}
 
-        // En Passant
-        if (r == 3 && enPassantPossible && enPassantTargetRow == 2) {
-            if (c - 1 == enPassantTargetCol) highlightMovesArr[2][c - 1] = true;
-            if (c + 1 == enPassantTargetCol) highlightMovesArr[2][c + 1] = true;
+// One pawn generator per colour: direction, start row and en passant row are constants
+template <bool White>
+void genPawnMovesFor(int r, int c) {
+    constexpr int dir = White ? -1 : 1;
+    constexpr int startRow = White ? 6 : 1;
+    constexpr int epRow = White ? 3 : 4;    // row a pawn captures en passant from
+
+    // Forward move
+    if (insideBoard(r + dir, c) && board[r + dir][c] == NONE) {
+        highlightMovesArr[r + dir][c] = true;
+        // Double move from starting position
+        if (r == startRow && board[r + 2 * dir][c] == NONE) {
+            highlightMovesArr[r + 2 * dir][c] = true;
         }
-
     }
-    else if (me == B_PAWN) {
-        // Forward move
-        if (insideBoard(r + 1, c) && board[r + 1][c] == NONE) {
-            highlightMovesArr[r + 1][c] = true;
-            // Double move from starting position
-            if (r == 1 && board[3][c] == NONE) {
-                highlightMovesArr[3][c] = true;
-            }
-        }
 
-        // Captures
-        if (insideBoard(r + 1, c - 1) && isWhite(board[r + 1][c - 1])) {
-            highlightMovesArr[r + 1][c - 1] = true;
-        }
-        if (insideBoard(r + 1, c + 1) && isWhite(board[r + 1][c + 1])) {
-            highlightMovesArr[r + 1][c + 1] = true;
+    // Captures
+    for (Bitboard targets = pawnAttacks[White ? 0 : 1][squareOf(r, c)]; targets; ) {
+        int sq = popLsb(targets);
+        int target = board[rowOf(sq)][colOf(sq)];
+        if (White ? isBlack(target) : isWhite(target)) {
+            highlightMovesArr[rowOf(sq)][colOf(sq)] = true;
         }
+    }
 
-        // En Passant
-        if (r == 4 && enPassantPossible && enPassantTargetRow == 5) {
-            if (c - 1 == enPassantTargetCol) highlightMovesArr[5][c - 1] = true;
-            if (c + 1 == enPassantTargetCol) highlightMovesArr[5][c + 1] = true;
-        }
+    // En Passant
+    if (r == epRow && enPassantPossible && enPassantTargetRow == r + dir && abs(c - enPassantTargetCol) == 1) {
+        highlightMovesArr[r + dir][enPassantTargetCol] = true;
     }
 }
 
+void genPawnMoves(int r, int c) {
+    if (board[r][c] == W_PAWN) genPawnMovesFor<true>(r, c);
+    else if (board[r][c] == B_PAWN) genPawnMovesFor<false>(r, c);
+}
+
 void genQueenMoves(int r, int c) {
-    genRookMoves(r, c);
-    genBishopMoves(r, c);
+    genSliderMoves(r, c, DIR_UP, 8);
 }
 
 void movePiece(int sr, int sc, int tr, int tc) {
@@ -1130,16 +1379,11 @@ void movePiece(int sr, int sc, int tr, int tc) {
 
     // Handle en passant capture
     if ((movingPiece == W_PAWN || movingPiece == B_PAWN) && sc != tc && board[tr][tc] == NONE) {
-        // This is an en passant capture
-        if (movingPiece == W_PAWN) {
-            board[tr + 1][tc] = NONE;
-            // Hide the captured pawn sprite
-            pieceSprites[tr + 1][tc].setPosition(-1000, -1000);
-        }
-        else {
-            board[tr - 1][tc] = NONE;
-            pieceSprites[tr - 1][tc].setPosition(-1000, -1000);
-        }
+        // This is an en passant capture: the captured pawn is beside the moving one
+        int capturedRow = movingPiece == W_PAWN ? tr + 1 : tr - 1;
+        board[capturedRow][tc] = NONE;
+        // Hide the captured pawn sprite
+        pieceSprites[capturedRow][tc].setPosition(-1000, -1000);
     }
 
     // Update castling flags (for non-castling moves)
@@ -1153,6 +1397,11 @@ void movePiece(int sr, int sc, int tr, int tc) {
         if (sr == 0 && sc == 0) blackRookQueenMoved = true;
         if (sr == 0 && sc == 7) blackRookKingMoved = true;
     }
+    // A rook captured on its corner takes its castling right with it
+    if (tr == 7 && tc == 0) whiteRookQueenMoved = true;
+    if (tr == 7 && tc == 7) whiteRookKingMoved = true;
+    if (tr == 0 && tc == 0) blackRookQueenMoved = true;
+    if (tr == 0 && tc == 7) blackRookKingMoved = true;
 
     // Set en passant target for next move
     enPassantPossible = false;
@@ -1168,7 +1417,7 @@ void movePiece(int sr, int sc, int tr, int tc) {
         promotionRow = tr;
         promotionCol = tc;
         promotionPawnType = movingPiece;
-        cout << "Pawn promotion triggered at " << tr << "," << tc << endl;
+        LOG(LOG_DEBUG, "Pawn promotion triggered at " << tr << "," << tc);
     }
 
     // Move the sprite
@@ -1194,135 +1443,528 @@ void movePiece(int sr, int sc, int tr, int tc) {
 }
 
 void performCastling(bool kingside) {
+    const CastlingPath& path = castlingPaths[(whiteTurn ? 0 : 2) + (kingside ? 0 : 1)];
+    LOG(LOG_DEBUG, "Performing " << (whiteTurn ? "white " : "black ") << (kingside ? "kingside" : "queenside") << " castling");
+
+    relocatePiece(path.kingFrom, path.kingTo);
+    relocatePiece(path.rookFrom, path.rookTo);
+
+    // Update king position
     if (whiteTurn) {
-        if (kingside) {
-            // White kingside castling
-            cout << "Performing white kingside castling" << endl;
-
-            // Move king
-            board[7][6] = W_KING;
-            board[7][4] = NONE;
-            pieceSprites[7][6] = pieceSprites[7][4];
-            updateSpritePosition(7, 6);
-            pieceSprites[7][4].setPosition(-1000, -1000);
-
-            // Move rook
-            board[7][5] = W_ROOK;
-            board[7][7] = NONE;
-            pieceSprites[7][5] = pieceSprites[7][7];
-            updateSpritePosition(7, 5);
-            pieceSprites[7][7].setPosition(-1000, -1000);
-
-            // Update king position
-            whiteKingRow = 7;
-            whiteKingCol = 6;
-        }
-        else {
-            // White queenside castling
-            cout << "Performing white queenside castling" << endl;
-
-            // Move king
-            board[7][2] = W_KING;
-            board[7][4] = NONE;
-            pieceSprites[7][2] = pieceSprites[7][4];
-            updateSpritePosition(7, 2);
-            pieceSprites[7][4].setPosition(-1000, -1000);
-
-            // Move rook
-            board[7][3] = W_ROOK;
-            board[7][0] = NONE;
-            pieceSprites[7][3] = pieceSprites[7][0];
-            updateSpritePosition(7, 3);
-            pieceSprites[7][0].setPosition(-1000, -1000);
-
-            // Update king position
-            whiteKingRow = 7;
-            whiteKingCol = 2;
-        }
+        whiteKingRow = rowOf(path.kingTo);
+        whiteKingCol = colOf(path.kingTo);
         whiteKingMoved = true;
     }
     else {
-        // Black castling
-        if (kingside) {
-            // Black kingside castling
-            cout << "Performing black kingside castling" << endl;
-
-            // Move king
-            board[0][6] = B_KING;
-            board[0][4] = NONE;
-            pieceSprites[0][6] = pieceSprites[0][4];
-            updateSpritePosition(0, 6);
-            pieceSprites[0][4].setPosition(-1000, -1000);
-
-            // Move rook
-            board[0][5] = B_ROOK;
-            board[0][7] = NONE;
-            pieceSprites[0][5] = pieceSprites[0][7];
-            updateSpritePosition(0, 5);
-            pieceSprites[0][7].setPosition(-1000, -1000);
-
-            // Update king position
-            blackKingRow = 0;
-            blackKingCol = 6;
-        }
-        else {
-            // Black queenside castling
-            cout << "Performing black queenside castling" << endl;
-
-            // Move king
-            board[0][2] = B_KING;
-            board[0][4] = NONE;
-            pieceSprites[0][2] = pieceSprites[0][4];
-            updateSpritePosition(0, 2);
-            pieceSprites[0][4].setPosition(-1000, -1000);
-
-            // Move rook
-            board[0][3] = B_ROOK;
-            board[0][0] = NONE;
-            pieceSprites[0][3] = pieceSprites[0][0];
-            updateSpritePosition(0, 3);
-            pieceSprites[0][0].setPosition(-1000, -1000);
-
-            // Update king position
-            blackKingRow = 0;
-            blackKingCol = 2;
-        }
+        blackKingRow = rowOf(path.kingTo);
+        blackKingCol = colOf(path.kingTo);
         blackKingMoved = true;
     }
 }
 
-bool hasValidMoves(bool forWhite) {
-    // Check if any piece of the given color has any valid moves
+// Moves a piece and its sprite from one square to another
+void relocatePiece(int from, int to) {
+    int fr = rowOf(from), fc = colOf(from), tr = rowOf(to), tc = colOf(to);
+    board[tr][tc] = board[fr][fc];
+    board[fr][fc] = NONE;
+    pieceSprites[tr][tc] = pieceSprites[fr][fc];
+    updateSpritePosition(tr, tc);
+    pieceSprites[fr][fc].setPosition(-1000, -1000);
+}
+
+void refreshPositionCache(bool forWhite) {
+    INSTRUMENT_PHASE(PHASE_GAME_END_SCAN);
+    PositionCache& cache = positionCache;
+    cache.forWhite = forWhite;
+
+    // Attack maps first: check status and castling are read from them
+    cache.attacked[0] = cache.attacked[1] = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (isSquareAttacked(rowOf(sq), colOf(sq), true)) cache.attacked[0] |= squareBit(sq);
+        if (isSquareAttacked(rowOf(sq), colOf(sq), false)) cache.attacked[1] |= squareBit(sq);
+    }
+    whiteInCheck = (cache.attacked[1] & squareBit(squareOf(whiteKingRow, whiteKingCol))) != 0;
+    blackInCheck = (cache.attacked[0] & squareBit(squareOf(blackKingRow, blackKingCol))) != 0;
+    cache.inCheck = forWhite ? whiteInCheck : blackInCheck;
+
+    // Legal destinations of every piece, through the highlight generator
+    cache.moveCount = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        cache.targets[sq] = 0;
+        int piece = board[rowOf(sq)][colOf(sq)];
+        if (piece == NONE || isWhite(piece) != forWhite) continue;
+        clearHighlights();
+        generateValidMoves(rowOf(sq), colOf(sq));
+        for (int target = 0; target < 64; target++) {
+            if (highlightMovesArr[rowOf(target)][colOf(target)]) {
+                cache.targets[sq] |= squareBit(target);
+                cache.moveCount++;
+            }
+        }
+    }
+    clearHighlights();
+
+    cache.status = cache.moveCount ? STATUS_PLAYING : cache.inCheck ? STATUS_CHECKMATE : STATUS_STALEMATE;
+    LOG(LOG_DEBUG, "Position cache: forWhite=" << forWhite << " inCheck=" << cache.inCheck << " moves=" << cache.moveCount);
+}
+
+// Sets gameOver and gameResult for gamePos, whose side to move the position
+// cache must be up to date for. True if the game has ended.
+bool updateGameOver() {
+    gameOver = true;
+    if (positionCache.status == STATUS_CHECKMATE) {
+        gameResult = (positionCache.forWhite ? "Black" : "White") + string(" wins by checkmate!");
+        LOG(LOG_INFO, "CHECKMATE DETECTED!");
+    }
+    else if (positionCache.status == STATUS_STALEMATE) gameResult = "Stalemate!";
+    else if (repetitionCount(history, gamePos) >= 3) gameResult = "Draw by threefold repetition!";
+    else if (gamePos.halfmoveClock >= 100) gameResult = "Draw by the fifty-move rule!";
+    else {
+        gameOver = false;
+        gameResult = "";
+    }
+    return gameOver;
+}
+
+// ========== CORE BRIDGE ==========
+
+// Makes the GUI board and rule flags match gamePos, after a takeback or replay
+void syncGuiFromPosition() {
     for (int r = 0; r < 8; r++) {
-        for (int c = 0; c < 8; c++) {
-            int piece = board[r][c];
-            if (piece != NONE && ((forWhite && isWhite(piece)) || (!forWhite && isBlack(piece)))) {
-                // Generate moves for this piece
-                clearHighlights();
-                generateValidMoves(r, c);
-
-                // Check if any valid moves exist
-                for (int tr = 0; tr < 8; tr++) {
-                    for (int tc = 0; tc < 8; tc++) {
-                        if (highlightMovesArr[tr][tc]) {
-                            clearHighlights();
-                            return true;
-                        }
-                    }
+        for (int c = 0; c < 8; c++) board[r][c] = gamePos.board[squareOf(r, c)];
+    }
+    whiteTurn = gamePos.whiteToMove;
+    whiteRookKingMoved = !(gamePos.castling & CASTLE_WK);
+    whiteRookQueenMoved = !(gamePos.castling & CASTLE_WQ);
+    whiteKingMoved = whiteRookKingMoved && whiteRookQueenMoved;
+    blackRookKingMoved = !(gamePos.castling & CASTLE_BK);
+    blackRookQueenMoved = !(gamePos.castling & CASTLE_BQ);
+    blackKingMoved = blackRookKingMoved && blackRookQueenMoved;
+    enPassantPossible = gamePos.epSquare != -1;
+    enPassantTargetRow = enPassantPossible ? rowOf(gamePos.epSquare) : -1;
+    enPassantTargetCol = enPassantPossible ? colOf(gamePos.epSquare) : -1;
+    pawnPromotionPending = false;
+
+    whiteKingRow = rowOf(gamePos.kingSquare[0]);
+    whiteKingCol = colOf(gamePos.kingSquare[0]);
+    blackKingRow = rowOf(gamePos.kingSquare[1]);
+    blackKingCol = colOf(gamePos.kingSquare[1]);
+    refreshPositionCache(whiteTurn);
+    updateGameOver();
+
+    clearHighlights();
+    selectedRow = selectedCol = -1;
+    selectedPieceType = NONE;
+    initializeSprites();
+    renderDirty = true;
+    if (analysisMode) startAnalysis();
+}
+
+void undoMove() {
+    stopEngine();
+    if (!historyUndo(history, gamePos)) return;
+    // Against the computer its reply is taken back too, so it is the human's turn again
+    if (computerEnabled && !gamePos.whiteToMove) historyUndo(history, gamePos);
+    syncGuiFromPosition();
+    turnClock.restart();
+    playSoundEffect(moveSound);
+}
+
+void redoMove() {
+    stopEngine();
+    if (!historyRedo(history, gamePos)) return;
+    if (computerEnabled && !gamePos.whiteToMove) historyRedo(history, gamePos);
+    syncGuiFromPosition();
+    turnClock.restart();
+    playSoundEffect(moveSound);
+    if (isComputerTurn()) startComputerTurn(NO_MOVE);
+}
+
+// Writes the moves played so far to PGN_EXPORT_FILE
+void exportPgn() {
+    int result = RESULT_UNKNOWN;
+    if (gameOver) {
+        if (gameResult.find("White wins") == 0) result = RESULT_WHITE_WINS;
+        else if (gameResult.find("Black wins") == 0) result = RESULT_BLACK_WINS;
+        else result = RESULT_DRAW;
+    }
+    PgnGame game = historyToPgn(history, result);
+    for (auto& tag : game.tags) {
+        if (tag.first == "Black" && computerEnabled) tag.second = "Computer";
+    }
+    ofstream out(PGN_EXPORT_FILE);
+    writePgnGame(out, game);
+    LOG(LOG_INFO, (out ? "Saved game to " : "Could not write ") << PGN_EXPORT_FILE);
+}
+
+// "Book: e4 52% d4 30%" for the position on screen, cached until the position changes
+string bookHintText() {
+    static uint64_t cachedKey = 0;
+    static string cachedText;
+    if (!openingBook.entries) return "Book: none loaded";
+    if (pawnPromotionPending) return "";
+
+    Position pos = gamePos;
+    if (pos.key == cachedKey && !cachedText.empty()) return cachedText;
+
+    BookEntry entries[8];
+    int count = probeBook(openingBook, pos.key, entries, 8);
+    Move legal[MOVE_LIST_SIZE];
+    int legalCount = generateLegalMoves(pos, legal);
+    unsigned total = 0;
+    for (int i = 0; i < count; i++) total += entries[i].weight;
+
+    string text = "Book:";
+    for (int i = 0; i < count && i < 3; i++) {
+        if (find(legal, legal + legalCount, Move(entries[i].move)) == legal + legalCount) continue;
+        text += " " + moveToSan(pos, entries[i].move);
+        if (total > 0) text += " " + to_string(entries[i].weight * 100 / total) + "%";
+    }
+    if (text == "Book:") text = "Out of book";
+
+    cachedKey = pos.key;
+    cachedText = text;
+    return text;
+}
+
+// "Games: 1234 (+500 =400 -334)" and the first few of them for the position
+// on screen, cached until the position changes
+string indexedGamesText() {
+    static uint64_t cachedKey = 0;
+    static string cachedText;
+    if (!gameIndex.header) return "Games: no index loaded";
+    if (gamePos.key == cachedKey && !cachedText.empty()) return cachedText;
+
+    vector<uint32_t> ids;
+    uint64_t results[4];
+    uint64_t total = findGames(gameIndex, gamePos.key, ids, INDEXED_GAMES_SHOWN);
+    countResults(gameIndex, gamePos.key, results);
+    string text = "Games: " + to_string(total);
+    if (total > 0) {
+        text += " (+" + to_string(results[RESULT_WHITE_WINS]) + " =" + to_string(results[RESULT_DRAW]) +
+            " -" + to_string(results[RESULT_BLACK_WINS]) + ")";
+    }
+    for (uint32_t id : ids) {
+        PgnGame game;
+        if (!loadIndexedGame(gameIndex, gameIndexPath, id, game)) continue;
+        text += "\n" + pgnTag(game, "White") + " - " + pgnTag(game, "Black") + "  " + pgnTag(game, "Result");
+        string date = pgnTag(game, "Date");
+        if (!date.empty()) text += "  " + date.substr(0, 4);
+    }
+
+    cachedKey = gamePos.key;
+    cachedText = text;
+    return text;
+}
+
+// ========== LOW-POWER RENDERING ==========
+
+// Renders squares and coordinate labels once, at the on-screen pixel size so text stays sharp
+void buildBoardLayer(const RenderWindow& window, const View& view) {
+    FloatRect viewport = view.getViewport();
+    unsigned width = max(1u, unsigned(window.getSize().x * viewport.width));
+    unsigned height = max(1u, unsigned(window.getSize().y * viewport.height));
+    if (!boardLayer.create(width, height)) return;
+
+    boardLayer.setView(View(FloatRect(0.f, 0.f, VIRTUAL_WIDTH, VIRTUAL_HEIGHT)));
+    boardLayer.clear(Color::Black);
+    RectangleShape square(Vector2f(squareSize, squareSize));
+    for (int i = 0; i < boardSize; ++i) {
+        for (int j = 0; j < boardSize; ++j) {
+            square.setFillColor((i + j) % 2 == 0 ? lightSquareColor : darkSquareColor);
+            square.setPosition(j * squareSize + LABEL_MARGIN, i * squareSize + LABEL_MARGIN);
+            boardLayer.draw(square);
+        }
+    }
+    drawCellReferences(boardLayer);
+    boardLayer.display();
+
+    boardLayerSprite.setTexture(boardLayer.getTexture(), true);
+    boardLayerSprite.setScale(VIRTUAL_WIDTH / width, VIRTUAL_HEIGHT / height);
+}
+
+void appendQuad(VertexArray& vertices, float x, float y, float w, float h, Color color,
+    FloatRect texRect = FloatRect()) {
+    Vertex corners[4] = {
+        Vertex(Vector2f(x, y), color, Vector2f(texRect.left, texRect.top)),
+        Vertex(Vector2f(x + w, y), color, Vector2f(texRect.left + texRect.width, texRect.top)),
+        Vertex(Vector2f(x + w, y + h), color, Vector2f(texRect.left + texRect.width, texRect.top + texRect.height)),
+        Vertex(Vector2f(x, y + h), color, Vector2f(texRect.left, texRect.top + texRect.height))
+    };
+    const int order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int i : order) vertices.append(corners[i]);
+}
+
+void appendDot(VertexArray& vertices, float cx, float cy, float radius, Color color) {
+    const int segments = 24;
+    for (int i = 0; i < segments; i++) {
+        float a0 = 2 * 3.14159265f * i / segments, a1 = 2 * 3.14159265f * (i + 1) / segments;
+        vertices.append(Vertex(Vector2f(cx, cy), color));
+        vertices.append(Vertex(Vector2f(cx + radius * cos(a0), cy + radius * sin(a0)), color));
+        vertices.append(Vertex(Vector2f(cx + radius * cos(a1), cy + radius * sin(a1)), color));
+    }
+}
+
+// Rebuilds highlights, piece batch and status texts after a state change.
+// The vertex arrays keep their capacity, so this does not allocate once warm.
+void rebuildFrameCache() {
+    overlayVertices.clear();
+    pieceVertices.clear();
+    const Color selectedColor(200, 200, 118);  // highlightColor blended over black, as drawBoard shows it
+    const Color lastMoveColor(100, 200, 255, 100);
+    const Color checkColor(255, 100, 100, 150);
+    const MoveRecord* last = lastRecord(history);
+
+    for (int i = 0; i < boardSize; ++i) {
+        for (int j = 0; j < boardSize; ++j) {
+            float x = j * squareSize + LABEL_MARGIN, y = i * squareSize + LABEL_MARGIN;
+            if (i == selectedRow && j == selectedCol) appendQuad(overlayVertices, x, y, squareSize, squareSize, selectedColor);
+            if (last && (squareOf(i, j) == moveFrom(last->move) || squareOf(i, j) == moveTo(last->move))) {
+                appendQuad(overlayVertices, x, y, squareSize, squareSize, lastMoveColor);
+            }
+            if ((whiteInCheck && i == whiteKingRow && j == whiteKingCol) ||
+                (blackInCheck && i == blackKingRow && j == blackKingCol)) {
+                appendQuad(overlayVertices, x, y, squareSize, squareSize, checkColor);
+            }
+            if (highlightMovesArr[i][j]) {
+                if (board[i][j] != NONE) {
+                    // Capture box: a 4px outline just inside the square
+                    float inner = squareSize - 6, t = 4;
+                    appendQuad(overlayVertices, x + 3 - t, y + 3 - t, inner + 2 * t, t, captureColor);
+                    appendQuad(overlayVertices, x + 3 - t, y + 3 + inner, inner + 2 * t, t, captureColor);
+                    appendQuad(overlayVertices, x + 3 - t, y + 3, t, inner, captureColor);
+                    appendQuad(overlayVertices, x + 3 + inner, y + 3, t, inner, captureColor);
                 }
+                else {
+                    appendDot(overlayVertices, x + squareSize / 2.f, y + squareSize / 2.f, squareSize / 8.f, moveDotColor);
+                }
+            }
+
+            if (board[i][j] != NONE) {
+                const IntRect& rect = pieceAtlasRects[board[i][j] - 1];
+                float scale = (squareSize * 0.8f) / std::max(rect.width, rect.height);
+                float w = rect.width * scale, h = rect.height * scale;
+                appendQuad(pieceVertices, x + (squareSize - w) / 2.f, y + (squareSize - h) / 2.f, w, h, Color::White,
+                    FloatRect(float(rect.left), float(rect.top), float(rect.width), float(rect.height)));
             }
         }
     }
-    return false;
+    updateStatusTexts();
+}
+
+void drawCachedFrame(RenderWindow& window) {
+    window.clear(Color::Black);
+    window.draw(boardLayerSprite);
+    window.draw(overlayVertices);
+    window.draw(pieceVertices, RenderStates(&pieceAtlas));
+    if (globalFont.getInfo().family == "") return;
+    window.draw(statusText);
+    if (!gameOver) {
+        window.draw(controlsText);
+        window.draw(audioText);
+    }
+    if (clockEnabled) window.draw(clockText);
+    window.draw(historyText);
+    if (analysisMode) window.draw(analysisText);
+    if (indexedGamesEnabled) window.draw(gamesText);
+}
+
+// Once a second, how many heap allocations the frames drawn in that second
+// made. Frames where nothing changed should not allocate at all.
+void reportFrameAllocations(uint64_t allocations) {
+    static Clock reportClock;
+    static uint64_t frames = 0, total = 0;
+    if (!allocationReport) return;
+    frames++;
+    total += allocations;
+    if (reportClock.getElapsedTime().asSeconds() < 1.f) return;
+    LOG(LOG_INFO, "Rendered " << frames << " frames, " << total << " heap allocations");
+    frames = total = 0;
+    reportClock.restart();
 }
 
-bool isCheckmate(bool forWhite) {
-    bool inCheck = isInCheck(forWhite);
-    bool hasMoves = hasValidMoves(forWhite);
-    cout << "Checkmate check: forWhite=" << forWhite << " inCheck=" << inCheck << " hasMoves=" << hasMoves << endl;
-    return inCheck && !hasMoves;
+// Counters and phase timings from core/instrument.h, refreshed twice a second
+bool instrumentationOverlayDue() {
+    return instrumentationOverlay && instrumentRefreshClock.getElapsedTime().asMilliseconds() >= INSTRUMENT_REFRESH_MS;
 }
 
-bool isStalemate(bool forWhite) {
-    return !isInCheck(forWhite) && !hasValidMoves(forWhite);
-}
\ No newline at end of file
+void drawInstrumentationOverlay(RenderWindow& window) {
+    static bool refreshed = false;
+    if (!instrumentationOverlay || globalFont.getInfo().family == "") return;
+    if (!refreshed || instrumentationOverlayDue()) {
+        ostringstream text;
+        if (!CHESS_INSTRUMENT) text << "Instrumentation compiled out (NDEBUG)";
+        for (int i = 0; CHESS_INSTRUMENT && i < COUNTER_COUNT; i++) {
+            text << counterNames[i] << ": " << counterTotal(Counter(i)) << "\n";
+        }
+        for (int p = 0; CHESS_INSTRUMENT && p < PHASE_COUNT; p++) {
+            PhaseSummary summary = phaseSummary(Phase(p));
+            text << phaseNames[p] << ": " << summary.count << " x, p50 " << summary.p50Ns / 1000.0
+                 << " us, p99 " << summary.p99Ns / 1000.0 << " us, max " << summary.maxNs / 1000.0 << " us\n";
+        }
+        instrumentText.setString(text.str());
+        instrumentText.setCharacterSize(14);
+        instrumentText.setFillColor(Color::Yellow);
+        instrumentText.setPosition(LABEL_MARGIN + 8, LABEL_MARGIN + 8);
+        instrumentRefreshClock.restart();
+        refreshed = true;
+    }
+    window.draw(instrumentText);
+}
+
+// ========== CHESS CLOCK ==========
+
+int64_t clockTimeLeft(bool white) {
+    int64_t left = clockRemainingMs[white ? 0 : 1];
+    if (clockEnabled && !gameOver && white == whiteTurn) {
+        left -= turnClock.getElapsedTime().asMilliseconds();
+    }
+    return left;
+}
+
+// Charges the side to move for its turn and adds the increment
+void pressClock() {
+    if (!clockEnabled) return;
+    int side = whiteTurn ? 0 : 1;
+    clockRemainingMs[side] -= turnClock.restart().asMilliseconds();
+    clockRemainingMs[side] += CLOCK_INCREMENT_MS;
+}
+
+// m:ss, with tenths of a second when under ten seconds. Writes into a caller
+// buffer so the per-frame clock check does not allocate.
+int formatClock(int64_t ms, char* buffer, size_t size) {
+    if (ms < 0) ms = 0;
+    int seconds = int(ms / 1000);
+    if (ms < 10000) return snprintf(buffer, size, "%d:%02d.%d", seconds / 60, seconds % 60, int(ms / 100 % 10));
+    return snprintf(buffer, size, "%d:%02d", seconds / 60, seconds % 60);
+}
+
+// ========== COMPUTER OPPONENT ==========
+
+bool isComputerTurn() {
+    return computerEnabled && !whiteTurn && !gameOver;
+}
+
+// Runs a search on pos in the background. A ponder search has no time limit
+// until it is converted by a ponder hit.
+void startEngine(const Position& pos, const vector<uint64_t>& keys, bool ponder) {
+    stopEngine();
+    engine.stop = false;
+    engine.pondering = ponder;
+    SearchLimits limits = moveTimeLimits(COMPUTER_MOVE_MS);
+    if (clockEnabled) {
+        // A ponder search is budgeted for the move it is preparing; the
+        // computer's clock is not running yet
+        ClockState clock;
+        clock.timeLeftMs = ponder ? clockRemainingMs[1] : clockTimeLeft(false);
+        clock.incrementMs = CLOCK_INCREMENT_MS;
+        TimeBudget budget = allocateTime(clock);
+        limits.softMs = budget.softMs;
+        limits.hardMs = budget.hardMs;
+    }
+    engine.onInfo = nullptr;
+    engineThread = thread([pos, keys, limits]() {
+        Position searchPos = pos;
+        engineResult = searchPosition(engine, searchPos, limits, keys);
+        engineMoveReady = true;
+    });
+}
+
+void stopEngine() {
+    engine.stop = true;
+    if (engineThread.joinable()) engineThread.join();
+    engine.pondering = false;
+    engineMoveReady = false;
+    ponderMove = NO_MOVE;
+}
+
+// Called when the computer is to move. lastMove is the human's move, which
+// either matches the move being pondered (the search simply continues with a
+// time limit) or does not (the ponder search is dropped; its work stays in the
+// transposition table).
+void startComputerTurn(Move lastMove) {
+    if (ponderMove != NO_MOVE && lastMove == ponderMove && engineThread.joinable()) {
+        ponderHits++;
+        ponderMove = NO_MOVE;
+        engine.pondering = false;
+        LOG(LOG_DEBUG, "Ponder hit (" << ponderHits << " hits, " << ponderMisses << " misses)");
+        return;
+    }
+    if (ponderMove != NO_MOVE) ponderMisses++;
+    stopEngine();
+
+    Position pos = gamePos;
+    Move bookMove = pickBookMove(openingBook, pos, bookRandom());
+    if (bookMove != NO_MOVE) {
+        engineResult = SearchResult();
+        engineResult.bestMove = bookMove;
+        engineMoveReady = true;
+        return;
+    }
+    vector<uint64_t> keys;
+    historyKeys(history, keys);
+    startEngine(pos, keys, false);
+}
+
+// Called after the computer has moved: search the position after the reply we expect
+void startPondering() {
+    Move expected = engineResult.ponderMove;
+    stopEngine();
+    Position pos = gamePos;
+    Move legal[MOVE_LIST_SIZE];
+    int legalCount = generateLegalMoves(pos, legal);
+    if (expected == NO_MOVE || find(legal, legal + legalCount, expected) == legal + legalCount) return;
+
+    vector<uint64_t> keys;
+    historyKeys(history, keys);
+    keys.push_back(pos.key);
+    UndoInfo undo;
+    makeMove(pos, expected, undo);
+    startEngine(pos, keys, true);
+    ponderMove = expected;
+}
+
+// ========== ANALYSIS ==========
+
+// Restarts the analysis on the position on the board. The search runs until
+// it is stopped and never sets engineMoveReady.
+void startAnalysis() {
+    stopEngine();
+    {
+        lock_guard<mutex> guard(analysisLock);
+        for (SearchInfo& line : analysisLines) line.depth = 0;
+    }
+    analysisChanged = true;
+    if (gameOver) return;
+
+    SearchLimits limits;
+    limits.multiPv = ANALYSIS_LINES;
+    vector<uint64_t> keys;
+    historyKeys(history, keys);
+    engine.stop = false;
+    engine.onInfo = recordAnalysisLine;
+    Position pos = gamePos;
+    engineThread = thread([pos, keys, limits]() {
+        Position searchPos = pos;
+        searchPosition(engine, searchPos, limits, keys);
+    });
+}
+
+// Runs on the search thread for every line of every iteration
+void recordAnalysisLine(const SearchInfo& info) {
+    if (info.line < 1 || info.line > ANALYSIS_LINES) return;
+    lock_guard<mutex> guard(analysisLock);
+    analysisLines[info.line - 1] = info;
+    analysisChanged = true;
+}
+
+void applyComputerMove() {
+    if (engineThread.joinable()) engineThread.join();
+    engineMoveReady = false;
+    Move m = engineResult.bestMove;
+    if (m == NO_MOVE || !isComputerTurn()) return;
+
+    int from = moveFrom(m), to = moveTo(m);
+    int promotionKind = moveFlag(m) == MOVE_PROMOTION ? movePromotion(m) : W_QUEEN;
+    playMove(rowOf(from), colOf(from), rowOf(to), colOf(to), promotionKind);
+}
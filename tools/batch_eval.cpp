@@ -0,0 +1,190 @@
+// Scores positions in bulk for training data (see core/batch.h): static
+// evaluation, legal move count, check status and optionally a shallow search.
+//
+// Usage: batch_eval [--threads N] [--depth N] [--no-moves] [--no-checks] [--packed]
+//                   [--write-packed FILE] [--compare] [-o scores.csv] positions
+//
+// The input holds one FEN or EPD line per position, or with --packed the
+// 36-byte PackedPosition records that --write-packed saves, which load
+// without any parsing. The scores go to -o as CSV, one row per position in
+// input order (blank and # comment lines hold no position). A position that
+// cannot be read still gets its row, with valid 0 and the other columns
+// empty, and an all-zero record in the --write-packed file. --compare also
+// scores every position one at a time through evaluate(), countLegalMoves()
+// and checkers(), checks that both agree and reports the speedup of the batch
+// (not with --depth, whose searches only the batch runs).
+
+#include "../core/batch.h"
+#include "../core/epd.h"
+#include "../core/eval.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: batch_eval [--threads N] [--depth N] [--no-moves] [--no-checks] [--packed]" << endl;
+    cerr << "                  [--write-packed FILE] [--compare] [-o scores.csv] positions" << endl;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static bool readFens(const string& path, vector<string>& fens) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty() && line[0] != '#') fens.push_back(lineToFen(line));
+    }
+    return true;
+}
+
+static bool readPacked(const string& path, vector<PackedPosition>& packed) {
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) return false;
+    size_t bytes = size_t(in.tellg());
+    packed.resize(bytes / sizeof(PackedPosition));
+    in.seekg(0);
+    return bool(in.read(reinterpret_cast<char*>(packed.data()), packed.size() * sizeof(PackedPosition)));
+}
+
+// One position at a time through the single-position functions
+static bool compareOneByOne(const PositionBatch& batch, const BatchOptions& options, double batchSeconds) {
+    auto start = chrono::steady_clock::now();
+    size_t mismatches = 0;
+    for (size_t i = 0; i < batch.count; i++) {
+        if (!batch.valid[i]) continue;
+        Position pos;
+        batchGetPosition(batch, i, pos);
+        int score = evaluate(pos);
+        int moves = options.legalMoves ? countLegalMoves(pos) : 0;
+        bool check = options.checks && checkers(pos) != 0;
+        if (score != batch.evaluations[i] || (options.legalMoves && moves != batch.legalMoves[i]) ||
+            (options.checks && check != (batch.inCheck[i] != 0))) {
+            if (mismatches++ < 5) cerr << "Mismatch at position " << i << ": " << toFen(pos) << endl;
+        }
+    }
+    double seconds = secondsSince(start);
+    char line[200];
+    // The batch time includes the searches, which are not repeated here
+    if (options.searchDepth > 0) {
+        snprintf(line, sizeof(line), "One at a time (without searches): %.3f s, %.0f positions/s; %zu mismatches",
+            seconds, batch.count / max(seconds, 1e-9), mismatches);
+    }
+    else {
+        snprintf(line, sizeof(line), "One at a time: %.3f s, %.0f positions/s; batch speedup %.2f, %zu mismatches",
+            seconds, batch.count / max(seconds, 1e-9), seconds / max(batchSeconds, 1e-9), mismatches);
+    }
+    cout << line << endl;
+    return mismatches == 0;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    BatchOptions options;
+    bool packedInput = false, compare = false;
+    string input, output, packedOutput;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--depth" && i + 1 < argc) options.searchDepth = max(0, atoi(argv[++i]));
+        else if (arg == "--no-moves") options.legalMoves = false;
+        else if (arg == "--no-checks") options.checks = false;
+        else if (arg == "--packed") packedInput = true;
+        else if (arg == "--write-packed" && i + 1 < argc) packedOutput = argv[++i];
+        else if (arg == "--compare") compare = true;
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 1; }
+        else input = arg;
+    }
+    if (input.empty()) {
+        usage();
+        return 1;
+    }
+
+    BatchEvaluator evaluator;
+    startBatchEvaluator(evaluator, threads, options);
+
+    // Loading is parallel too; FEN parsing is the slow part of it
+    auto start = chrono::steady_clock::now();
+    vector<string> fens;
+    vector<PackedPosition> packed;
+    if (packedInput ? !readPacked(input, packed) : !readFens(input, fens)) {
+        cerr << "Cannot read " << input << endl;
+        return 1;
+    }
+    PositionBatch batch;
+    batchResize(batch, packedInput ? packed.size() : fens.size());
+    parallelFor(evaluator.pool, batch.count, [&](size_t i, int) {
+        if (packedInput) batchSetPacked(batch, i, packed[i]);
+        else batchSetFen(batch, i, fens[i]);
+    });
+    double loadSeconds = secondsSince(start);
+    size_t invalid = 0;
+    for (size_t i = 0; i < batch.count; i++) invalid += !batch.valid[i];
+
+    start = chrono::steady_clock::now();
+    evaluateBatch(evaluator, batch);
+    double seconds = secondsSince(start);
+
+    char line[200];
+    snprintf(line, sizeof(line), "%zu positions (%zu unreadable) loaded in %.3f s; scored in %.3f s, %.0f positions/s on %d threads",
+        batch.count, invalid, loadSeconds, seconds, batch.count / max(seconds, 1e-9), poolWorkers(evaluator.pool));
+    cout << line << endl;
+
+    bool ok = true;
+    if (compare) ok = compareOneByOne(batch, options, seconds);
+
+    if (!packedOutput.empty()) {
+        ofstream out(packedOutput, ios::binary);
+        for (size_t i = 0; i < batch.count; i++) {
+            // A record without kings, which unpacks as invalid again
+            PackedPosition record = {};
+            if (batch.valid[i]) {
+                Position pos;
+                batchGetPosition(batch, i, pos);
+                record = packPosition(pos);
+            }
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        if (!out) {
+            cerr << "Cannot write " << packedOutput << endl;
+            ok = false;
+        }
+    }
+
+    if (!output.empty()) {
+        ofstream out(output);
+        out << "fen,valid,eval,legal_moves,in_check,search_score\n";
+        for (size_t i = 0; i < batch.count; i++) {
+            if (!batch.valid[i]) {
+                out << ",0,,,,\n";
+                continue;
+            }
+            // FEN input is written back as read, keeping its move numbers
+            string fen = packedInput ? "" : fens[i];
+            if (packedInput) {
+                Position pos;
+                batchGetPosition(batch, i, pos);
+                fen = toFen(pos);
+            }
+            out << fen << ",1," << batch.evaluations[i] << "," << batch.legalMoves[i] << ","
+                << int(batch.inCheck[i]) << "," << batch.searchScores[i] << "\n";
+        }
+        if (!out) {
+            cerr << "Cannot write " << output << endl;
+            ok = false;
+        }
+    }
+    stopBatchEvaluator(evaluator);
+    return ok ? 0 : 1;
+}
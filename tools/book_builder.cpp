@@ -0,0 +1,111 @@
+// Compiles an opening book from one or more PGN files.
+//
+// Usage: book_builder [--max-ply N] [--min-games N] -o book.bin games.pgn [more.pgn ...]
+//
+// Every position in the first max-ply half-moves of each game contributes its
+// move. A move scores 2 points for a win, 1 for a draw and 0 for a loss from
+// the mover's side; the weight of a book move is its total score.
+
+#include "../core/book.h"
+#include "../core/pgn.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct MoveStat {
+    Move move;
+    uint32_t games;
+    uint32_t points;
+};
+
+static void usage() {
+    cerr << "Usage: book_builder [--max-ply N] [--min-games N] -o book.bin games.pgn [more.pgn ...]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int maxPly = 24;
+    uint32_t minGames = 2;
+    string output;
+    vector<string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--max-ply" && i + 1 < argc) maxPly = stoi(argv[++i]);
+        else if (arg == "--min-games" && i + 1 < argc) minGames = uint32_t(stoul(argv[++i]));
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 1; }
+        else inputs.push_back(arg);
+    }
+    if (output.empty() || inputs.empty()) {
+        usage();
+        return 1;
+    }
+
+    unordered_map<uint64_t, vector<MoveStat>> stats;
+    uint64_t gamesRead = 0, gamesSkipped = 0;
+
+    for (const string& input : inputs) {
+        ifstream in(input);
+        if (!in) {
+            cerr << "Cannot open " << input << endl;
+            return 1;
+        }
+        PgnGame game;
+        while (readPgnGame(in, game)) {
+            Position pos;
+            if (game.result == RESULT_UNKNOWN || !pgnStartPosition(game, pos)) {
+                gamesSkipped++;
+                continue;
+            }
+            gamesRead++;
+            int plies = min<int>(maxPly, int(game.moves.size()));
+            for (int ply = 0; ply < plies; ply++) {
+                Move m = parseSanMove(pos, game.moves[ply]);
+                if (m == NO_MOVE) {
+                    cerr << "Illegal move '" << game.moves[ply] << "' in game " << gamesRead << ", skipping rest" << endl;
+                    break;
+                }
+                uint32_t points = 1;
+                if (game.result == RESULT_WHITE_WINS) points = pos.whiteToMove ? 2 : 0;
+                else if (game.result == RESULT_BLACK_WINS) points = pos.whiteToMove ? 0 : 2;
+
+                vector<MoveStat>& moves = stats[pos.key];
+                auto it = find_if(moves.begin(), moves.end(), [m](const MoveStat& s) { return s.move == m; });
+                if (it == moves.end()) moves.push_back({ m, 1, points });
+                else { it->games++; it->points += points; }
+
+                UndoInfo undo;
+                makeMove(pos, m, undo);
+            }
+        }
+    }
+
+    // Scale weights into 16 bits if the most popular move would overflow
+    uint32_t maxPoints = 1;
+    for (const auto& entry : stats)
+        for (const MoveStat& s : entry.second) if (s.games >= minGames) maxPoints = max(maxPoints, s.points);
+    double scale = maxPoints > 65535 ? 65535.0 / maxPoints : 1.0;
+
+    vector<BookEntry> entries;
+    for (const auto& entry : stats) {
+        for (const MoveStat& s : entry.second) {
+            if (s.games < minGames) continue;
+            entries.push_back({ entry.first, s.move, uint16_t(s.points * scale), s.games });
+        }
+    }
+
+    if (!writeBook(output, entries)) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+    cout << "Games read: " << gamesRead << " (skipped " << gamesSkipped << ")" << endl;
+    cout << "Positions: " << stats.size() << ", book entries: " << entries.size() << endl;
+    cout << "Book written to " << output << endl;
+    return 0;
+}
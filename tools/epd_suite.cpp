@@ -0,0 +1,298 @@
+// Runs the engine over EPD test suites (core/epd.h) and reports how many
+// positions it solves, how long it takes to find the solutions and how fast
+// it searches, optionally against a baseline saved by an earlier run.
+//
+// Usage: epd_suite [--threads N] [--movetime MS | --depth N] [--hash MB]
+//                  [--baseline FILE] [--save FILE] [--min-solved N] [--quiet] suite.epd ...
+//
+// Every position is searched for --movetime (default 1000 ms) or to --depth
+// by its own search from an empty table of --hash MB (default 16), spread
+// over --threads workers (all cores by default). The time to solution is the
+// time of the iteration after which the best move stayed a solving one. With
+// fixed time per position, more threads than cores means less search per
+// position, so fixed-time results compare only between runs on the same
+// number of cores; nodes per second are given per thread for the same reason.
+// --save writes each position's result to FILE; --baseline reads such a file
+// and lists the positions solved or missed since, with the changes in solve
+// count, time to solution and speed. With --min-solved the exit status is 1
+// when fewer than N positions are solved, so a fixed-depth run can serve as
+// a regression test.
+
+#include "../core/epd.h"
+#include "../core/search.h"
+#include "../core/threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: epd_suite [--threads N] [--movetime MS | --depth N] [--hash MB]" << endl;
+    cerr << "                 [--baseline FILE] [--save FILE] [--min-solved N] [--quiet] suite.epd ..." << endl;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+struct SuiteResult {
+    string key;             // the position's id, or its FEN without one
+    bool solved = false;
+    int64_t solveMs = -1;   // time to solution, -1 if not solved
+    int depth = 0;
+    uint64_t nodes = 0;
+    int64_t searchMs = 0;
+    string move = "-";      // SAN
+};
+
+struct SuiteTotals {
+    int positions = 0;
+    int solved = 0;
+    int64_t solveMs = 0;    // summed over the solved positions
+    uint64_t nodes = 0;
+    int64_t searchMs = 0;
+};
+
+static SuiteTotals sumResults(const vector<const SuiteResult*>& results) {
+    SuiteTotals totals;
+    for (const SuiteResult* result : results) {
+        totals.positions++;
+        totals.nodes += result->nodes;
+        totals.searchMs += result->searchMs;
+        if (!result->solved) continue;
+        totals.solved++;
+        totals.solveMs += result->solveMs;
+    }
+    return totals;
+}
+
+static double averageSolveMs(const SuiteTotals& totals) {
+    return totals.solved ? double(totals.solveMs) / totals.solved : 0;
+}
+
+static double nodesPerSecond(const SuiteTotals& totals) {
+    return totals.searchMs > 0 ? totals.nodes * 1000.0 / totals.searchMs : 0;
+}
+
+// ========== BASELINE FILES ==========
+// A comment line with the settings, then one tab-separated line per position:
+// key, solved (0/1), time to solution, depth, nodes, search time, move.
+
+static bool saveResults(const string& path, const string& settings, const vector<SuiteResult>& results) {
+    ofstream out(path);
+    if (!out) return false;
+    out << "# epd_suite " << settings << "\n";
+    for (const SuiteResult& result : results) {
+        out << result.key << "\t" << (result.solved ? 1 : 0) << "\t" << result.solveMs << "\t" << result.depth
+            << "\t" << result.nodes << "\t" << result.searchMs << "\t" << result.move << "\n";
+    }
+    return bool(out);
+}
+
+static bool loadResults(const string& path, string& settings, map<string, SuiteResult>& results) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.compare(0, 12, "# epd_suite ") == 0) {
+            settings = line.substr(12);
+            continue;
+        }
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        SuiteResult result;
+        string solved;
+        if (!getline(fields, result.key, '\t') || !getline(fields, solved, '\t')) continue;
+        if (!(fields >> result.solveMs >> result.depth >> result.nodes >> result.searchMs >> result.move)) continue;
+        result.solved = solved == "1";
+        results[result.key] = result;
+    }
+    return true;
+}
+
+// ========== MAIN ==========
+
+int main(int argc, char* argv[]) {
+    int threads = 0;
+    int64_t movetime = 1000;
+    int depth = 0;
+    size_t hashMb = 16;
+    string baselinePath, savePath;
+    bool quiet = false;
+    int minSolved = 0;
+    vector<string> suites;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--movetime" && i + 1 < argc) movetime = atoll(argv[++i]);
+        else if (arg == "--depth" && i + 1 < argc) depth = atoi(argv[++i]);
+        else if (arg == "--hash" && i + 1 < argc) hashMb = size_t(max(1, atoi(argv[++i])));
+        else if (arg == "--baseline" && i + 1 < argc) baselinePath = argv[++i];
+        else if (arg == "--save" && i + 1 < argc) savePath = argv[++i];
+        else if (arg == "--min-solved" && i + 1 < argc) minSolved = atoi(argv[++i]);
+        else if (arg == "--quiet") quiet = true;
+        else if (!arg.empty() && arg[0] != '-') suites.push_back(arg);
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (suites.empty() || (depth <= 0 && movetime <= 0)) {
+        usage();
+        return 1;
+    }
+
+    vector<EpdPosition> positions;
+    for (const string& suite : suites) {
+        size_t before = positions.size();
+        if (!readEpdFile(suite, positions)) {
+            cerr << "Cannot read " << suite << endl;
+            return 1;
+        }
+        cout << suite << ": " << positions.size() - before << " positions" << endl;
+    }
+    if (positions.empty()) {
+        cerr << "No positions with bm or am" << endl;
+        return 1;
+    }
+
+    ThreadPool pool;
+    startThreadPool(pool, threads);
+    vector<unique_ptr<Search>> searches;
+    for (int i = 0; i < poolWorkers(pool); i++) {
+        searches.emplace_back(new Search);
+        initSearch(*searches.back(), hashMb);
+    }
+    SearchLimits limits = depth > 0 ? SearchLimits() : moveTimeLimits(movetime);
+    if (depth > 0) limits.depth = depth;
+    string settings = depth > 0 ? "depth " + to_string(depth) : "movetime " + to_string(movetime);
+    cout << "Searching " << positions.size() << " positions, " << settings << ", "
+         << poolWorkers(pool) << " threads" << endl;
+
+    vector<SuiteResult> results(positions.size());
+    vector<uint64_t> noHistory;
+    auto start = chrono::steady_clock::now();
+    parallelFor(pool, positions.size(), [&](size_t index, int worker) {
+        const EpdPosition& epd = positions[index];
+        SuiteResult& result = results[index];
+        result.key = epd.id.empty() ? epd.fen : epd.id;
+        Position pos, root;
+        if (!setFromFen(pos, epd.fen)) return;
+        root = pos;
+
+        // The best move of each finished iteration; the solution counts from
+        // the last time it changed to a solving move
+        Search& search = *searches[worker];
+        search.onInfo = [&](const SearchInfo& info) {
+            if (info.line != 1 || info.pv.size() == 0) return;
+            if (!epdSolved(root, epd, info.pv.moves[0])) result.solveMs = -1;
+            else if (result.solveMs < 0) result.solveMs = info.timeMs;
+        };
+        newGame(search);
+        search.stop = false;
+        auto positionStart = chrono::steady_clock::now();
+        SearchResult found = searchPosition(search, pos, limits, noHistory);
+        result.searchMs = int64_t(secondsSince(positionStart) * 1000);
+        search.onInfo = nullptr;
+
+        result.depth = found.depth;
+        result.nodes = found.nodes;
+        if (found.bestMove != NO_MOVE) result.move = moveToSan(root, found.bestMove);
+        result.solved = epdSolved(root, epd, found.bestMove);
+        if (!result.solved) result.solveMs = -1;
+        else if (result.solveMs < 0) result.solveMs = result.searchMs;
+    });
+    double seconds = secondsSince(start);
+    stopThreadPool(pool);
+
+    char line[256];
+    string missed;
+    vector<const SuiteResult*> all;
+    for (size_t i = 0; i < results.size(); i++) {
+        const SuiteResult& result = results[i];
+        all.push_back(&result);
+        if (!result.solved) missed += " " + result.key;
+        if (quiet) continue;
+        snprintf(line, sizeof(line), "  %-20s %-7s %-7s %7s ms  depth %2d %11llu nodes",
+            result.key.substr(0, 20).c_str(), result.solved ? "solved" : "missed", result.move.c_str(),
+            result.solved ? to_string(result.solveMs).c_str() : "-", result.depth,
+            (unsigned long long)result.nodes);
+        cout << line << endl;
+    }
+
+    SuiteTotals totals = sumResults(all);
+    snprintf(line, sizeof(line), "Solved %d/%d (%.1f%%), average time to solution %.0f ms",
+        totals.solved, totals.positions, 100.0 * totals.solved / totals.positions, averageSolveMs(totals));
+    cout << line << endl;
+    snprintf(line, sizeof(line), "%llu nodes in %.2f s: %.0f nodes/s per thread, %.0f nodes/s in all",
+        (unsigned long long)totals.nodes, seconds, nodesPerSecond(totals), totals.nodes / max(seconds, 1e-9));
+    cout << line << endl;
+    if (!missed.empty()) cout << "Missed:" << missed << endl;
+    int status = totals.solved < minSolved ? 1 : 0;
+    if (status) cout << "Fewer than the " << minSolved << " positions required were solved" << endl;
+
+    if (!savePath.empty()) {
+        if (!saveResults(savePath, settings, results)) {
+            cerr << "Cannot write " << savePath << endl;
+            return 1;
+        }
+        cout << "Saved results to " << savePath << endl;
+    }
+
+    if (!baselinePath.empty()) {
+        string baselineSettings;
+        map<string, SuiteResult> baseline;
+        if (!loadResults(baselinePath, baselineSettings, baseline)) {
+            cerr << "Cannot read " << baselinePath << endl;
+            return 1;
+        }
+        if (baselineSettings != settings) {
+            cout << "Warning: baseline was run with " << baselineSettings << ", this run with " << settings << endl;
+        }
+
+        // Compare on the positions in both runs only
+        vector<const SuiteResult*> current, previous, bothSolvedNow, bothSolvedBefore;
+        string gained, lost;
+        for (const SuiteResult& result : results) {
+            auto found = baseline.find(result.key);
+            if (found == baseline.end()) continue;
+            const SuiteResult& before = found->second;
+            current.push_back(&result);
+            previous.push_back(&before);
+            if (result.solved && !before.solved) gained += " " + result.key;
+            if (!result.solved && before.solved) lost += " " + result.key;
+            if (result.solved && before.solved) {
+                bothSolvedNow.push_back(&result);
+                bothSolvedBefore.push_back(&before);
+            }
+        }
+        cout << "Against " << baselinePath << ": " << current.size() << " positions in both" << endl;
+        if (current.empty()) return status;
+
+        SuiteTotals now = sumResults(current), then = sumResults(previous);
+        SuiteTotals solvedNow = sumResults(bothSolvedNow), solvedThen = sumResults(bothSolvedBefore);
+        snprintf(line, sizeof(line), "  solved           %7d -> %7d  (%+d)", then.solved, now.solved, now.solved - then.solved);
+        cout << line << endl;
+        snprintf(line, sizeof(line), "  time to solution %7.0f -> %7.0f ms over the %d solved by both",
+            averageSolveMs(solvedThen), averageSolveMs(solvedNow), solvedNow.solved);
+        cout << line << endl;
+        double npsThen = nodesPerSecond(then), npsNow = nodesPerSecond(now);
+        snprintf(line, sizeof(line), "  nodes/s/thread   %7.0f -> %7.0f  (%+.1f%%)",
+            npsThen, npsNow, npsThen > 0 ? (npsNow / npsThen - 1) * 100 : 0.0);
+        cout << line << endl;
+        if (!gained.empty()) cout << "  Newly solved:" << gained << endl;
+        if (!lost.empty()) cout << "  Newly missed:" << lost << endl;
+    }
+    return status;
+}
@@ -0,0 +1,133 @@
+// Builds and queries the position index of a PGN archive (see core/gameindex.h).
+//
+// Usage: game_index build [--threads N] [--max-ply N] [--memory MB] -o games.idx games.pgn [more.pgn ...]
+//        game_index query [--fen FEN] [--moves "e4 e5 Nf3"] [--limit N] games.idx
+//
+// A query looks up the position given by the FEN (the start position by
+// default) after the SAN moves, and lists the results of all games that
+// reached it and the tags of the first --limit (default 10) of them.
+
+#include "../core/gameindex.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: game_index build [--threads N] [--max-ply N] [--memory MB] -o games.idx games.pgn [more.pgn ...]" << endl;
+    cerr << "       game_index query [--fen FEN] [--moves \"e4 e5 Nf3\"] [--limit N] games.idx" << endl;
+}
+
+static int build(int argc, char* argv[]) {
+    IndexBuildOptions options;
+    string output;
+    vector<string> inputs;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) options.threads = atoi(argv[++i]);
+        else if (arg == "--max-ply" && i + 1 < argc) options.maxPly = atoi(argv[++i]);
+        else if (arg == "--memory" && i + 1 < argc) options.memoryMb = size_t(atoi(argv[++i]));
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 1; }
+        else inputs.push_back(arg);
+    }
+    if (output.empty() || inputs.empty()) {
+        usage();
+        return 1;
+    }
+
+    IndexBuildStats stats;
+    if (!buildGameIndex(inputs, output, options, stats)) {
+        cerr << "Index build failed: " << stats.error << endl;
+        return 1;
+    }
+    char line[200];
+    snprintf(line, sizeof(line), "%llu games (%llu skipped, %llu cut at an illegal move), %llu postings, %llu positions",
+        (unsigned long long)stats.games, (unsigned long long)stats.skipped, (unsigned long long)stats.truncated,
+        (unsigned long long)stats.postings, (unsigned long long)stats.keys);
+    cout << line << endl;
+    snprintf(line, sizeof(line), "Wrote %s: %.1f MB, %.2f bytes per posting, %zu runs, %.2f s, %.0f games/s",
+        output.c_str(), stats.bytes / 1048576.0, double(stats.bytes) / max<uint64_t>(1, stats.postings),
+        stats.runs, stats.seconds, stats.games / max(stats.seconds, 1e-9));
+    cout << line << endl;
+    return 0;
+}
+
+static int query(int argc, char* argv[]) {
+    string fen = START_FEN, moves, path;
+    size_t limit = 10;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--fen" && i + 1 < argc) fen = argv[++i];
+        else if (arg == "--moves" && i + 1 < argc) moves = argv[++i];
+        else if (arg == "--limit" && i + 1 < argc) limit = size_t(atoi(argv[++i]));
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 1; }
+        else path = arg;
+    }
+    if (path.empty()) {
+        usage();
+        return 1;
+    }
+
+    Position pos;
+    if (!setFromFen(pos, fen)) {
+        cerr << "Invalid FEN: " << fen << endl;
+        return 1;
+    }
+    istringstream sans(moves);
+    string san;
+    while (sans >> san) {
+        Move m = parseSanMove(pos, san);
+        if (m == NO_MOVE) {
+            cerr << "Illegal move: " << san << endl;
+            return 1;
+        }
+        UndoInfo undo;
+        makeMove(pos, m, undo);
+    }
+
+    auto start = chrono::steady_clock::now();
+    GameIndex index;
+    if (!openGameIndex(index, path)) {
+        cerr << "Cannot open index " << path << endl;
+        return 1;
+    }
+    vector<uint32_t> ids;
+    uint64_t results[4];
+    uint64_t total = findGames(index, pos.key, ids, limit);
+    countResults(index, pos.key, results);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    char line[200];
+    snprintf(line, sizeof(line), "%llu of %llu games reached %s (+%llu =%llu -%llu, %llu unknown) in %.2f ms",
+        (unsigned long long)total, (unsigned long long)index.header->gameCount, toFen(pos).c_str(),
+        (unsigned long long)results[RESULT_WHITE_WINS], (unsigned long long)results[RESULT_DRAW],
+        (unsigned long long)results[RESULT_BLACK_WINS], (unsigned long long)results[RESULT_UNKNOWN], ms);
+    cout << line << endl;
+    for (uint32_t id : ids) {
+        PgnGame game;
+        cout << "  #" << id << " ";
+        if (!loadIndexedGame(index, path, id, game)) {
+            cout << "(cannot read from " << index.files[index.games[id].file] << ")" << endl;
+            continue;
+        }
+        cout << pgnTag(game, "White") << " - " << pgnTag(game, "Black") << "  " << pgnTag(game, "Result")
+            << "  " << pgnTag(game, "Event") << " " << pgnTag(game, "Date") << endl;
+    }
+    closeGameIndex(index);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string command = argc > 1 ? argv[1] : "";
+    if (command == "build") return build(argc, argv);
+    if (command == "query") return query(argc, argv);
+    usage();
+    return 1;
+}
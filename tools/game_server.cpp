@@ -0,0 +1,255 @@
+// Hosts many concurrent games behind a line-based protocol (see core/server.h).
+//
+// Usage: game_server [--shards N] [--games-per-shard N] [--port N | --stdio]
+//        game_server --bench [--shards N] [--games N] [--clients N] [--moves N]
+//
+// Server mode listens on 127.0.0.1 (one thread per connection) or, with
+// --stdio, answers protocol lines from standard input. Bench mode is a load
+// generator: client threads keep --games games going with random legal moves
+// (and the occasional illegal one), poll the position now and then and report
+// validated moves per second and request latency percentiles.
+
+#include "../core/server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: game_server [--shards N] [--games-per-shard N] [--port N | --stdio]" << endl;
+    cerr << "       game_server --bench [--shards N] [--games N] [--clients N] [--moves N]" << endl;
+}
+
+// ========== LOOPBACK SERVER ==========
+
+static void serveStdio(GameServer& server) {
+    ServerReply reply;
+    string line;
+    while (getline(cin, line)) {
+        if (line == "quit") break;
+        if (!line.empty()) cout << handleServerLine(server, line, reply) << endl;
+    }
+}
+
+#ifndef _WIN32
+
+static void serveConnection(GameServer& server, int fd) {
+    ServerReply reply;
+    string buffer, response;
+    char chunk[4096];
+    for (;;) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) break;
+        buffer.append(chunk, size_t(n));
+        size_t start = 0, end;
+        response.clear();
+        while ((end = buffer.find('\n', start)) != string::npos) {
+            string line = buffer.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) response += handleServerLine(server, line, reply) + "\n";
+            start = end + 1;
+        }
+        buffer.erase(0, start);
+        if (!response.empty() && send(fd, response.data(), response.size(), 0) < 0) break;
+    }
+    close(fd);
+}
+
+static int serveSocket(GameServer& server, int port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        cerr << "Cannot create socket" << endl;
+        return 1;
+    }
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        cerr << "Cannot listen on 127.0.0.1:" << port << endl;
+        close(listener);
+        return 1;
+    }
+    cout << "Listening on 127.0.0.1:" << port << endl;
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        thread(serveConnection, ref(server), fd).detach();
+    }
+}
+
+#else
+
+static int serveSocket(GameServer&, int) {
+    cerr << "Socket mode is only available on POSIX systems, use --stdio or --bench" << endl;
+    return 1;
+}
+
+#endif
+
+// ========== LOAD GENERATOR ==========
+
+struct ClientGame {
+    uint64_t id;
+    Position pos;
+};
+
+struct ClientStats {
+    vector<uint32_t> latencyNs;
+    uint64_t illegal = 0;
+    uint64_t finished = 0;
+};
+
+static bool openClientGame(GameServer& server, ServerReply& reply, ClientGame& game) {
+    if (serverNewGame(server, reply) != STATUS_OK) return false;
+    game.id = reply.gameId;
+    setStartPosition(game.pos);
+    return true;
+}
+
+static void runClient(GameServer& server, vector<ClientGame>& games, uint64_t moves, uint64_t seed, ClientStats& stats) {
+    ServerReply reply;
+    mt19937_64 random(seed);
+    stats.latencyNs.reserve(size_t(moves));
+    Move legal[MOVE_LIST_SIZE];
+
+    for (uint64_t i = 0; i < moves; i++) {
+        ClientGame& game = games[i % games.size()];
+        int count = generateLegalMoves(game.pos, legal);
+        // One request in twenty is an illegal move, which must be rejected
+        bool sendIllegal = random() % 20 == 0;
+        Move m = legal[random() % uint64_t(count)];
+        string uci = sendIllegal ? "a1a1" : moveToUci(m);
+
+        auto start = chrono::steady_clock::now();
+        int status = serverMove(server, game.id, uci.c_str(), reply);
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        stats.latencyNs.push_back(uint32_t(min<int64_t>(ns, UINT32_MAX)));
+
+        if (status == STATUS_ILLEGAL) {
+            stats.illegal++;
+            continue;
+        }
+        if (status != STATUS_OK) {
+            cerr << "Unexpected status " << status << " for game " << game.id << endl;
+            return;
+        }
+        UndoInfo undo;
+        makeMove(game.pos, m, undo);
+        // Clients poll the position now and then, and it must match theirs
+        if (random() % 20 == 0 && (serverState(server, game.id, reply) != STATUS_OK || toFen(game.pos) != reply.fen)) {
+            cerr << "Wrong state for game " << game.id << ": " << reply.fen << endl;
+            return;
+        }
+        // Finished and very long games are replaced by fresh ones
+        if (reply.result != GAME_ONGOING || game.pos.fullmoveNumber > 150) {
+            stats.finished++;
+            serverClose(server, game.id, reply);
+            if (!openClientGame(server, reply, game)) return;
+        }
+    }
+}
+
+static uint32_t percentile(const vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    return sorted[min(sorted.size() - 1, size_t(p * double(sorted.size())))];
+}
+
+static int runBench(int shards, int gameCount, int clients, uint64_t moves) {
+    GameServer server;
+    startServer(server, shards, gameCount / shards + 1);
+    clients = max(1, min(clients, gameCount));
+
+    // Each client drives its own share of the games
+    vector<vector<ClientGame>> clientGames(clients);
+    ServerReply reply;
+    for (int i = 0; i < gameCount; i++) {
+        ClientGame game;
+        if (!openClientGame(server, reply, game)) {
+            cerr << "Could not create game " << i << endl;
+            return 1;
+        }
+        clientGames[size_t(i % clients)].push_back(game);
+    }
+    cout << "Games: " << activeGames(server) << " on " << shards << " shards, "
+        << sizeof(ServerGame) << " bytes per game" << endl;
+
+    uint64_t allocationsBefore = serverAllocations(server);
+    vector<ClientStats> stats(clients);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back(runClient, ref(server), ref(clientGames[size_t(c)]), moves / uint64_t(clients),
+            uint64_t(c + 1), ref(stats[size_t(c)]));
+    }
+    for (thread& t : threads) t.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<uint32_t> latencies;
+    uint64_t illegal = 0, finished = 0;
+    for (const ClientStats& s : stats) {
+        latencies.insert(latencies.end(), s.latencyNs.begin(), s.latencyNs.end());
+        illegal += s.illegal;
+        finished += s.finished;
+    }
+    sort(latencies.begin(), latencies.end());
+    uint64_t validated = movesValidated(server);
+    uint64_t allocations = serverAllocations(server) - allocationsBefore;
+
+    cout << "Clients: " << clients << ", requests: " << latencies.size() << " in " << seconds << " s" << endl;
+    cout << "Moves validated: " << validated << " (" << uint64_t(validated / seconds) << " per second), "
+        << illegal << " rejected as illegal, " << finished << " games finished" << endl;
+    cout << "Latency us: p50 " << percentile(latencies, 0.50) / 1000.0 << ", p99 " << percentile(latencies, 0.99) / 1000.0
+        << ", max " << (latencies.empty() ? 0 : latencies.back()) / 1000.0 << endl;
+    cout << "Server heap allocations while playing: " << allocations << endl;
+    stopServer(server);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int shards = max(1, int(thread::hardware_concurrency()));
+    int gamesPerShard = 16384;
+    int port = 7777;
+    bool stdio = false, bench = false;
+    int benchGames = 10000, clients = 8;
+    uint64_t moves = 200000;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--shards" && i + 1 < argc) shards = stoi(argv[++i]);
+        else if (arg == "--games-per-shard" && i + 1 < argc) gamesPerShard = stoi(argv[++i]);
+        else if (arg == "--port" && i + 1 < argc) port = stoi(argv[++i]);
+        else if (arg == "--stdio") stdio = true;
+        else if (arg == "--bench") bench = true;
+        else if (arg == "--games" && i + 1 < argc) benchGames = stoi(argv[++i]);
+        else if (arg == "--clients" && i + 1 < argc) clients = stoi(argv[++i]);
+        else if (arg == "--moves" && i + 1 < argc) moves = stoull(argv[++i]);
+        else { usage(); return 1; }
+    }
+    shards = max(1, min(shards, 256));
+
+    if (bench) return runBench(shards, max(1, benchGames), clients, moves);
+
+    GameServer server;
+    startServer(server, shards, gamesPerShard);
+    int status = 0;
+    if (stdio) serveStdio(server);
+    else status = serveSocket(server, port);
+    stopServer(server);
+    return status;
+}
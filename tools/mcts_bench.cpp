@@ -0,0 +1,223 @@
+// Measures the Monte Carlo tree search (core/mcts.h): playouts per second per
+// core with 1, 2, 4, ... threads, and its strength against the alpha-beta
+// search at the same time per move.
+//
+// Usage: mcts_bench [--threads N] [--playouts N] [--games N] [--movetime MS]
+//                   [--match-threads N] [--hash MB] [--random] [--plies N]
+//
+// The speed runs search every benchmark position for --playouts playouts
+// (default 20000) per thread, doubling the thread count up to --threads (all
+// cores by default). The match plays --games games (default 20, 0 skips it),
+// each opening once with either colour; MCTS uses --match-threads threads
+// (default 1) and alpha-beta one. --random switches to uniformly random
+// playouts of up to --plies plies (default 300) instead of heuristic ones
+// of 8 plies scored by the static evaluation.
+
+#include "../core/mcts.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: mcts_bench [--threads N] [--playouts N] [--games N] [--movetime MS]" << endl;
+    cerr << "                  [--match-threads N] [--hash MB] [--random] [--plies N]" << endl;
+}
+
+// Openings, middlegames and endgames for the speed runs
+static const char* benchFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 3 8",
+    "2r3k1/pp3ppp/2n1b3/3p4/3P4/2NB1N2/PP3PPP/2R3K1 w - - 0 20",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/1q3PPP/3R2K1 b - - 0 30",
+};
+
+// Match openings, a few moves into common lines
+static const char* openingFens[] = {
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R b KQkq - 1 2",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq c6 0 2",
+    "rnbqkb1r/pppppp1p/5np1/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/8/PPP2PPP/RNBQKBNR w KQkq d6 0 3",
+    "rnbqkb1r/pppp1ppp/5n2/4p3/2P5/2N5/PP1PPPPP/R1BQKBNR w KQkq - 2 3",
+    "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+    "rnbqkbnr/pp2pppp/2p5/3p4/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3",
+    "rnbqkb1r/ppp1pppp/5n2/3p4/3P1B2/5N2/PPP1PPPP/RN1QKB1R b KQkq - 2 3",
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq d6 0 2",
+    "rnbqk2r/pppp1ppp/4pn2/8/1bPP4/2N5/PP2PPPP/R1BQKBNR w KQkq - 2 4",
+};
+
+// Games still going after this many plies are scored as draws
+const int MAX_GAME_PLIES = 300;
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// ========== SPEED ==========
+
+static void speedRuns(Mcts& mcts, int maxThreads, uint64_t playouts) {
+    int positions = int(sizeof(benchFens) / sizeof(benchFens[0]));
+    cout << "Playouts over " << positions << " positions, " << playouts << " per thread each" << endl;
+    vector<uint64_t> noHistory;
+    char line[200];
+    double single = 0;
+    for (int threads = 1;; threads = min(maxThreads, threads * 2)) {
+        uint64_t total = 0, nodes = 0;
+        double seconds = 0;
+        bool poolFull = false;
+        for (const char* fen : benchFens) {
+            Position pos;
+            setFromFen(pos, fen);
+            MctsLimits limits;
+            limits.playouts = playouts * uint64_t(threads);
+            limits.threads = threads;
+            mcts.stop = false;
+            MctsResult result = mctsSearch(mcts, pos, limits, noHistory);
+            total += result.playouts;
+            nodes += result.nodes;
+            seconds += result.seconds;
+            poolFull = poolFull || result.poolFull;
+        }
+        double perCore = total / max(seconds, 1e-9) / threads;
+        if (threads == 1) single = perCore;
+        snprintf(line, sizeof(line), "  %2d thread%s %10llu playouts %8.3f s %10.0f playouts/s per core   scaling %5.2f  %6.1f nodes/playout%s",
+            threads, threads == 1 ? " " : "s", (unsigned long long)total, seconds, perCore,
+            perCore * threads / max(single, 1e-9), double(nodes) / max<uint64_t>(1, total), poolFull ? "  (pool full)" : "");
+        cout << line << endl;
+        if (threads == maxThreads) break;
+    }
+}
+
+// ========== MATCH ==========
+
+// Positions before pos, repeated twice, make a threefold repetition
+static bool isThreefold(const vector<uint64_t>& keys, const Position& pos) {
+    int count = int(keys.size()), seen = 0;
+    for (int i = count - 2; i >= max(0, count - pos.halfmoveClock); i -= 2) {
+        if (keys[i] == pos.key && ++seen == 2) return true;
+    }
+    return false;
+}
+
+struct MatchStats {
+    uint64_t playouts = 0, mctsMoves = 0;
+    uint64_t nodes = 0, searchMoves = 0;
+};
+
+// Plays one game; returns 1, 0.5 or 0 points for MCTS
+static double playGame(Mcts& mcts, Search& search, const char* fen, bool mctsWhite,
+    int64_t movetime, int mctsThreads, MatchStats& stats) {
+    Position pos;
+    setFromFen(pos, fen);
+    newGame(search);
+    vector<uint64_t> keys;
+    for (int ply = 0; ply < MAX_GAME_PLIES; ply++) {
+        GameEnd end = gameEnd(pos);
+        if (end == GAME_END_CHECKMATE) return pos.whiteToMove == mctsWhite ? 0.0 : 1.0;
+        if (end == GAME_END_STALEMATE || pos.halfmoveClock >= 100 || isThreefold(keys, pos)) return 0.5;
+        Move m;
+        if (pos.whiteToMove == mctsWhite) {
+            MctsLimits limits;
+            limits.timeMs = movetime;
+            limits.threads = mctsThreads;
+            mcts.stop = false;
+            MctsResult result = mctsSearch(mcts, pos, limits, keys);
+            stats.playouts += result.playouts;
+            stats.mctsMoves++;
+            m = result.bestMove;
+        }
+        else {
+            search.stop = false;
+            SearchResult result = searchPosition(search, pos, moveTimeLimits(movetime), keys);
+            stats.nodes += result.nodes;
+            stats.searchMoves++;
+            m = result.bestMove;
+        }
+        keys.push_back(pos.key);
+        UndoInfo undo;
+        makeMove(pos, m, undo);
+    }
+    return 0.5;
+}
+
+// Elo difference for a score fraction, clamped short of infinity
+static double eloDifference(double score) {
+    score = min(0.99, max(0.01, score));
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+static void match(Mcts& mcts, Search& search, int games, int64_t movetime, int mctsThreads) {
+    cout << "Match: MCTS (" << mctsThreads << " thread" << (mctsThreads == 1 ? "" : "s")
+        << ") against alpha-beta, " << games << " games at " << movetime << " ms per move" << endl;
+    int openings = int(sizeof(openingFens) / sizeof(openingFens[0]));
+    int wins = 0, draws = 0, losses = 0;
+    MatchStats stats;
+    auto start = chrono::steady_clock::now();
+    for (int game = 0; game < games; game++) {
+        bool mctsWhite = game % 2 == 0;
+        double points = playGame(mcts, search, openingFens[(game / 2) % openings], mctsWhite,
+            movetime, mctsThreads, stats);
+        if (points == 1.0) wins++;
+        else if (points == 0.5) draws++;
+        else losses++;
+        cout << "  game " << game + 1 << " (MCTS " << (mctsWhite ? "white" : "black") << "): "
+            << (points == 1.0 ? "win" : points == 0.5 ? "draw" : "loss") << endl;
+    }
+    double score = (wins + 0.5 * draws) / max(1, games);
+    char line[200];
+    snprintf(line, sizeof(line), "  MCTS +%d =%d -%d, score %.1f%%, Elo difference %+.0f, in %.1f s",
+        wins, draws, losses, score * 100, eloDifference(score), secondsSince(start));
+    cout << line << endl;
+    snprintf(line, sizeof(line), "  MCTS %.0f playouts per move, alpha-beta %.0f nodes per move",
+        double(stats.playouts) / max<uint64_t>(1, stats.mctsMoves), double(stats.nodes) / max<uint64_t>(1, stats.searchMoves));
+    cout << line << endl;
+}
+
+// ========== MAIN ==========
+
+int main(int argc, char* argv[]) {
+    int threads = int(thread::hardware_concurrency());
+    uint64_t playouts = 20000;
+    int games = 20;
+    int64_t movetime = 100;
+    int matchThreads = 1;
+    size_t hashMb = 256;
+    MctsSettings settings;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--playouts" && i + 1 < argc) playouts = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--games" && i + 1 < argc) games = atoi(argv[++i]);
+        else if (arg == "--movetime" && i + 1 < argc) movetime = atoll(argv[++i]);
+        else if (arg == "--match-threads" && i + 1 < argc) matchThreads = max(1, atoi(argv[++i]));
+        else if (arg == "--hash" && i + 1 < argc) hashMb = size_t(max(1, atoi(argv[++i])));
+        else if (arg == "--random") settings.heuristicPlayouts = false;
+        else if (arg == "--plies" && i + 1 < argc) settings.playoutPlies = max(0, atoi(argv[++i]));
+        else {
+            usage();
+            return 1;
+        }
+    }
+    threads = max(1, threads);
+    if (!settings.heuristicPlayouts && settings.playoutPlies == MctsSettings().playoutPlies) settings.playoutPlies = MAX_GAME_PLIES;
+
+    Mcts mcts;
+    initMcts(mcts, hashMb);
+    mcts.settings = settings;
+    if (playouts > 0) speedRuns(mcts, threads, playouts);
+    if (games > 0) {
+        Search search;
+        initSearch(search, 64);
+        match(mcts, search, games, movetime, matchThreads);
+    }
+    return 0;
+}
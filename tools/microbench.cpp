@@ -0,0 +1,362 @@
+// Microbenchmarks for the rules core: attack queries, per-piece and full move
+// generation, legal move counting, make/unmake, hashing, FEN and static evaluation.
+//
+// Usage: microbench [--filter TEXT] [--min-time SECONDS] [--format console|json|csv] [-o FILE]
+//
+// Every case runs over the same fixed corpus of positions (openings,
+// middlegames with castling rights and en passant, endgames, promotions), so
+// ns/op is comparable between builds. Passes over the corpus are repeated
+// until a case has run for --min-time. The json format follows Google Benchmark's output schema so
+// existing CI tooling for tracking and comparing results can read it.
+
+#include "../core/eval.h"
+#include "../core/instrument.h"
+#include "../core/position.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: microbench [--filter TEXT] [--min-time SECONDS] [--format console|json|csv] [-o FILE]" << endl;
+}
+
+// ========== CORPUS ==========
+
+static const char* corpusFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+    "rnbqkb1r/pp1p1ppp/4pn2/2pP4/2P5/8/PP2PPPP/RNBQKBNR w KQkq c6 0 4",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 3 8",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PNBPN2/PB3PPP/R2Q1RK1 b - - 1 10",
+    "2r3k1/pp3ppp/2n1b3/3p4/3P4/2NB1N2/PP3PPP/2R3K1 w - - 0 20",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 b - - 0 50",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "6k1/5ppp/8/8/8/8/1q3PPP/3R2K1 b - - 0 30",
+};
+
+// Positions with the side to move in check (single and double checks, en passant evasions)
+static const char* checkFens[] = {
+    "rnbqkbnr/ppp2ppp/8/1B1pp3/4P3/8/PPPP1PPP/RNBQK1NR b KQkq - 1 3",
+    "r1bqkb1r/pppp1Qpp/2n2n2/4p3/2B1P3/8/PPPP1PPP/RNB1K1NR b KQkq - 0 4",
+    "4k3/8/8/2pP4/1K6/8/8/8 w - c6 0 2",
+    "r3k2r/p1pp1pb1/bn2Qnp1/2qPN3/1p2P3/2N5/PPPBBPPP/R3K2R b KQkq - 3 2",
+    "8/8/8/2k5/3Pp3/8/8/4K3 b - d3 0 1",
+    "4k3/4r3/8/8/8/3n4/8/4K3 w - - 0 1",
+};
+
+struct Corpus {
+    vector<string> fens;
+    vector<Position> positions;
+    vector<Position> checkPositions;
+    vector<vector<Move>> legalMoves;    // per position, for make/unmake
+    vector<vector<int>> pawnSquares;    // side to move's pawns, per position
+};
+
+static Corpus buildCorpus() {
+    Corpus corpus;
+    for (const char* fen : corpusFens) {
+        Position pos;
+        if (!setFromFen(pos, fen)) {
+            cerr << "Bad corpus FEN: " << fen << endl;
+            exit(1);
+        }
+        Move moves[MOVE_LIST_SIZE];
+        int n = generateLegalMoves(pos, moves);
+        vector<int> pawns;
+        for (int sq = 0; sq < 64; sq++) {
+            if (pos.board[sq] == colouredPiece(W_PAWN, pos.whiteToMove)) pawns.push_back(sq);
+        }
+        corpus.fens.push_back(fen);
+        corpus.positions.push_back(pos);
+        corpus.legalMoves.push_back(vector<Move>(moves, moves + n));
+        corpus.pawnSquares.push_back(pawns);
+    }
+    for (const char* fen : checkFens) {
+        Position pos;
+        if (!setFromFen(pos, fen) || !inCheck(pos)) {
+            cerr << "Bad check corpus FEN: " << fen << endl;
+            exit(1);
+        }
+        corpus.checkPositions.push_back(pos);
+    }
+    return corpus;
+}
+
+// ========== CASES ==========
+
+// One pass over the corpus. Returns the number of operations performed and
+// folds results into sink so the work cannot be optimised away.
+typedef uint64_t (*BenchFunction)(Corpus& corpus, uint64_t& sink);
+
+struct BenchCase {
+    const char* name;
+    BenchFunction run;
+};
+
+static uint64_t benchAttacked(Corpus& corpus, uint64_t& sink) {
+    uint64_t ops = 0;
+    for (const Position& pos : corpus.positions) {
+        for (int sq = 0; sq < 64; sq++) {
+            sink += isAttacked(pos, sq, true) + 2 * isAttacked(pos, sq, false);
+        }
+        ops += 128;
+    }
+    return ops;
+}
+
+static uint64_t benchPawnMoves(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    uint64_t ops = 0;
+    for (size_t i = 0; i < corpus.positions.size(); i++) {
+        for (int sq : corpus.pawnSquares[i]) sink += generatePieceMoves(corpus.positions[i], sq, moves);
+        ops += corpus.pawnSquares[i].size();
+    }
+    return ops;
+}
+
+static uint64_t benchKingMoves(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    for (const Position& pos : corpus.positions) {
+        sink += generatePieceMoves(pos, pos.kingSquare[pos.whiteToMove ? 0 : 1], moves);
+    }
+    return corpus.positions.size();
+}
+
+static uint64_t benchPseudoLegal(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    for (const Position& pos : corpus.positions) sink += generateMoves(pos, moves);
+    return corpus.positions.size();
+}
+
+static uint64_t benchCaptures(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    for (const Position& pos : corpus.positions) sink += generateCaptures(pos, moves);
+    return corpus.positions.size();
+}
+
+static uint64_t benchQuiets(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    for (const Position& pos : corpus.positions) sink += generateQuiets(pos, moves);
+    return corpus.positions.size();
+}
+
+static uint64_t benchEvasions(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    for (Position& pos : corpus.checkPositions) sink += generateLegalMoves(pos, moves);
+    return corpus.checkPositions.size();
+}
+
+static uint64_t benchLegal(Corpus& corpus, uint64_t& sink) {
+    Move moves[MOVE_LIST_SIZE];
+    for (Position& pos : corpus.positions) sink += generateLegalMoves(pos, moves);
+    return corpus.positions.size();
+}
+
+static uint64_t benchCheckers(Corpus& corpus, uint64_t& sink) {
+    for (const Position& pos : corpus.positions) sink += checkers(pos);
+    for (const Position& pos : corpus.checkPositions) sink += checkers(pos);
+    return corpus.positions.size() + corpus.checkPositions.size();
+}
+
+static uint64_t benchCountLegal(Corpus& corpus, uint64_t& sink) {
+    for (Position& pos : corpus.positions) sink += countLegalMoves(pos);
+    return corpus.positions.size();
+}
+
+static uint64_t benchAnyLegal(Corpus& corpus, uint64_t& sink) {
+    for (Position& pos : corpus.positions) sink += hasAnyLegalMove(pos);
+    return corpus.positions.size();
+}
+
+static uint64_t benchGameEnd(Corpus& corpus, uint64_t& sink) {
+    for (Position& pos : corpus.checkPositions) sink += gameEnd(pos);
+    return corpus.checkPositions.size();
+}
+
+static uint64_t benchMakeUnmake(Corpus& corpus, uint64_t& sink) {
+    uint64_t ops = 0;
+    for (size_t i = 0; i < corpus.positions.size(); i++) {
+        Position& pos = corpus.positions[i];
+        for (Move m : corpus.legalMoves[i]) {
+            UndoInfo undo;
+            makeMove(pos, m, undo);
+            sink += pos.key;
+            unmakeMove(pos, m, undo);
+        }
+        ops += corpus.legalMoves[i].size();
+    }
+    return ops;
+}
+
+static uint64_t benchComputeKey(Corpus& corpus, uint64_t& sink) {
+    for (const Position& pos : corpus.positions) sink += computeKey(pos);
+    return corpus.positions.size();
+}
+
+static uint64_t benchParseFen(Corpus& corpus, uint64_t& sink) {
+    Position pos;
+    for (const string& fen : corpus.fens) {
+        setFromFen(pos, fen);
+        sink += pos.key;
+    }
+    return corpus.fens.size();
+}
+
+static uint64_t benchWriteFen(Corpus& corpus, uint64_t& sink) {
+    for (const Position& pos : corpus.positions) sink += toFen(pos).size();
+    return corpus.positions.size();
+}
+
+static uint64_t benchEvaluate(Corpus& corpus, uint64_t& sink) {
+    for (const Position& pos : corpus.positions) sink += uint64_t(evaluate(pos));
+    return corpus.positions.size();
+}
+
+static const BenchCase benchCases[] = {
+    { "attack/is_attacked", benchAttacked },
+    { "movegen/pawn", benchPawnMoves },
+    { "movegen/king_castling", benchKingMoves },
+    { "movegen/pseudo_legal", benchPseudoLegal },
+    { "movegen/captures", benchCaptures },
+    { "movegen/quiets", benchQuiets },
+    { "movegen/legal", benchLegal },
+    { "movegen/legal_in_check", benchEvasions },
+    { "movegen/count_legal", benchCountLegal },
+    { "movegen/has_any_legal", benchAnyLegal },
+    { "attack/checkers", benchCheckers },
+    { "game_end/in_check", benchGameEnd },
+    { "make_unmake", benchMakeUnmake },
+    { "hash/compute_key", benchComputeKey },
+    { "fen/parse", benchParseFen },
+    { "fen/write", benchWriteFen },
+    { "eval/static", benchEvaluate },
+};
+
+// ========== RUNNER ==========
+
+struct BenchResult {
+    string name;
+    uint64_t iterations;    // operations timed
+    double nsPerOp;
+};
+
+static BenchResult runCase(const BenchCase& bench, Corpus& corpus, double minTime, uint64_t& sink) {
+    bench.run(corpus, sink);    // warm up caches and branch predictors
+    uint64_t passes = 1;
+    for (;;) {
+        uint64_t ops = 0;
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < passes; i++) ops += bench.run(corpus, sink);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (seconds >= minTime || passes >= (uint64_t(1) << 40)) {
+            return { bench.name, ops, ops ? seconds * 1e9 / double(ops) : 0.0 };
+        }
+        // Aim a little past the minimum time, growing by at most 10x per attempt
+        double scale = seconds > 0 ? minTime * 1.4 / seconds : 10.0;
+        passes = uint64_t(double(passes) * (scale < 10.0 ? (scale > 2.0 ? scale : 2.0) : 10.0));
+    }
+}
+
+static void writeConsoleHeader(ostream& out) {
+    out << "Benchmark                       ns/op      Iterations" << endl;
+    out << "-----------------------------------------------------" << endl;
+}
+
+static void writeConsoleLine(ostream& out, const BenchResult& r) {
+    char line[128];
+    snprintf(line, sizeof(line), "%-26s %10.2f %15llu", r.name.c_str(), r.nsPerOp, (unsigned long long)r.iterations);
+    out << line << endl;
+}
+
+static void writeJson(ostream& out, const vector<BenchResult>& results) {
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+#ifdef NDEBUG
+    const char* buildType = "release";
+#else
+    const char* buildType = "debug";
+#endif
+    out << "{\n  \"context\": {\n";
+    out << "    \"date\": \"" << date << "\",\n";
+    out << "    \"executable\": \"microbench\",\n";
+    out << "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n";
+    out << "    \"library_build_type\": \"" << buildType << "\",\n";
+    out << "    \"instrumentation\": " << (CHESS_INSTRUMENT ? "true" : "false") << ",\n";
+    out << "    \"corpus_positions\": " << sizeof(corpusFens) / sizeof(corpusFens[0]) << "\n";
+    out << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"run_type\": \"iteration\""
+            << ", \"iterations\": " << r.iterations << ", \"real_time\": " << r.nsPerOp
+            << ", \"cpu_time\": " << r.nsPerOp << ", \"time_unit\": \"ns\"}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void writeCsv(ostream& out, const vector<BenchResult>& results) {
+    out << "name,iterations,ns_per_op" << endl;
+    for (const BenchResult& r : results) out << r.name << "," << r.iterations << "," << r.nsPerOp << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string filter, format = "console", outputFile;
+    double minTime = 0.5;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc) minTime = atof(argv[++i]);
+        else if (arg == "--format" && i + 1 < argc) format = argv[++i];
+        else if (arg == "-o" && i + 1 < argc) outputFile = argv[++i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (format != "console" && format != "json" && format != "csv") {
+        usage();
+        return 1;
+    }
+    if (CHESS_INSTRUMENT) {
+        cerr << "Warning: instrumentation is compiled in; build with -DNDEBUG for representative timings" << endl;
+    }
+
+    ofstream file;
+    if (!outputFile.empty()) {
+        file.open(outputFile);
+        if (!file) {
+            cerr << "Cannot write " << outputFile << endl;
+            return 1;
+        }
+    }
+    ostream& out = outputFile.empty() ? cout : file;
+
+    // Console results are printed as each case finishes; the other formats at the end
+    Corpus corpus = buildCorpus();
+    vector<BenchResult> results;
+    uint64_t sink = 0;
+    if (format == "console") writeConsoleHeader(out);
+    for (const BenchCase& bench : benchCases) {
+        if (!filter.empty() && strstr(bench.name, filter.c_str()) == nullptr) continue;
+        results.push_back(runCase(bench, corpus, minTime, sink));
+        if (format == "console") writeConsoleLine(out, results.back());
+    }
+    if (format == "json") writeJson(out, results);
+    else if (format == "csv") writeCsv(out, results);
+    // Printing the checksum keeps every case's work observable to the optimiser
+    if (format == "console") out << "checksum " << sink << endl;
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+// Parallel perft for move generator validation (see core/perft.h).
+//
+// Usage: perft [options] DEPTH [--fen FEN]       one position, optionally with --divide
+//        perft [options] --suite FILE            every position of a perft suite
+//        perft [options] --random N [--depth D]  stress test over N random positions
+// Options: --threads N (default: all cores), --hash MB (default 64, 0 = off),
+//          --max-depth N (cap suite depths), --seed S, --scaling
+//
+// Suite files use the usual "FEN ;D1 20 ;D2 400" format and report every
+// position whose count differs. Random mode plays random games to collect
+// positions, checks generator invariants on each (FEN round trip, incremental
+// hash, captures + quiets = all moves, evasions, make/unmake), and counts
+// them all in one batch twice, with and without the hash table, comparing
+// the results. --scaling repeats the run with 1, 2, 4 ... threads.
+
+#include "../core/perft.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: perft [options] DEPTH [--fen FEN] [--divide]" << endl;
+    cerr << "       perft [options] --suite FILE [--max-depth N]" << endl;
+    cerr << "       perft [options] --random N [--depth D] [--seed S]" << endl;
+    cerr << "Options: --threads N  --hash MB  --scaling" << endl;
+}
+
+static void printStats(const char* label, const PerftStats& stats, int threads) {
+    char line[200];
+    snprintf(line, sizeof(line), "%s: %llu nodes in %.3f s, %.1f Mnps, %d threads, %zu tasks, %llu steals, %llu hash hits",
+        label, (unsigned long long)stats.nodes, stats.seconds, stats.nodes / max(stats.seconds, 1e-9) / 1e6,
+        threads, stats.tasks, (unsigned long long)stats.steals, (unsigned long long)stats.hashHits);
+    cout << line << endl;
+}
+
+// ========== RANDOM POSITION STRESS TEST ==========
+
+static bool sameMoves(Move* a, int na, Move* b, int nb) {
+    sort(a, a + na);
+    sort(b, b + nb);
+    return na == nb && equal(a, a + na, b);
+}
+
+// Generator invariants that must hold in every position. Returns an empty string or the failure.
+static string checkInvariants(Position& pos) {
+    Position copy;
+    if (!setFromFen(copy, toFen(pos)) || toFen(copy) != toFen(pos)) return "FEN round trip";
+    if (pos.key != computeKey(pos)) return "incremental hash key";
+
+    Move all[MOVE_LIST_SIZE], captures[MOVE_LIST_SIZE], legal[MOVE_LIST_SIZE], filtered[MOVE_LIST_SIZE];
+    int allCount = generateMoves(pos, all);
+    int captureCount = generateCaptures(pos, captures);
+    int quietCount = generateQuiets(pos, captures + captureCount);
+    Move allCopy[MOVE_LIST_SIZE];
+    copy_n(all, allCount, allCopy);
+    if (!sameMoves(allCopy, allCount, captures, captureCount + quietCount)) return "captures + quiets != all moves";
+
+    int legalCount = generateLegalMoves(pos, legal);
+    int filteredCount = 0;
+    for (int i = 0; i < allCount; i++) {
+        if (isLegalMove(pos, all[i])) filtered[filteredCount++] = all[i];
+    }
+    if (!sameMoves(legal, legalCount, filtered, filteredCount)) return "legal moves (evasions) differ from filtered moves";
+    if (countLegalMoves(pos) != legalCount || hasAnyLegalMove(pos) != (legalCount > 0)) return "legal move count queries";
+    if ((checkers(pos) != 0) != inCheck(pos)) return "checkers";
+
+    for (int i = 0; i < legalCount; i++) {
+        Position before = pos;
+        UndoInfo undo;
+        makeMove(pos, legal[i], undo);
+        bool keyOk = pos.key == computeKey(pos);
+        unmakeMove(pos, legal[i], undo);
+        if (!keyOk) return "hash key after " + moveToUci(legal[i]);
+        if (toFen(pos) != toFen(before) || pos.key != before.key) return "unmake of " + moveToUci(legal[i]);
+    }
+    return "";
+}
+
+static void randomPositions(int count, uint64_t seed, vector<PerftJob>& jobs, int depth) {
+    static const char* starts[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    };
+    mt19937_64 rng(seed);
+    while (int(jobs.size()) < count) {
+        Position pos;
+        setFromFen(pos, starts[rng() % 4]);
+        int plies = int(rng() % 80);
+        for (int ply = 0; ply < plies; ply++) {
+            Move moves[MOVE_LIST_SIZE];
+            int n = generateLegalMoves(pos, moves);
+            if (n == 0) break;
+            UndoInfo undo;
+            makeMove(pos, moves[rng() % n], undo);
+        }
+        PerftJob job;
+        job.fen = toFen(pos);
+        job.depth = depth;
+        jobs.push_back(job);
+    }
+}
+
+static int runRandom(int count, uint64_t seed, int depth, ThreadPool& pool, PerftTable& table) {
+    vector<PerftJob> jobs;
+    randomPositions(count, seed, jobs, depth);
+    int failures = 0;
+    for (PerftJob& job : jobs) {
+        Position pos;
+        setFromFen(pos, job.fen);
+        string failure = checkInvariants(pos);
+        if (!failure.empty()) {
+            cout << "FAIL " << failure << ": " << job.fen << endl;
+            failures++;
+        }
+    }
+    cout << jobs.size() << " positions, " << failures << " invariant failures" << endl;
+
+    PerftStats hashed = runPerftJobs(jobs, pool, table);
+    printStats("hashed", hashed, poolWorkers(pool));
+    vector<uint64_t> expected;
+    for (const PerftJob& job : jobs) expected.push_back(job.nodes);
+
+    PerftTable none;
+    PerftStats plain = runPerftJobs(jobs, pool, none);
+    printStats("plain", plain, poolWorkers(pool));
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].nodes != expected[i]) {
+            cout << "FAIL hashed " << expected[i] << " plain " << jobs[i].nodes << ": " << jobs[i].fen << endl;
+            failures++;
+        }
+    }
+    cout << (failures ? "FAILED" : "OK") << endl;
+    return failures ? 1 : 0;
+}
+
+// ========== MAIN ==========
+
+int main(int argc, char* argv[]) {
+    int threads = 0, depth = 0, maxDepth = 0, randomCount = 0;
+    size_t hashMb = 64;
+    uint64_t seed = 1;
+    bool divide = false, scaling = false;
+    string fen = START_FEN, suite;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--hash" && i + 1 < argc) hashMb = size_t(atoi(argv[++i]));
+        else if (arg == "--fen" && i + 1 < argc) fen = argv[++i];
+        else if (arg == "--suite" && i + 1 < argc) suite = argv[++i];
+        else if (arg == "--max-depth" && i + 1 < argc) maxDepth = atoi(argv[++i]);
+        else if (arg == "--random" && i + 1 < argc) randomCount = atoi(argv[++i]);
+        else if (arg == "--depth" && i + 1 < argc) depth = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--divide") divide = true;
+        else if (arg == "--scaling") scaling = true;
+        else if (!arg.empty() && isdigit((unsigned char)arg[0])) depth = atoi(arg.c_str());
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    PerftTable table;
+    perftTableResize(table, hashMb);
+    ThreadPool pool;
+    startThreadPool(pool, threads);
+
+    if (randomCount > 0) {
+        int status = runRandom(randomCount, seed, depth > 0 ? depth : 3, pool, table);
+        stopThreadPool(pool);
+        return status;
+    }
+
+    vector<PerftJob> jobs;
+    if (!suite.empty()) {
+        if (!readPerftSuite(suite, depth > 0 ? depth : 4, maxDepth, jobs)) {
+            cerr << "Cannot read " << suite << endl;
+            return 1;
+        }
+    }
+    else {
+        if (depth <= 0) {
+            usage();
+            return 1;
+        }
+        PerftJob job;
+        job.fen = fen;
+        job.depth = depth;
+        jobs.push_back(job);
+    }
+
+    if (scaling) {
+        // Same jobs with a doubling thread count, each run on an empty table
+        int most = poolWorkers(pool);
+        stopThreadPool(pool);
+        double baseline = 0;
+        for (int n = 1; ; n = min(n * 2, most)) {
+            ThreadPool scaled;
+            startThreadPool(scaled, n);
+            perftTableClear(table);
+            PerftStats stats = runPerftJobs(jobs, scaled, table);
+            stopThreadPool(scaled);
+            if (n == 1) baseline = stats.seconds;
+            char line[120];
+            snprintf(line, sizeof(line), "%3d threads: %8.3f s  %8.1f Mnps  speedup %.2f", n, stats.seconds,
+                stats.nodes / max(stats.seconds, 1e-9) / 1e6, baseline / max(stats.seconds, 1e-9));
+            cout << line << endl;
+            if (n == most) break;
+        }
+        return 0;
+    }
+
+    PerftStats stats = runPerftJobs(jobs, pool, table);
+    stopThreadPool(pool);
+
+    int failures = 0;
+    for (const PerftJob& job : jobs) {
+        if (!job.valid) {
+            cout << "FAIL bad FEN: " << job.fen << endl;
+            failures++;
+            continue;
+        }
+        if (divide) {
+            for (size_t i = 0; i < job.rootMoves.size(); i++) {
+                cout << moveToUci(job.rootMoves[i]) << ": " << job.rootNodes[i] << endl;
+            }
+            cout << endl;
+        }
+        if (job.expected && job.nodes != job.expected) {
+            cout << "FAIL depth " << job.depth << " " << job.nodes << " expected " << job.expected << ": " << job.fen << endl;
+            failures++;
+        }
+        else if (jobs.size() == 1) {
+            cout << "Nodes searched: " << job.nodes << endl;
+        }
+    }
+    printStats(jobs.size() == 1 ? "perft" : "suite", stats, poolWorkers(pool));
+    if (!suite.empty()) cout << jobs.size() << " positions, " << failures << " failures" << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,166 @@
+// Measures what the search's selectivity layer (SearchFeatures in
+// core/search.h) gains over the full-width search: nodes and time to reach a
+// fixed depth over a set of positions, and how much of a tactical suite each
+// search solves in a fixed time per position.
+//
+// Usage: search_compare [--depth N] [--movetime MS] [--suite FILE] [--hash MB] [--ablation] [--multipv K]
+//
+// --depth 0 skips the time-to-depth runs and --movetime 0 the tactical suite
+// (EPD with "bm" or "am" operations, tools/tactics.epd by default).
+// --ablation adds runs of the selective search with each feature switched
+// off in turn.
+// --multipv K also times the selective search finding K lines instead of
+// one, and reports the cost of each extra line. Every search starts from an
+// empty hash table.
+
+#include "../core/epd.h"
+#include "../core/search.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: search_compare [--depth N] [--movetime MS] [--suite FILE] [--hash MB] [--ablation] [--multipv K]" << endl;
+}
+
+// Openings, middlegames and endgames for the time-to-depth runs
+static const char* depthFens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 3 8",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/2PP4/1PNBPN2/PB3PPP/R2Q1RK1 b - - 1 10",
+    "2r3k1/pp3ppp/2n1b3/3p4/3P4/2NB1N2/PP3PPP/2R3K1 w - - 0 20",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 b - - 0 50",
+    "6k1/5ppp/8/8/8/8/1q3PPP/3R2K1 b - - 0 30",
+};
+
+struct Variant {
+    string name;
+    SearchFeatures features;
+    int multiPv = 1;
+};
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int depth = 7;
+    int64_t movetime = 1000;
+    size_t hashMb = 64;
+    string suite = "tools/tactics.epd";
+    bool ablation = false;
+    int multiPv = 1;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--depth" && i + 1 < argc) depth = atoi(argv[++i]);
+        else if (arg == "--movetime" && i + 1 < argc) movetime = atoll(argv[++i]);
+        else if (arg == "--suite" && i + 1 < argc) suite = argv[++i];
+        else if (arg == "--hash" && i + 1 < argc) hashMb = size_t(atoi(argv[++i]));
+        else if (arg == "--ablation") ablation = true;
+        else if (arg == "--multipv" && i + 1 < argc) multiPv = max(1, min(MAX_MULTI_PV, atoi(argv[++i])));
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    vector<Variant> variants = { { "full-width", fullWidthFeatures() }, { "selective", SearchFeatures() } };
+    if (ablation) {
+        Variant variant = { "no null move", SearchFeatures() };
+        variant.features.nullMove = false;
+        variants.push_back(variant);
+        variant = { "no LMR", SearchFeatures() };
+        variant.features.lateMoveReductions = false;
+        variants.push_back(variant);
+        variant = { "no futility", SearchFeatures() };
+        variant.features.futility = false;
+        variants.push_back(variant);
+        variant = { "no check ext", SearchFeatures() };
+        variant.features.checkExtensions = false;
+        variants.push_back(variant);
+    }
+    if (multiPv > 1) {
+        Variant variant = { "multi-PV " + to_string(multiPv), SearchFeatures() };
+        variant.multiPv = multiPv;
+        variants.push_back(variant);
+    }
+
+    Search search;
+    initSearch(search, max<size_t>(1, hashMb));
+    vector<uint64_t> noHistory;
+    char line[160];
+
+    if (depth > 0) {
+        int positions = int(sizeof(depthFens) / sizeof(depthFens[0]));
+        cout << "Time to depth " << depth << " over " << positions << " positions" << endl;
+        double baseline = 0, selectiveSeconds = 0;
+        for (const Variant& variant : variants) {
+            search.features = variant.features;
+            uint64_t nodes = 0;
+            double seconds = 0;
+            for (const char* fen : depthFens) {
+                Position pos;
+                setFromFen(pos, fen);
+                newGame(search);
+                search.stop = false;
+                SearchLimits limits;
+                limits.depth = depth;
+                limits.multiPv = variant.multiPv;
+                auto start = chrono::steady_clock::now();
+                SearchResult result = searchPosition(search, pos, limits, noHistory);
+                seconds += secondsSince(start);
+                nodes += result.nodes;
+            }
+            if (baseline == 0) baseline = seconds;
+            snprintf(line, sizeof(line), "  %-14s %12llu nodes %9.3f s   speedup %6.2f",
+                variant.name.c_str(), (unsigned long long)nodes, seconds, baseline / max(seconds, 1e-9));
+            cout << line << endl;
+            if (variant.name == "selective") selectiveSeconds = seconds;
+            if (variant.multiPv > 1) {
+                // Each line after the first, as a fraction of a single-line search
+                double perLine = (seconds / max(selectiveSeconds, 1e-9) - 1) / (variant.multiPv - 1);
+                snprintf(line, sizeof(line), "    each extra line costs %.0f%% of a single-line search", perLine * 100);
+                cout << line << endl;
+            }
+        }
+    }
+
+    if (movetime > 0) {
+        vector<EpdPosition> tactics;
+        if (!readEpdFile(suite, tactics) || tactics.empty()) {
+            cerr << "Cannot read positions with bm or am from " << suite << endl;
+            return 1;
+        }
+        cout << "Tactics: " << tactics.size() << " positions from " << suite << ", " << movetime << " ms each" << endl;
+        for (const Variant& variant : variants) {
+            search.features = variant.features;
+            int solved = 0, depthSum = 0;
+            string missed;
+            for (const EpdPosition& tactic : tactics) {
+                Position pos;
+                if (!setFromFen(pos, tactic.fen)) continue;
+                newGame(search);
+                search.stop = false;
+                SearchLimits limits = moveTimeLimits(movetime);
+                limits.multiPv = variant.multiPv;
+                SearchResult result = searchPosition(search, pos, limits, noHistory);
+                depthSum += result.depth;
+                if (epdSolved(pos, tactic, result.bestMove)) solved++;
+                else missed += " " + (tactic.id.empty() ? tactic.fen : tactic.id);
+            }
+            snprintf(line, sizeof(line), "  %-14s solved %3d/%-3d  average depth %5.1f",
+                variant.name.c_str(), solved, int(tactics.size()), double(depthSum) / tactics.size());
+            cout << line << endl;
+            if (!missed.empty()) cout << "    missed:" << missed << endl;
+        }
+    }
+    return 0;
+}
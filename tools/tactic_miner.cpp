@@ -0,0 +1,298 @@
+// Mines tactics puzzles from PGN archives.
+//
+// Usage: tactic_miner [--threads N] [--nodes N] [--min-ply N] [--games N]
+//                     [--win CP] [--gap CP] [--queue N] -o puzzles.epd games.pgn [more.pgn ...]
+//
+// Three stages connected by bounded lock-free queues (core/queue.h): one
+// thread parses and replays the games, --threads workers (default: all cores
+// but two, at least one) search every position reached after --min-ply plies
+// with a --nodes node search, and one thread writes the puzzles found.
+//
+// A position is a puzzle when the side to move has exactly one winning move
+// (best line >= --win centipawns, second best --gap or more below it) and was
+// not already winning before the opponent's last move, which was therefore a
+// blunder. Puzzles are written as EPD with the solution as "bm" and the line
+// as "pv", so the file works as a suite for search_compare --suite. At the
+// end every stage reports its throughput and the time it spent waiting.
+
+#include "../core/pgn.h"
+#include "../core/queue.h"
+#include "../core/search.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const int MAX_SOLUTION = 8;     // moves of the line written as "pv"
+
+struct MinerOptions {
+    int threads = 0;
+    uint64_t nodes = 20000;
+    int minPly = 10;
+    uint64_t maxGames = 0;      // 0 = all
+    int winScore = 200;
+    int onlyMoveGap = 200;
+    size_t queueSize = 4096;
+};
+
+// A position to analyse: the one after move is played in before
+struct MiningTask {
+    Position before;
+    Move move;
+    uint32_t game;
+    uint32_t ply;
+};
+
+struct Puzzle {
+    Position pos;
+    Move solution[MAX_SOLUTION];
+    int solutionLength;
+    int best, second, before;   // scores for the side to move
+    uint32_t game;
+    uint32_t ply;
+};
+
+struct StageStats {
+    uint64_t items = 0;
+    uint64_t nodes = 0;
+    double seconds = 0;                 // wall time of the stage's thread
+    chrono::nanoseconds inputWait{ 0 };
+    chrono::nanoseconds outputWait{ 0 };
+};
+
+static void usage() {
+    cerr << "Usage: tactic_miner [--threads N] [--nodes N] [--min-ply N] [--games N]" << endl;
+    cerr << "                    [--win CP] [--gap CP] [--queue N] -o puzzles.epd games.pgn [more.pgn ...]" << endl;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// ========== STAGES ==========
+
+static void parseStage(const vector<string>& inputs, const MinerOptions& options,
+    BoundedQueue<MiningTask>& tasks, StageStats& stats, uint64_t& games) {
+    auto start = chrono::steady_clock::now();
+    uint32_t gameId = 0;
+    for (const string& input : inputs) {
+        ifstream in(input, ios::binary);
+        PgnGame game;
+        while ((options.maxGames == 0 || games < options.maxGames) && readPgnGame(in, game)) {
+            games++;
+            MiningTask task;
+            task.game = gameId++;
+            if (!pgnStartPosition(game, task.before)) continue;
+            for (size_t ply = 0; ply < game.moves.size(); ply++) {
+                task.move = parseSanMove(task.before, game.moves[ply]);
+                if (task.move == NO_MOVE) break;
+                task.ply = uint32_t(ply + 1);
+                if (int(task.ply) >= options.minPly) {
+                    MiningTask queued = task;
+                    queuePush(tasks, queued, stats.outputWait);
+                    stats.items++;
+                }
+                UndoInfo undo;
+                makeMove(task.before, task.move, undo);
+            }
+        }
+    }
+    queueClose(tasks);
+    stats.seconds = secondsSince(start);
+}
+
+static void analysisStage(const MinerOptions& options, BoundedQueue<MiningTask>& tasks,
+    BoundedQueue<Puzzle>& puzzles, StageStats& stats, uint64_t& onlyMoves) {
+    auto start = chrono::steady_clock::now();
+    Search search;
+    initSearch(search, 16);
+    vector<uint64_t> noHistory;
+    MiningTask task;
+    while (queuePop(tasks, task, stats.inputWait)) {
+        Position pos = task.before;
+        UndoInfo undo;
+        makeMove(pos, task.move, undo);
+        stats.items++;
+
+        SearchLimits limits;
+        limits.nodes = options.nodes;
+        limits.multiPv = 2;
+        search.stop = false;
+        SearchResult result = searchPosition(search, pos, limits, noHistory);
+        stats.nodes += result.nodes;
+        // A forced move is no puzzle
+        if (result.lineCount < 2) continue;
+        // The node limit can stop an iteration after its first line; scores
+        // of different depths say nothing about an only move
+        if (result.lines[1].depth != result.lines[0].depth) continue;
+        int best = result.lines[0].score, second = result.lines[1].score;
+        if (best < options.winScore || best - second < options.onlyMoveGap) continue;
+        onlyMoves++;
+
+        // Was the opponent's move the mistake, or was the game already won?
+        limits.multiPv = 1;
+        search.stop = false;
+        Position before = task.before;
+        SearchResult previous = searchPosition(search, before, limits, noHistory);
+        stats.nodes += previous.nodes;
+        int beforeScore = -previous.score;
+        if (beforeScore >= options.winScore) continue;
+
+        Puzzle puzzle;
+        puzzle.pos = pos;
+        puzzle.solutionLength = min(MAX_SOLUTION, result.lines[0].pv.length);
+        for (int i = 0; i < puzzle.solutionLength; i++) puzzle.solution[i] = result.lines[0].pv[i];
+        puzzle.best = best;
+        puzzle.second = second;
+        puzzle.before = beforeScore;
+        puzzle.game = task.game;
+        puzzle.ply = task.ply;
+        queuePush(puzzles, puzzle, stats.outputWait);
+    }
+    stats.seconds = secondsSince(start);
+}
+
+static string formatScore(int score) {
+    char text[16];
+    if (isMateScore(score)) {
+        int moves = (MATE_SCORE - abs(score) + 1) / 2;
+        snprintf(text, sizeof(text), "%s#%d", score > 0 ? "" : "-", moves);
+    }
+    else {
+        snprintf(text, sizeof(text), "%+.2f", score / 100.0);
+    }
+    return text;
+}
+
+// <4 FEN fields> bm Qxf7+; pv "Qxf7+ Kh8 Qf8#"; id "game 12 ply 33"; c0 "...";
+static string puzzleToEpd(const Puzzle& puzzle) {
+    Position pos = puzzle.pos;
+    string fen = toFen(pos);
+    size_t cut = 0;
+    for (int fields = 0; fields < 4 && cut != string::npos; fields++) cut = fen.find(' ', cut + 1);
+    string epd = fen.substr(0, cut) + " bm " + moveToSan(pos, puzzle.solution[0]) + "; pv \"";
+    for (int i = 0; i < puzzle.solutionLength; i++) {
+        epd += (i ? " " : "") + moveToSan(pos, puzzle.solution[i]);
+        UndoInfo undo;
+        makeMove(pos, puzzle.solution[i], undo);
+    }
+    epd += "\"; id \"game " + to_string(puzzle.game) + " ply " + to_string(puzzle.ply) + "\"; c0 \"best " +
+        formatScore(puzzle.best) + ", second " + formatScore(puzzle.second) + ", before " + formatScore(puzzle.before) + "\";";
+    return epd;
+}
+
+static void writeStage(ofstream& out, BoundedQueue<Puzzle>& puzzles, StageStats& stats) {
+    auto start = chrono::steady_clock::now();
+    Puzzle puzzle;
+    while (queuePop(puzzles, puzzle, stats.inputWait)) {
+        out << puzzleToEpd(puzzle) << "\n";
+        stats.items++;
+    }
+    out.flush();
+    stats.seconds = secondsSince(start);
+}
+
+// ========== MAIN ==========
+
+static void printStage(const char* name, const char* unit, const StageStats& stats, int threads) {
+    // Times are per thread, so the rate is what the stage as a whole sustains
+    double input = chrono::duration<double>(stats.inputWait).count() / threads;
+    double output = chrono::duration<double>(stats.outputWait).count() / threads;
+    double busy = max(0.0, stats.seconds / threads - input - output);
+    char line[240];
+    snprintf(line, sizeof(line), "  %-9s %2d thread%s %10llu %-9s %9.2f s busy %10.1f %s/s   waiting %8.2f s for input, %8.2f s for output",
+        name, threads, threads == 1 ? " " : "s", (unsigned long long)stats.items, unit, busy,
+        stats.items / max(busy, 1e-9), unit, input, output);
+    cout << line << endl;
+}
+
+int main(int argc, char* argv[]) {
+    MinerOptions options;
+    string output;
+    vector<string> inputs;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) options.threads = atoi(argv[++i]);
+        else if (arg == "--nodes" && i + 1 < argc) options.nodes = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--min-ply" && i + 1 < argc) options.minPly = atoi(argv[++i]);
+        else if (arg == "--games" && i + 1 < argc) options.maxGames = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--win" && i + 1 < argc) options.winScore = atoi(argv[++i]);
+        else if (arg == "--gap" && i + 1 < argc) options.onlyMoveGap = atoi(argv[++i]);
+        else if (arg == "--queue" && i + 1 < argc) options.queueSize = size_t(max(2, atoi(argv[++i])));
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 1; }
+        else inputs.push_back(arg);
+    }
+    if (output.empty() || inputs.empty()) {
+        usage();
+        return 1;
+    }
+    for (const string& input : inputs) {
+        if (!ifstream(input)) {
+            cerr << "Cannot open " << input << endl;
+            return 1;
+        }
+    }
+    ofstream out(output);
+    if (!out) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+    int workers = options.threads > 0 ? options.threads : max(1, int(thread::hardware_concurrency()) - 2);
+
+    BoundedQueue<MiningTask> tasks;
+    BoundedQueue<Puzzle> puzzles;
+    queueInit(tasks, options.queueSize);
+    queueInit(puzzles, options.queueSize);
+
+    auto start = chrono::steady_clock::now();
+    StageStats parseStats, writeStats;
+    vector<StageStats> workerStats(workers);
+    vector<uint64_t> onlyMoves(workers, 0);
+    uint64_t games = 0;
+    thread parser(parseStage, cref(inputs), cref(options), ref(tasks), ref(parseStats), ref(games));
+    vector<thread> analysers;
+    for (int i = 0; i < workers; i++) {
+        analysers.emplace_back(analysisStage, cref(options), ref(tasks), ref(puzzles), ref(workerStats[i]), ref(onlyMoves[i]));
+    }
+    thread writer(writeStage, ref(out), ref(puzzles), ref(writeStats));
+
+    parser.join();
+    for (thread& analyser : analysers) analyser.join();
+    queueClose(puzzles);
+    writer.join();
+    double seconds = secondsSince(start);
+
+    // The analysis workers report as one stage; busy time is summed over them
+    StageStats analysisStats;
+    uint64_t onlyMoveCount = 0;
+    for (int i = 0; i < workers; i++) {
+        analysisStats.items += workerStats[i].items;
+        analysisStats.nodes += workerStats[i].nodes;
+        analysisStats.seconds += workerStats[i].seconds;
+        analysisStats.inputWait += workerStats[i].inputWait;
+        analysisStats.outputWait += workerStats[i].outputWait;
+        onlyMoveCount += onlyMoves[i];
+    }
+
+    char line[200];
+    snprintf(line, sizeof(line), "%llu games, %llu positions, %llu with one winning move, %llu puzzles written to %s in %.2f s",
+        (unsigned long long)games, (unsigned long long)analysisStats.items, (unsigned long long)onlyMoveCount,
+        (unsigned long long)writeStats.items, output.c_str(), seconds);
+    cout << line << endl;
+    printStage("parse", "positions", parseStats, 1);
+    printStage("analysis", "positions", analysisStats, workers);
+    printStage("write", "puzzles", writeStats, 1);
+    snprintf(line, sizeof(line), "  analysis searched %llu nodes, %.0f nodes/s per worker",
+        (unsigned long long)analysisStats.nodes,
+        analysisStats.nodes / max(analysisStats.seconds - chrono::duration<double>(analysisStats.inputWait + analysisStats.outputWait).count(), 1e-9));
+    cout << line << endl;
+    return 0;
+}
@@ -0,0 +1,425 @@
+// Tunes the evaluation's material values and piece-square tables on
+// positions labelled with game results (Texel's method) and writes them out
+// as core/evalparams.h.
+//
+// Usage: tuner [--threads N] [--epochs N] [--rate CP] [--batch N] [--k K]
+//              [--skip N] [--max N] [--report N] -o evalparams.h (--positions FILE | games.pgn ...)
+//
+// --positions reads one labelled position per line: a FEN or EPD followed
+// by the result as 1-0, 0-1, 1/2-1/2 or [1.0], [0.5], [0.0]. Otherwise every
+// position after the first --skip (default 8) plies of each finished game in
+// the PGN files is used, unless the side to move is in check. --max caps the
+// number of positions loaded.
+//
+// The evaluation is linear in its parameters, so every position is reduced
+// once to its pieces (as parameter indices) and its game phase, stored as
+// fixed-width structure of arrays. An epoch evaluates all of them on all
+// cores, each worker adding up its own gradient of the mean squared error
+// between sigmoid(K * eval) and the result, and the parameters take an Adam
+// step per --batch positions (default: one step per epoch). K is fitted to the
+// starting parameters unless given. --epochs 0 writes the current parameters.
+
+#include "../core/epd.h"
+#include "../core/eval.h"
+#include "../core/evalparams.h"
+#include "../core/pgn.h"
+#include "../core/threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+    cerr << "Usage: tuner [--threads N] [--epochs N] [--rate CP] [--batch N] [--k K]" << endl;
+    cerr << "             [--skip N] [--max N] [--report N] -o evalparams.h (--positions FILE | games.pgn ...)" << endl;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// ========== PARAMETERS ==========
+
+// Values of the queen to the pawn, the tables of the king (middlegame) to the
+// pawn, then the king's endgame table
+const int VALUE_PARAMS = 0;
+const int TABLE_PARAMS = 5;
+const int KING_ENDGAME_PARAMS = TABLE_PARAMS + 6 * 64;
+const int PARAM_COUNT = KING_ENDGAME_PARAMS + 64;
+
+inline int valueParam(int kind) { return VALUE_PARAMS + kind - W_QUEEN; }
+inline int tableParam(int kind, int sq) { return TABLE_PARAMS + (kind - W_KING) * 64 + sq; }
+
+static const int* const kindTables[7] = {
+    nullptr, kingMiddlegameTable, queenTable, bishopTable, knightTable, rookTable, pawnTable
+};
+static const char* const tableNames[7] = {
+    nullptr, "kingMiddlegameTable", "queenTable", "bishopTable", "knightTable", "rookTable", "pawnTable"
+};
+static const char* const valueNames[7] = {
+    nullptr, nullptr, "QUEEN_VALUE", "BISHOP_VALUE", "KNIGHT_VALUE", "ROOK_VALUE", "PAWN_VALUE"
+};
+
+static void currentParameters(vector<double>& params) {
+    params.assign(PARAM_COUNT, 0);
+    const int values[7] = { 0, 0, QUEEN_VALUE, BISHOP_VALUE, KNIGHT_VALUE, ROOK_VALUE, PAWN_VALUE };
+    for (int kind = W_QUEEN; kind <= W_PAWN; kind++) params[valueParam(kind)] = values[kind];
+    for (int kind = W_KING; kind <= W_PAWN; kind++) {
+        for (int sq = 0; sq < 64; sq++) params[tableParam(kind, sq)] = kindTables[kind][sq];
+    }
+    for (int sq = 0; sq < 64; sq++) params[KING_ENDGAME_PARAMS + sq] = kingEndgameTable[sq];
+}
+
+static void writeTable(ostream& out, const char* name, const vector<double>& params, int first) {
+    out << "const int " << name << "[64] = {\n";
+    for (int row = 0; row < 8; row++) {
+        out << "   ";
+        for (int col = 0; col < 8; col++) {
+            char value[8];
+            snprintf(value, sizeof(value), "%4d", int(lround(params[first + row * 8 + col])));
+            out << value << (row == 7 && col == 7 ? "" : ",");
+        }
+        out << "\n";
+    }
+    out << "};\n";
+}
+
+static bool writeHeader(const string& path, const vector<double>& params, const string& comment) {
+    ostringstream out;
+    out << "#pragma once\n";
+    out << "// Evaluation parameters, generated by tools/tuner.cpp (" << comment << ").\n";
+    out << "// Material values, then piece-square tables from White's point of view,\n";
+    out << "// laid out like the board (first row is rank 8). Black pieces read them\n";
+    out << "// mirrored. Non-king pieces score the same in the middlegame and the\n";
+    out << "// endgame; the king has a table for each.\n\n";
+    for (int kind = W_QUEEN; kind <= W_PAWN; kind++) {
+        out << "const int " << valueNames[kind] << " = " << lround(params[valueParam(kind)]) << ";\n";
+    }
+    for (int kind = W_QUEEN; kind <= W_PAWN; kind++) {
+        out << "\n";
+        writeTable(out, tableNames[kind], params, tableParam(kind, 0));
+    }
+    out << "\n";
+    writeTable(out, tableNames[W_KING], params, tableParam(W_KING, 0));
+    out << "\n";
+    writeTable(out, "kingEndgameTable", params, KING_ENDGAME_PARAMS);
+
+    // With CRLF line endings like the rest of the sources, so a regenerated
+    // header only differs where the values do
+    string text;
+    for (char c : out.str()) {
+        if (c == '\n') text += '\r';
+        text += c;
+    }
+    ofstream file(path, ios::binary);
+    file << text;
+    return bool(file);
+}
+
+// ========== POSITIONS ==========
+
+// Most pieces a legal position can have
+const int MAX_PIECES = 32;
+
+// Features are table squares (6 bits) and piece kinds (3 bits), plus a bit
+// for Black, whose terms are subtracted. 0 marks an unused slot.
+const uint16_t BLACK_FEATURE = 1 << 9;
+
+struct TuningSet {
+    size_t count = 0;
+    vector<uint16_t> features;      // MAX_PIECES per position
+    vector<float> phase;            // middlegame weight, 0 to 1
+    vector<float> result;           // 1 White won, 0.5 draw, 0 Black won
+};
+
+static bool addPosition(TuningSet& set, const Position& pos, float result) {
+    uint16_t features[MAX_PIECES] = {};
+    int pieces = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        int piece = pos.board[sq];
+        if (piece == NONE) continue;
+        if (pieces == MAX_PIECES) return false;
+        bool white = isWhite(piece);
+        int tableSq = white ? sq : sq ^ 56;
+        features[pieces++] = uint16_t(tableSq | (pieceKind(piece) << 6) | (white ? 0 : BLACK_FEATURE));
+    }
+    set.features.insert(set.features.end(), features, features + MAX_PIECES);
+    set.phase.push_back(float(gamePhase(pos)) / MAX_PHASE);
+    set.result.push_back(result);
+    set.count++;
+    return true;
+}
+
+// The result at the end of a labelled line, or -1
+static float parseResult(const string& line) {
+    if (line.find("1/2-1/2") != string::npos || line.find("[0.5]") != string::npos) return 0.5f;
+    if (line.find("1-0") != string::npos || line.find("[1.0]") != string::npos) return 1.0f;
+    if (line.find("0-1") != string::npos || line.find("[0.0]") != string::npos) return 0.0f;
+    return -1.0f;
+}
+
+static bool loadPositions(const string& path, size_t maxPositions, TuningSet& set, size_t& rejected) {
+    ifstream in(path);
+    if (!in) return false;
+    string line;
+    while ((maxPositions == 0 || set.count < maxPositions) && getline(in, line)) {
+        float result = parseResult(line);
+        Position pos;
+        if (result < 0 || !setFromFen(pos, lineToFen(line)) || !addPosition(set, pos, result)) rejected++;
+    }
+    return true;
+}
+
+static bool loadGames(const vector<string>& paths, int skip, size_t maxPositions, TuningSet& set, size_t& games) {
+    for (const string& path : paths) {
+        ifstream in(path, ios::binary);
+        if (!in) return false;
+        PgnGame game;
+        while ((maxPositions == 0 || set.count < maxPositions) && readPgnGame(in, game)) {
+            Position pos;
+            if (game.result == RESULT_UNKNOWN || !pgnStartPosition(game, pos)) continue;
+            games++;
+            float result = game.result == RESULT_WHITE_WINS ? 1.0f : game.result == RESULT_BLACK_WINS ? 0.0f : 0.5f;
+            for (size_t ply = 0; ply < game.moves.size(); ply++) {
+                Move m = parseSanMove(pos, game.moves[ply]);
+                if (m == NO_MOVE) break;
+                UndoInfo undo;
+                makeMove(pos, m, undo);
+                if (int(ply) + 1 > skip && !inCheck(pos)) addPosition(set, pos, result);
+            }
+        }
+    }
+    return true;
+}
+
+// ========== TRAINING ==========
+
+// Positions per parallelFor task
+const size_t TUNING_CHUNK = 8192;
+
+// Per worker sums, padded apart so workers do not share cache lines
+struct Accumulator {
+    vector<double> gradient;
+    double loss = 0;
+    char padding[64];
+};
+
+// White's score under params; must agree with evaluate() up to rounding
+static inline double modelScore(const double* params, const uint16_t* features, double phase) {
+    double score = 0;
+    for (int j = 0; j < MAX_PIECES && features[j] != 0; j++) {
+        int sq = features[j] & 63, kind = (features[j] >> 6) & 7;
+        double term = kind == W_KING ?
+            phase * params[tableParam(W_KING, sq)] + (1 - phase) * params[KING_ENDGAME_PARAMS + sq] :
+            params[valueParam(kind)] + params[tableParam(kind, sq)];
+        score += (features[j] & BLACK_FEATURE) ? -term : term;
+    }
+    return score;
+}
+
+// Mean squared error of positions [begin, end); with gradient, also adds
+// up its gradient per worker
+static double evaluateLoss(ThreadPool& pool, const TuningSet& set, const vector<double>& params, double k,
+    size_t begin, size_t end, vector<Accumulator>& accumulators, bool gradient) {
+    // sigmoid(k * score) with k in natural-log units
+    double scale = k * log(10.0) / 400.0;
+    for (Accumulator& accumulator : accumulators) {
+        accumulator.loss = 0;
+        if (gradient) fill(accumulator.gradient.begin(), accumulator.gradient.end(), 0.0);
+    }
+    size_t chunks = (end - begin + TUNING_CHUNK - 1) / TUNING_CHUNK;
+    parallelFor(pool, chunks, [&](size_t chunk, int worker) {
+        Accumulator& accumulator = accumulators[worker];
+        double* grad = accumulator.gradient.data();
+        size_t first = begin + chunk * TUNING_CHUNK, last = min(end, first + TUNING_CHUNK);
+        double loss = 0;
+        for (size_t i = first; i < last; i++) {
+            const uint16_t* features = &set.features[i * MAX_PIECES];
+            double phase = set.phase[i];
+            double sigmoid = 1.0 / (1.0 + exp(-scale * modelScore(params.data(), features, phase)));
+            double error = sigmoid - set.result[i];
+            loss += error * error;
+            if (!gradient) continue;
+            double g = 2 * error * sigmoid * (1 - sigmoid) * scale;
+            for (int j = 0; j < MAX_PIECES && features[j] != 0; j++) {
+                int sq = features[j] & 63, kind = (features[j] >> 6) & 7;
+                double signedG = (features[j] & BLACK_FEATURE) ? -g : g;
+                if (kind == W_KING) {
+                    grad[tableParam(W_KING, sq)] += signedG * phase;
+                    grad[KING_ENDGAME_PARAMS + sq] += signedG * (1 - phase);
+                }
+                else {
+                    grad[valueParam(kind)] += signedG;
+                    grad[tableParam(kind, sq)] += signedG;
+                }
+            }
+        }
+        accumulator.loss += loss;
+    });
+    double loss = 0;
+    for (const Accumulator& accumulator : accumulators) loss += accumulator.loss;
+    return loss / max<size_t>(1, end - begin);
+}
+
+// The K that best fits the starting parameters, by golden section search
+static double fitK(ThreadPool& pool, const TuningSet& set, const vector<double>& params, vector<Accumulator>& accumulators) {
+    const double ratio = (sqrt(5.0) - 1) / 2;
+    double low = 0.05, high = 5.0;
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double lossA = evaluateLoss(pool, set, params, a, 0, set.count, accumulators, false);
+    double lossB = evaluateLoss(pool, set, params, b, 0, set.count, accumulators, false);
+    // Each step keeps one of the two inner points, so it costs one pass
+    for (int i = 0; i < 20; i++) {
+        if (lossA < lossB) {
+            high = b;
+            b = a;
+            lossB = lossA;
+            a = high - ratio * (high - low);
+            lossA = evaluateLoss(pool, set, params, a, 0, set.count, accumulators, false);
+        }
+        else {
+            low = a;
+            a = b;
+            lossA = lossB;
+            b = low + ratio * (high - low);
+            lossB = evaluateLoss(pool, set, params, b, 0, set.count, accumulators, false);
+        }
+    }
+    return (low + high) / 2;
+}
+
+struct Adam {
+    vector<double> m, v;
+    uint64_t steps = 0;
+};
+
+static void adamStep(Adam& adam, vector<double>& params, const vector<Accumulator>& accumulators, size_t positions, double rate) {
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    adam.steps++;
+    double correction1 = 1 - pow(beta1, double(adam.steps)), correction2 = 1 - pow(beta2, double(adam.steps));
+    for (int p = 0; p < PARAM_COUNT; p++) {
+        double g = 0;
+        for (const Accumulator& accumulator : accumulators) g += accumulator.gradient[p];
+        g /= double(positions);
+        adam.m[p] = beta1 * adam.m[p] + (1 - beta1) * g;
+        adam.v[p] = beta2 * adam.v[p] + (1 - beta2) * g * g;
+        params[p] -= rate * (adam.m[p] / correction1) / (sqrt(adam.v[p] / correction2) + epsilon);
+    }
+}
+
+// ========== MAIN ==========
+
+int main(int argc, char* argv[]) {
+    int threads = 0, epochs = 100, skip = 8, report = 10;
+    double rate = 1.0, k = 0;
+    size_t batch = 0, maxPositions = 0;
+    string output, positionsFile;
+    vector<string> pgnFiles;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--epochs" && i + 1 < argc) epochs = max(0, atoi(argv[++i]));
+        else if (arg == "--rate" && i + 1 < argc) rate = atof(argv[++i]);
+        else if (arg == "--batch" && i + 1 < argc) batch = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--k" && i + 1 < argc) k = atof(argv[++i]);
+        else if (arg == "--skip" && i + 1 < argc) skip = max(0, atoi(argv[++i]));
+        else if (arg == "--max" && i + 1 < argc) maxPositions = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--report" && i + 1 < argc) report = max(1, atoi(argv[++i]));
+        else if (arg == "--positions" && i + 1 < argc) positionsFile = argv[++i];
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') { usage(); return 1; }
+        else pgnFiles.push_back(arg);
+    }
+    if (output.empty() || (positionsFile.empty() == pgnFiles.empty())) {
+        usage();
+        return 1;
+    }
+
+    vector<double> params;
+    currentParameters(params);
+    char line[200];
+
+    auto start = chrono::steady_clock::now();
+    TuningSet set;
+    if (!positionsFile.empty()) {
+        size_t rejected = 0;
+        if (!loadPositions(positionsFile, maxPositions, set, rejected)) {
+            cerr << "Cannot read " << positionsFile << endl;
+            return 1;
+        }
+        snprintf(line, sizeof(line), "%zu positions (%zu lines rejected) loaded in %.2f s, %.0f MB",
+            set.count, rejected, secondsSince(start), (set.features.size() * 2 + set.count * 8) / 1048576.0);
+    }
+    else {
+        size_t games = 0;
+        if (!loadGames(pgnFiles, skip, maxPositions, set, games)) {
+            cerr << "Cannot read the PGN files" << endl;
+            return 1;
+        }
+        snprintf(line, sizeof(line), "%zu positions from %zu finished games loaded in %.2f s, %.0f MB",
+            set.count, games, secondsSince(start), (set.features.size() * 2 + set.count * 8) / 1048576.0);
+    }
+    cout << line << endl;
+    if (set.count == 0 && epochs > 0) {
+        cerr << "No positions to tune on" << endl;
+        return 1;
+    }
+
+    ThreadPool pool;
+    startThreadPool(pool, threads);
+    vector<Accumulator> accumulators(poolWorkers(pool));
+    for (Accumulator& accumulator : accumulators) accumulator.gradient.assign(PARAM_COUNT, 0.0);
+
+    if (epochs > 0) {
+        if (k <= 0) {
+            start = chrono::steady_clock::now();
+            k = fitK(pool, set, params, accumulators);
+            snprintf(line, sizeof(line), "K = %.4f fitted in %.2f s", k, secondsSince(start));
+            cout << line << endl;
+        }
+        double initial = evaluateLoss(pool, set, params, k, 0, set.count, accumulators, false);
+        snprintf(line, sizeof(line), "Starting loss %.6f over %zu positions on %d threads", initial, set.count, poolWorkers(pool));
+        cout << line << endl;
+
+        Adam adam;
+        adam.m.assign(PARAM_COUNT, 0.0);
+        adam.v.assign(PARAM_COUNT, 0.0);
+        size_t step = batch > 0 ? batch : set.count;
+        double epochSeconds = 0;
+        for (int epoch = 1; epoch <= epochs; epoch++) {
+            start = chrono::steady_clock::now();
+            double loss = 0;
+            for (size_t begin = 0; begin < set.count; begin += step) {
+                size_t end = min(set.count, begin + step);
+                loss += evaluateLoss(pool, set, params, k, begin, end, accumulators, true) * double(end - begin);
+                adamStep(adam, params, accumulators, end - begin, rate);
+            }
+            epochSeconds += secondsSince(start);
+            if (epoch % report == 0 || epoch == epochs) {
+                snprintf(line, sizeof(line), "  epoch %4d  loss %.6f  %.3f s per epoch, %.1f M positions/s",
+                    epoch, loss / double(set.count), epochSeconds / epoch, set.count * epoch / max(epochSeconds, 1e-9) / 1e6);
+                cout << line << endl;
+            }
+        }
+    }
+    stopThreadPool(pool);
+
+    string comment = epochs > 0 ?
+        to_string(set.count) + " positions, " + to_string(epochs) + " epochs" : "hand-picked values";
+    if (!writeHeader(output, params, comment)) {
+        cerr << "Cannot write " << output << endl;
+        return 1;
+    }
+    cout << "Wrote " << output << endl;
+    return 0;
+}
@@ -0,0 +1,324 @@
+// Headless engine speaking the UCI protocol, for use with chess GUIs and
+// tournament managers. Consults the opening book before searching. The
+// UseMCTS option swaps the alpha-beta search for Monte Carlo tree search.
+//
+// "chess-engine bench [depth] [threads]" (or the bench command) searches the
+// built-in bench positions and prints the node count, speed and signature.
+
+#include "../core/bench.h"
+#include "../core/book.h"
+#include "../core/instrument.h"
+#include "../core/mcts.h"
+#include "../core/search.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+Search engine;
+Position position;
+vector<uint64_t> gameKeys;
+thread searchThread;
+
+OpeningBook book;
+bool ownBook = true;
+string bookFile = "book.bin";
+mt19937_64 bookRandom(random_device{}());
+
+// Lines reported per search ("setoption name MultiPV"); 1 is normal play
+int multiPv = 1;
+
+// Monte Carlo tree search instead of alpha-beta, on mctsThreads threads
+Mcts mcts;
+bool useMcts = false;
+int mctsThreads = 1;
+size_t mctsHashMb = 256;
+// Playouts for "go depth 1", doubling with each further ply, and the time
+// given to a go with no limit at all
+const uint64_t MCTS_PLAYOUTS_PER_DEPTH = 1000;
+const int64_t MCTS_DEFAULT_MS = 1000;
+
+// "debug on" reports heap allocations made by each search (there should be none)
+bool debugMode = false;
+
+string scoreToUci(int score) {
+    if (!isMateScore(score)) return "cp " + to_string(score);
+    int plies = MATE_SCORE - abs(score);
+    int moves = (plies + 1) / 2;
+    return "mate " + to_string(score > 0 ? moves : -moves);
+}
+
+void printInfo(const SearchInfo& info) {
+    uint64_t nps = info.timeMs > 0 ? info.nodes * 1000 / uint64_t(info.timeMs) : info.nodes;
+    cout << "info depth " << info.depth;
+    if (multiPv > 1) cout << " multipv " << info.line;
+    cout << " score " << scoreToUci(info.score)
+        << " nodes " << info.nodes << " nps " << nps << " time " << info.timeMs << " pv";
+    for (Move m : info.pv) cout << " " << moveToUci(m);
+    cout << endl;
+}
+
+void stopSearch() {
+    engine.stop = true;
+    mcts.stop = true;
+    if (searchThread.joinable()) searchThread.join();
+    engine.pondering = false;
+}
+
+void setPosition(istringstream& in) {
+    string token, fen;
+    in >> token;
+    if (token == "startpos") {
+        fen = START_FEN;
+        in >> token;
+    }
+    else if (token == "fen") {
+        while (in >> token && token != "moves") fen += token + " ";
+    }
+    else {
+        return;
+    }
+    if (!setFromFen(position, fen)) {
+        cout << "info string invalid fen" << endl;
+        setStartPosition(position);
+    }
+    gameKeys.clear();
+    if (token != "moves") return;
+    while (in >> token) {
+        Move m = parseUciMove(position, token);
+        if (m == NO_MOVE) {
+            cout << "info string illegal move " << token << endl;
+            break;
+        }
+        gameKeys.push_back(position.key);
+        UndoInfo undo;
+        makeMove(position, m, undo);
+    }
+}
+
+// "go perft N": node count of every root move, then the total
+void perftDivide(int depth) {
+    Position pos = position;
+    Move moves[MOVE_LIST_SIZE];
+    int n = generateLegalMoves(pos, moves);
+    uint64_t total = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        UndoInfo undo;
+        makeMove(pos, moves[i], undo);
+        uint64_t nodes = depth > 1 ? perft(pos, depth - 1) : 1;
+        unmakeMove(pos, moves[i], undo);
+        cout << moveToUci(moves[i]) << ": " << nodes << endl;
+        total += nodes;
+    }
+    int64_t ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    cout << endl << "Nodes searched: " << total << " (" << ms << " ms)" << endl;
+}
+
+void go(istringstream& in) {
+    SearchLimits limits;
+    int64_t wtime = -1, btime = -1, winc = 0, binc = 0, movetime = 0;
+    int movesToGo = 0;
+    bool infinite = false, ponder = false;
+    string token;
+    while (in >> token) {
+        if (token == "perft") {
+            int depth = 1;
+            in >> depth;
+            perftDivide(depth);
+            return;
+        }
+        if (token == "depth") in >> limits.depth;
+        else if (token == "movetime") in >> movetime;
+        else if (token == "nodes") in >> limits.nodes;
+        else if (token == "wtime") in >> wtime;
+        else if (token == "btime") in >> btime;
+        else if (token == "winc") in >> winc;
+        else if (token == "binc") in >> binc;
+        else if (token == "movestogo") in >> movesToGo;
+        else if (token == "infinite") infinite = true;
+        else if (token == "ponder") ponder = true;
+    }
+    limits.multiPv = multiPv;
+    int64_t timeLeft = position.whiteToMove ? wtime : btime;
+    if (movetime > 0) {
+        limits.softMs = limits.hardMs = movetime;
+    }
+    else if (timeLeft >= 0 && !infinite) {
+        ClockState clock;
+        clock.timeLeftMs = timeLeft;
+        clock.incrementMs = position.whiteToMove ? winc : binc;
+        clock.movesToGo = movesToGo;
+        TimeBudget budget = allocateTime(clock);
+        limits.softMs = budget.softMs;
+        limits.hardMs = budget.hardMs;
+    }
+
+    // Analysis with several lines wants the search's view, not a book move
+    if (ownBook && !infinite && !ponder && multiPv == 1) {
+        Move m = pickBookMove(book, position, bookRandom());
+        if (m != NO_MOVE) {
+            cout << "info string book move" << endl;
+            cout << "bestmove " << moveToUci(m) << endl;
+            return;
+        }
+    }
+
+    if (useMcts) {
+        // Multi-PV is an alpha-beta feature. A ponder search runs until stop or
+        // ponderhit, which ends it and plays from the tree built meanwhile.
+        // "go depth N" has no meaning for a tree search; it becomes a playout
+        // cap that doubles per ply. A go without limits gets a fixed budget.
+        MctsLimits mctsLimits;
+        mctsLimits.timeMs = ponder || infinite ? 0 : limits.softMs;
+        mctsLimits.playouts = limits.nodes;
+        if (limits.depth < MAX_PLY - 1) {
+            uint64_t depthPlayouts = MCTS_PLAYOUTS_PER_DEPTH << min(max(limits.depth, 1) - 1, 20);
+            if (mctsLimits.playouts == 0 || depthPlayouts < mctsLimits.playouts) mctsLimits.playouts = depthPlayouts;
+        }
+        if (!ponder && !infinite && mctsLimits.timeMs == 0 && mctsLimits.playouts == 0) {
+            mctsLimits.timeMs = MCTS_DEFAULT_MS;
+        }
+        mctsLimits.threads = mctsThreads;
+        mcts.stop = false;
+        searchThread = thread([mctsLimits]() {
+            MctsResult result = mctsSearch(mcts, position, mctsLimits, gameKeys);
+            int64_t ms = int64_t(result.seconds * 1000);
+            cout << "info depth " << result.pv.length << " score cp " << result.score << " nodes " << result.playouts
+                << " nps " << uint64_t(result.playouts / max(result.seconds, 1e-3)) << " time " << ms << " pv";
+            for (Move m : result.pv) cout << " " << moveToUci(m);
+            cout << endl;
+            cout << "bestmove " << moveToUci(result.bestMove);
+            if (result.pv.length > 1) cout << " ponder " << moveToUci(result.pv[1]);
+            cout << endl;
+        });
+        return;
+    }
+
+    engine.stop = false;
+    engine.pondering = ponder;
+    searchThread = thread([limits]() {
+        Position pos = position;
+        SearchResult result = searchPosition(engine, pos, limits, gameKeys);
+        if (debugMode) cout << "info string search allocations " << result.allocations << endl;
+        cout << "bestmove " << moveToUci(result.bestMove);
+        if (result.ponderMove != NO_MOVE) cout << " ponder " << moveToUci(result.ponderMove);
+        cout << endl;
+    });
+}
+
+// "bench [depth] [threads]"
+void bench(istringstream& in) {
+    int depth = BENCH_DEPTH, threads = 1;
+    in >> depth >> threads;
+    BenchResult result = runBench(max(1, depth), threads, &cout);
+    printBenchResult(cout, result);
+}
+
+// The value of a spin option, clamped to [low, high]; false unless value is
+// a whole number
+bool spinValue(const string& value, long low, long high, long& number) {
+    if (value.empty()) return false;
+    char* end = nullptr;
+    number = strtol(value.c_str(), &end, 10);
+    if (*end != '\0') return false;
+    number = max(low, min(high, number));
+    return true;
+}
+
+void setOption(istringstream& in) {
+    string token, name, value;
+    in >> token;    // "name"
+    while (in >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+    while (in >> token) value += (value.empty() ? "" : " ") + token;
+
+    // Spin options, with the maximum given by "uci"; malformed values are ignored
+    long number = 0;
+    long high = name == "Hash" ? 4096 : name == "MultiPV" ? MAX_MULTI_PV : name == "MCTSThreads" ? 256
+        : name == "MCTSHash" ? 16384 : 0;
+    if (high > 0 && !spinValue(value, 1, high, number)) {
+        cout << "info string invalid value for " << name << ": " << value << endl;
+        return;
+    }
+
+    if (name == "Hash") {
+        ttResize(engine.tt, size_t(number));
+    }
+    else if (name == "MultiPV") {
+        multiPv = int(number);
+    }
+    else if (name == "UseMCTS") {
+        useMcts = value == "true";
+    }
+    else if (name == "MCTSThreads") {
+        mctsThreads = int(number);
+    }
+    else if (name == "MCTSHash") {
+        mctsHashMb = size_t(number);
+        initMcts(mcts, mctsHashMb);
+    }
+    else if (name == "OwnBook") {
+        ownBook = value == "true";
+    }
+    else if (name == "BookFile") {
+        bookFile = value;
+        if (!openBook(book, bookFile)) cout << "info string cannot open book " << bookFile << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && string(argv[1]) == "bench") {
+        string arguments;
+        for (int i = 2; i < argc; i++) arguments += string(argv[i]) + " ";
+        istringstream in(arguments);
+        bench(in);
+        return 0;
+    }
+    initSearch(engine, 16);
+    initMcts(mcts, mctsHashMb);
+    engine.onInfo = printInfo;
+    openBook(book, bookFile);
+    setStartPosition(position);
+
+    string line;
+    while (getline(cin, line)) {
+        istringstream in(line);
+        string command;
+        in >> command;
+
+        if (command == "uci") {
+            cout << "id name Chess-Game" << endl;
+            cout << "id author Subhan Ali" << endl;
+            cout << "option name Hash type spin default 16 min 1 max 4096" << endl;
+            cout << "option name Ponder type check default false" << endl;
+            cout << "option name MultiPV type spin default 1 min 1 max " << MAX_MULTI_PV << endl;
+            cout << "option name UseMCTS type check default false" << endl;
+            cout << "option name MCTSThreads type spin default 1 min 1 max 256" << endl;
+            cout << "option name MCTSHash type spin default 256 min 1 max 16384" << endl;
+            cout << "option name OwnBook type check default true" << endl;
+            cout << "option name BookFile type string default book.bin" << endl;
+            cout << "uciok" << endl;
+        }
+        else if (command == "isready") cout << "readyok" << endl;
+        else if (command == "debug") { string mode; in >> mode; debugMode = mode == "on"; }
+        else if (command == "ucinewgame") { stopSearch(); newGame(engine); }
+        else if (command == "position") { stopSearch(); setPosition(in); }
+        else if (command == "go") { stopSearch(); go(in); }
+        else if (command == "stop") stopSearch();
+        else if (command == "ponderhit") { engine.pondering = false; if (useMcts) mcts.stop = true; }
+        else if (command == "setoption") { stopSearch(); setOption(in); }
+        else if (command == "bench") { stopSearch(); bench(in); }
+        else if (command == "d") cout << toFen(position) << endl;
+        else if (command == "stats") writeInstrumentationJson(cout);
+        else if (command == "quit") break;
+    }
+    stopSearch();
+    closeBook(book);
+    return 0;
+}